@@ -2,11 +2,25 @@
 #define __AMD_AM79C973_H__
 
 #include "common/types.h"
-#include "drivers/driver.h"
+#include "drivers/netDevice.h"
 #include "hardwareCommunication/pci.h"
 #include "hardwareCommunication/interrupts.h"
 #include "hardwareCommunication/port.h"
 
+// log2 of the ring sizes, the chip supports up to 512 (9) descriptors per ring
+#ifndef AMD_AM79C973_RECV_RING_LOG2
+#define AMD_AM79C973_RECV_RING_LOG2 6
+#endif
+
+#ifndef AMD_AM79C973_SEND_RING_LOG2
+#define AMD_AM79C973_SEND_RING_LOG2 5
+#endif
+
+// frames held in software while the transmit ring is full
+#ifndef AMD_AM79C973_SEND_QUEUE_DEPTH
+#define AMD_AM79C973_SEND_QUEUE_DEPTH 64
+#endif
+
 namespace zoeos
 {
 
@@ -14,9 +28,21 @@ namespace drivers
 {
     using namespace hardwareCommunication;
 
-    class RawDataWrapper;
-
-    class AMD_AM79C973 : public Driver, public InterruptRoutine
+    struct TxStatistics
+    {
+        uint32_t framesSent;
+        uint32_t framesQueued;
+        uint32_t drops;
+        uint32_t errors;
+        uint32_t queueDepth;
+        uint32_t queueHighWater;
+        // cycles from handing a frame to the NIC until its descriptors are reclaimed
+        uint32_t reclaimed;
+        uint64_t reclaimCycles;
+        uint64_t maxReclaimCycles;
+    } ZOEOS_CACHE_ALIGNED;
+
+    class AMD_AM79C973 : public NetDevice, public InterruptRoutine
     {
     private:
         struct Initialization_block
@@ -53,42 +79,81 @@ namespace drivers
 
         Initialization_block initBlock;
 
+        // every buffer holds a whole frame
+        static const uint32_t bufferSize = 1536;
+
         BufferDescriptor *sendBufferDesc;
-        uint8_t sendBufferDescMemory[2063];
-        uint8_t sendBuffer[2063][8];
-        uint8_t currentSendBuffer;
+        uint8_t *sendBuffers;
+        uint16_t sendRingSize;
+        uint16_t currentSendBuffer;
+        // oldest descriptor not yet reclaimed and number of descriptors owned by the NIC
+        uint16_t sendTail;
+        uint16_t sendInFlight;
+        // completion and submit time of the frame ending at a descriptor
+        TxCompletion *sendCompletions;
+        void **sendCookies;
+        uint64_t *sendTimestamps;
+
+        // frames waiting for free descriptors
+        struct SendQueueEntry;
+        SendQueueEntry *sendQueue;
+        net::NetBufferPool *sendQueuePool;
+        uint16_t sendQueueDepth;
+        uint16_t sendQueueHead;
+        uint16_t sendQueueCount;
+        TxStatistics txStats;
         
         BufferDescriptor *recvBufferDesc;
-        uint8_t recvBufferDescMemory[2063];
-        uint8_t recvBuffer[2063][8];
-        uint8_t currentRecvBuffer;
-        RawDataWrapper *wrapper;
+        // the pool buffer each receive descriptor points at
+        net::NetBuffer **recvRing;
+        net::NetBufferPool *recvPool;
+        uint16_t recvRingSize;
+        uint16_t currentRecvBuffer;
+        volatile bool ready;
+        // receive interrupts are masked until poll() has drained the ring
+        volatile bool pollScheduled;
+        bool debugDump;
+
+        // RAP/RDP sequences, atomic with respect to the interrupt routine
+        uint16_t readCSR(uint16_t csr);
+        void writeCSR(uint16_t csr, uint16_t value);
+        void writeBCR(uint16_t bcr, uint16_t value);
+        static void *allocAligned(uint32_t size, uint32_t align);
+        // hand descriptors the NIC has finished with back to the ring, then refill it from the queue
+        void reclaim();
+        TxStatus transmit(const TxFragment *fragments, int count, TxCompletion completion, void *cookie);
+        TxStatus enqueue(const TxFragment *fragments, int count, TxCompletion completion, void *cookie);
+        void flushQueue();
+
+    protected:
+        // chains one descriptor per fragment with STP/ENP; completions run from reclaim(),
+        // from the interrupt routine or from a later send(), possibly in a task
+        virtual TxStatus sendFrame(const TxFragment *fragments, int count, TxCompletion completion, void *cookie) override;
 
     public:
-        AMD_AM79C973(PciConfigSpace *device, InterruptManager *interrupts);
+        AMD_AM79C973(PciConfigSpace *device, InterruptManager *interrupts,
+                uint8_t recvRingLog2 = AMD_AM79C973_RECV_RING_LOG2,
+                uint8_t sendRingLog2 = AMD_AM79C973_SEND_RING_LOG2,
+                uint16_t sendQueueDepth = AMD_AM79C973_SEND_QUEUE_DEPTH);
         ~AMD_AM79C973();
 
+        static const PciDeviceID idTable[];
+        static const PciDriver pciDriver;
+        static Driver *probe(PciConfigSpace *device, PciController *pci, InterruptManager *interrupts);
+
+        // starts initialisation, the chip is started from the init-done interrupt
         virtual void activate() override;
         virtual void deactivate() override { }
         virtual int reset() override;
+        virtual bool isReady() const override { return ready; }
+        virtual const char *getName() const override { return "amd_am79c973"; }
         virtual uint32_t routine(uint32_t esp) override;
-        void send(uint8_t *buffer, int size);
-        void receive();
-        uint64_t getMACAddr() const;
-
-        void setWrapper(RawDataWrapper *wrapper);
-    };
-
-    class RawDataWrapper
-    {
-    public:
-        RawDataWrapper(AMD_AM79C973 *backend_);
-        ~RawDataWrapper();
-
-        virtual bool onRawDataReceived(uint8_t *buffer, uint32_t size);
-        virtual void send(uint8_t *buffer, uint32_t size);
-    protected:
-        AMD_AM79C973 *backend;
+        // drain up to budget received frames, receive interrupts are re-enabled once the ring is empty
+        virtual int poll(int budget) override;
+        const TxStatistics &getTxStatistics() const { return txStats; }
+        virtual uint64_t getMACAddr() const override;
+        // hex dump every received frame to the screen
+        void setDebugDump(bool enabled) { debugDump = enabled; }
     };
 }
 
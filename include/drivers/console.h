@@ -0,0 +1,65 @@
+#ifndef __DRIVERS_CONSOLE_H__
+#define __DRIVERS_CONSOLE_H__
+
+#include "common/types.h"
+#include "drivers/driver.h"
+
+namespace zoeos
+{
+
+namespace drivers
+{
+    using common::uint8_t;
+    using common::uint16_t;
+    using common::uint32_t;
+
+    // The 80x25 VGA text screen, drawn in a copy in RAM. write() only touches
+    // the copy and remembers which lines changed, so printing from an
+    // interrupt routine costs no MMIO. poll(), run by DriverManager::pollAll
+    // from kernelMain's loop, copies the changed lines to 0xb8000 in one go.
+    class Console : public Driver
+    {
+    public:
+        static const int columns = 80;
+        static const int rows = 25;
+
+        // starts from what the bootloader left on the screen
+        Console();
+        ~Console();
+
+        // driver methods override
+        virtual int poll(int budget) override;
+        virtual const char *getName() const override { return "console"; }
+        virtual Type getType() const override { return CONSOLE; }
+
+        // '\n' starts a new line, the screen scrolls up a line at the bottom
+        void write(const char *text);
+        // The mouse pointer, drawn over the text by flush() with the colors of
+        // its cell swapped. It is never in the copy, so scrolling leaves it be.
+        void movePointer(int x, int y);
+        void togglePointer();
+        // copy the lines changed since the last flush to VGA memory, returns how many
+        int flush();
+
+        static Console *activeConsole;
+
+    private:
+        void putChar(char c);
+        void scroll();
+        void markDirty(int firstRow, int lastRow);
+
+        uint16_t shadow[rows * columns];
+        int cursorX;
+        int cursorY;
+        // lines [dirtyFirst, dirtyLast] differ from the screen, dirtyFirst > dirtyLast when none
+        int dirtyFirst;
+        int dirtyLast;
+        int pointerX;
+        int pointerY;
+        bool pointerVisible;
+    };
+}
+
+}
+
+#endif
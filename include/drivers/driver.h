@@ -8,13 +8,36 @@ namespace drivers
 
     class Driver
     {
+        friend class DriverManager;
     public:
+        enum Type
+        {
+            GENERIC = 0,
+            KEYBOARD,
+            MOUSE,
+            NETWORK,
+            TIMER,
+            SERIAL,
+            CONSOLE
+        };
+
         Driver();
         ~Driver();
 
+        // activate() only starts the device; slow steps such as waiting for
+        // an init-done interrupt finish later and are reported by isReady()
         virtual void activate();
         virtual int reset();
         virtual void deactivate();
+        virtual bool isReady() const { return true; }
+        // deferred work scheduled by the interrupt routine, returns the amount done
+        virtual int poll(int budget) { return 0; }
+
+        virtual const char *getName() const { return "driver"; }
+        virtual Type getType() const { return GENERIC; }
+
+    private:
+        Driver *nextDriver;
     };
 
     class DriverManager
@@ -24,10 +47,21 @@ namespace drivers
         ~DriverManager();
 
         void addDriver(Driver *);
+        // start every driver without waiting for any of them to finish
         void activeAll();
-        Driver *drivers[256];
+        // number of drivers still completing their activation
+        int numPending() const;
+        // run the deferred work of every driver, called outside interrupt context
+        int pollAll(int budget);
+
+        int getNumDrivers() const { return numDrivers; }
+        Driver *getDriver(const char *name);
+        // the index-th driver of the given type
+        Driver *getDriver(Driver::Type type, int index = 0);
 
     private:
+        Driver *first;
+        Driver *last;
         int numDrivers = 0;
     };
 }
@@ -0,0 +1,120 @@
+#ifndef __DRIVERS_E1000_H__
+#define __DRIVERS_E1000_H__
+
+#include "common/types.h"
+#include "drivers/netDevice.h"
+#include "hardwareCommunication/pci.h"
+#include "hardwareCommunication/interrupts.h"
+
+// log2 of the ring sizes, rings are a multiple of 8 descriptors up to 4096
+#ifndef E1000_RECV_RING_LOG2
+#define E1000_RECV_RING_LOG2 7
+#endif
+
+#ifndef E1000_SEND_RING_LOG2
+#define E1000_SEND_RING_LOG2 7
+#endif
+
+// upper bound on interrupts per second, programmed into ITR
+#ifndef E1000_INTERRUPT_RATE
+#define E1000_INTERRUPT_RATE 8000
+#endif
+
+namespace zoeos
+{
+
+namespace drivers
+{
+    using namespace hardwareCommunication;
+
+    // Intel 8254x gigabit cards (QEMU's default e1000), legacy descriptors
+    class E1000 : public NetDevice, public InterruptRoutine
+    {
+    private:
+        struct RecvDescriptor
+        {
+            uint64_t address;
+            uint16_t length;
+            uint16_t checksum;
+            uint8_t status;
+            uint8_t errors;
+            uint16_t special;
+        } __attribute__((packed));
+
+        struct SendDescriptor
+        {
+            uint64_t address;
+            uint16_t length;
+            uint8_t checksumOffset;
+            uint8_t command;
+            uint8_t status;
+            uint8_t checksumStart;
+            uint16_t special;
+        } __attribute__((packed));
+
+        // RCTL.BSIZE is left at 2048 bytes
+        static const uint32_t bufferSize = 2048;
+
+        uint32_t registerBase;
+        uint64_t MACAddress;
+
+        RecvDescriptor *recvDesc;
+        net::NetBuffer **recvRing;
+        net::NetBufferPool *recvPool;
+        uint16_t recvRingSize;
+        uint16_t currentRecvBuffer;
+
+        SendDescriptor *sendDesc;
+        // copies of short fragments, one buffer per descriptor
+        uint8_t *sendBuffers;
+        uint16_t sendRingSize;
+        uint16_t currentSendBuffer;
+        uint16_t sendTail;
+        uint16_t sendInFlight;
+        // for the first descriptor of a frame, its last one; the completion is kept at the last
+        uint16_t *sendLast;
+        TxCompletion *sendCompletions;
+        void **sendCookies;
+
+        volatile bool ready;
+        volatile bool pollScheduled;
+
+        uint32_t readRegister(uint16_t reg);
+        void writeRegister(uint16_t reg, uint32_t value);
+        uint16_t readEEPROM(uint8_t address);
+        static void *allocAligned(uint32_t size, uint32_t align);
+        void reclaim();
+        // fill descriptors for one frame, TDT is left to the caller
+        TxStatus queueFrame(const TxFragment *fragments, int count, TxCompletion completion, void *cookie);
+
+    protected:
+        virtual TxStatus sendFrame(const TxFragment *fragments, int count, TxCompletion completion, void *cookie) override;
+        // one TDT write for the whole batch
+        virtual int sendFrames(const TxFrame *frames, int count) override;
+
+    public:
+        E1000(PciConfigSpace *device, InterruptManager *interrupts, uint32_t registerBase,
+                uint8_t recvRingLog2 = E1000_RECV_RING_LOG2,
+                uint8_t sendRingLog2 = E1000_SEND_RING_LOG2);
+        ~E1000();
+
+        static const PciDeviceID idTable[];
+        static const PciDriver pciDriver;
+        static Driver *probe(PciConfigSpace *device, PciController *pci, InterruptManager *interrupts);
+
+        virtual void activate() override;
+        virtual void deactivate() override;
+        virtual int reset() override;
+        virtual bool isReady() const override { return ready; }
+        virtual const char *getName() const override { return "e1000"; }
+        virtual uint32_t routine(uint32_t esp) override;
+        // drain up to budget received frames, receive interrupts are re-enabled once the ring is empty;
+        // frames carry the IP / TCP / UDP checksum results in NetBuffer::checksum
+        virtual int poll(int budget) override;
+        virtual uint64_t getMACAddr() const override { return MACAddress; }
+    };
+}
+
+}
+
+#endif
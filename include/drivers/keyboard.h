@@ -25,6 +25,8 @@ namespace drivers
 
         // driver methods override
         virtual void activate();
+        virtual const char *getName() const override { return "keyboard"; }
+        virtual Type getType() const override { return KEYBOARD; }
 
     private:
         Port8Bit dataPort;
@@ -25,6 +25,8 @@ namespace drivers
 
         // driver methods override
         virtual void activate();
+        virtual const char *getName() const override { return "mouse"; }
+        virtual Type getType() const override { return MOUSE; }
 
     private:
         uint8_t offset = 0;
@@ -0,0 +1,176 @@
+#ifndef __DRIVERS_NET_DEVICE_H__
+#define __DRIVERS_NET_DEVICE_H__
+
+#include "common/types.h"
+#include "drivers/driver.h"
+#include "net/netBuffer.h"
+#include "net/netstat.h"
+
+namespace zoeos
+{
+
+namespace net
+{
+    class PacketCapture;
+}
+
+namespace drivers
+{
+    using common::uint8_t;
+    using common::uint16_t;
+    using common::uint32_t;
+    using common::uint64_t;
+
+    class RawDataWrapper;
+
+    // one piece of a frame, handed to the NIC in place when possible
+    struct TxFragment
+    {
+        uint8_t *data;
+        uint32_t size;
+    };
+
+    // called once the NIC no longer reads the fragments of a frame
+    typedef void (*TxCompletion)(void *cookie);
+
+    // one frame of a batch
+    struct TxFrame
+    {
+        const TxFragment *fragments;
+        int count;
+        TxCompletion completion;
+        void *cookie;
+    };
+
+    enum TxStatus
+    {
+        // handed to the NIC
+        TX_SENT = 0,
+        // the ring is full, the frame waits in the software queue: slow down
+        TX_QUEUED,
+        // the ring and the queue are full, the frame was dropped
+        TX_DROPPED,
+        // empty, oversized or too fragmented
+        TX_INVALID
+    };
+
+    // what a NetDevice can take off the stack
+    enum NetDeviceCapability
+    {
+        // fragments of copyBreak bytes or more are read in place by DMA
+        NETDEV_SCATTER_GATHER = 1 << 0,
+        // received frames carry checksum results in NetBuffer::checksum
+        NETDEV_RX_CHECKSUM_IP = 1 << 1,
+        NETDEV_RX_CHECKSUM_L4 = 1 << 2,
+        // several hardware queues, frames are spread by destination MAC
+        NETDEV_MULTIQUEUE = 1 << 3,
+        // sendBatch() rings the doorbell once per batch
+        NETDEV_BATCH_TX = 1 << 4
+    };
+
+    struct NetDeviceStatistics
+    {
+        uint64_t rxPackets;
+        uint64_t rxBytes;
+        // no buffer, a receive error or nobody listening
+        uint32_t rxDropped;
+        uint64_t txPackets;
+        uint64_t txBytes;
+        uint32_t txDropped;
+        // errors the NIC reports: the receive side had no room, a collision,
+        // a DMA fault, a frame too long to send
+        uint32_t rxMissed;
+        uint32_t collisions;
+        uint32_t busErrors;
+        uint32_t txErrors;
+    } ZOEOS_CACHE_ALIGNED;
+
+    // what every network card driver offers to RawDataWrapper
+    class NetDevice : public Driver
+    {
+    public:
+        NetDevice();
+        ~NetDevice();
+
+        // fragments shorter than this are copied, the copy is cheaper than a descriptor
+        static const uint32_t copyBreak = 128;
+        static const int maxFragments = 16;
+
+        // Queue a frame made of count fragments. Without a completion every
+        // fragment is copied and may be reused at once. With one, fragments
+        // of copyBreak bytes or more are read in place by DMA and must stay
+        // untouched until completion(cookie) runs, possibly in interrupt context.
+        // Protocol headers are all below copyBreak, so the layers build them
+        // on the stack and pass them in the same call as the payload.
+        TxStatus send(const TxFragment *fragments, int count, TxCompletion completion = nullptr, void *cookie = nullptr);
+        void send(uint8_t *buffer, int size);
+        // queue frames in order until one is refused, returns how many were taken
+        int sendBatch(const TxFrame *frames, int count);
+
+        virtual uint64_t getMACAddr() const { return 0; }
+        uint16_t getMTU() const { return mtu; }
+        // NetDeviceCapability bits
+        uint32_t getCapabilities() const { return capabilities; }
+        const NetDeviceStatistics &getStatistics() const { return stats; }
+
+        // received frames go to wrapper, nullptr drops them
+        void setWrapper(RawDataWrapper *wrapper);
+        virtual Type getType() const override { return NETWORK; }
+
+    protected:
+        // the driver side of send() / sendBatch(); the default batch sends one frame at a time
+        virtual TxStatus sendFrame(const TxFragment *fragments, int count, TxCompletion completion, void *cookie);
+        virtual int sendFrames(const TxFrame *frames, int count);
+        // count a received frame and pass it up, or release it if nobody listens
+        void receive(net::NetBuffer *buffer);
+
+        RawDataWrapper *wrapper;
+        NetDeviceStatistics stats;
+        uint32_t capabilities;
+        uint16_t mtu;
+
+    private:
+        void countSent(const TxFragment *fragments, int count, TxStatus status);
+    };
+
+    // Frames in and out of any number of NetDevices. Frames to a destination
+    // always leave through the same device, destinations are spread by hash.
+    class RawDataWrapper
+    {
+    public:
+        RawDataWrapper(NetDevice *backend_);
+        ~RawDataWrapper();
+
+        static const int maxDevices = 8;
+        bool bind(NetDevice *device);
+        void unbind(NetDevice *device);
+        int getNumDevices() const { return numDevices; }
+        NetDevice *getDevice(int index) const { return index < numDevices ? devices[index] : nullptr; }
+        // the device frames to dstMAC leave through
+        NetDevice *route(uint64_t dstMAC) const;
+        // tap every frame received or sent through this wrapper, nullptr stops
+        void setCapture(net::PacketCapture *capture_) { capture = capture_; }
+
+        // takes ownership of a received frame; the default hands it to
+        // onRawDataReceived and sends it back in place if that returns true
+        virtual void onBufferReceived(NetDevice *device, net::NetBuffer *buffer);
+        virtual bool onRawDataReceived(NetDevice *device, uint8_t *buffer, uint32_t size);
+        // Called from onRawDataReceived, keeps the frame being handled: the
+        // caller now owns it and must release() it. nullptr when there is no
+        // such frame or someone claimed it already.
+        net::NetBuffer *claimReceiveBuffer();
+        virtual void send(uint8_t *buffer, uint32_t size);
+        virtual TxStatus send(const TxFragment *fragments, int count, TxCompletion completion = nullptr, void *cookie = nullptr);
+        TxStatus send(NetDevice *device, const TxFragment *fragments, int count, TxCompletion completion = nullptr, void *cookie = nullptr);
+    protected:
+        NetDevice *devices[maxDevices];
+        int numDevices;
+        net::PacketCapture *capture;
+        // the frame onBufferReceived is handling
+        net::NetBuffer *receiving;
+    };
+}
+
+}
+
+#endif
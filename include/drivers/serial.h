@@ -0,0 +1,49 @@
+#ifndef __DRIVERS_SERIAL_H__
+#define __DRIVERS_SERIAL_H__
+
+#include "common/types.h"
+#include "hardwareCommunication/port.h"
+#include "drivers/driver.h"
+
+namespace zoeos
+{
+
+namespace drivers
+{
+    using common::uint8_t;
+    using common::uint16_t;
+    using common::uint32_t;
+    using hardwareCommunication::Port8Bit;
+
+    // 16550 UART at 115200 8N1, transmit only and polled
+    class SerialPort : public Driver
+    {
+    public:
+        // COM1 is 0x3f8
+        SerialPort(uint16_t portBase = 0x3f8);
+        ~SerialPort();
+
+        // driver methods override
+        virtual void activate() override;
+        virtual const char *getName() const override { return "serial"; }
+        virtual Type getType() const override { return SERIAL; }
+
+        // wait for room in the transmit FIFO and queue the bytes
+        void write(uint8_t data);
+        void write(const uint8_t *data, uint32_t size);
+        void write(const char *text);
+
+        static SerialPort *activeSerial;
+
+    private:
+        Port8Bit dataPort;
+        Port8Bit interruptEnablePort;
+        Port8Bit fifoControlPort;
+        Port8Bit lineControlPort;
+        Port8Bit modemControlPort;
+        Port8Bit lineStatusPort;
+    };
+}
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef __DRIVERS_TIMER_H__
+#define __DRIVERS_TIMER_H__
+
+#include "common/types.h"
+#include "hardwareCommunication/interrupts.h"
+#include "hardwareCommunication/port.h"
+#include "drivers/driver.h"
+
+namespace zoeos
+{
+
+namespace drivers
+{
+    using hardwareCommunication::InterruptManager;
+    using hardwareCommunication::InterruptRoutine;
+    using hardwareCommunication::Port8Bit;
+
+    typedef void (*TimerCallback)(void *cookie);
+
+    // PIT channel 0 as the system tick, also the reference the TSC is measured against
+    class TimerDriver : public InterruptRoutine, public Driver
+    {
+    public:
+        TimerDriver(InterruptManager *manager, uint32_t frequency = 1000);
+        ~TimerDriver();
+
+        virtual uint32_t routine(uint32_t esp) override;
+
+        // driver methods override
+        virtual void activate() override;
+        virtual const char *getName() const override { return "timer"; }
+        virtual Type getType() const override { return TIMER; }
+
+        // ticks since activate(), getFrequency() per second
+        uint64_t getTicks() const;
+        uint32_t getFrequency() const { return frequency; }
+        uint64_t getMilliseconds() const { return getTicks() * 1000 / frequency; }
+        // TSC cycles per second measured over all ticks so far, 0 before the second tick
+        uint64_t getCyclesPerSecond() const;
+        // halt until count more ticks have passed, interrupts must be on
+        void wait(uint32_t count);
+
+        // run callback(cookie) every period ticks from poll(), outside interrupt context
+        bool addPeriodic(TimerCallback callback, void *cookie, uint32_t period);
+        void removePeriodic(TimerCallback callback, void *cookie);
+        // runs the periodic callbacks that are due
+        virtual int poll(int budget) override;
+
+        static TimerDriver *activeTimer;
+
+    private:
+        struct Periodic
+        {
+            TimerCallback callback;
+            void *cookie;
+            uint32_t period;
+            uint64_t next;
+        };
+
+        static const int maxPeriodic = 16;
+        Periodic periodic[maxPeriodic];
+        int numPeriodic;
+
+        Port8Bit channel0Port;
+        Port8Bit commandPort;
+        uint32_t frequency;
+        volatile uint64_t ticks;
+        uint64_t firstTsc;
+        volatile uint64_t lastTsc;
+    };
+}
+}
+
+#endif
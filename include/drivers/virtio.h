@@ -0,0 +1,121 @@
+#ifndef __DRIVERS_VIRTIO_H__
+#define __DRIVERS_VIRTIO_H__
+
+#include "common/types.h"
+
+namespace zoeos
+{
+
+namespace drivers
+{
+    using common::uint8_t;
+    using common::uint16_t;
+    using common::uint32_t;
+    using common::uint64_t;
+
+    // legacy virtio-pci register block in I/O BAR 0
+    enum VirtioLegacyRegister
+    {
+        VIRTIO_REG_DEVICE_FEATURES = 0x00,
+        VIRTIO_REG_GUEST_FEATURES = 0x04,
+        VIRTIO_REG_QUEUE_ADDRESS = 0x08,
+        VIRTIO_REG_QUEUE_SIZE = 0x0c,
+        VIRTIO_REG_QUEUE_SELECT = 0x0e,
+        VIRTIO_REG_QUEUE_NOTIFY = 0x10,
+        VIRTIO_REG_DEVICE_STATUS = 0x12,
+        VIRTIO_REG_ISR_STATUS = 0x13,
+        // device specific configuration, without MSI-X
+        VIRTIO_REG_CONFIG = 0x14
+    };
+
+    enum VirtioStatus
+    {
+        VIRTIO_STATUS_ACKNOWLEDGE = 1,
+        VIRTIO_STATUS_DRIVER = 2,
+        VIRTIO_STATUS_DRIVER_OK = 4,
+        VIRTIO_STATUS_FAILED = 128
+    };
+
+    const uint32_t VIRTIO_RING_F_EVENT_IDX = 1u << 29;
+
+    // one buffer of a descriptor chain
+    struct VirtqSegment
+    {
+        uint8_t *data;
+        uint32_t size;
+        // the device writes into it
+        bool writable;
+    };
+
+    // A split virtqueue in the legacy layout: descriptor table and available
+    // ring, then the used ring on the next page.
+    class Virtqueue
+    {
+    public:
+        Virtqueue();
+        ~Virtqueue();
+
+        bool init(uint16_t index, uint16_t size);
+        bool isValid() const { return desc != nullptr; }
+        // what the legacy QUEUE_ADDRESS register expects
+        uint32_t getPageFrame() const { return (uint32_t)desc >> 12; }
+        uint16_t getIndex() const { return index; }
+        uint16_t getSize() const { return size; }
+        uint16_t getNumFree() const { return numFree; }
+        void setEventIndex(bool enabled) { eventIndex = enabled; }
+
+        // chain the segments and queue the chain, returns its head or -1 if full;
+        // the device sees it after publish()
+        int add(const VirtqSegment *segments, int count);
+        // expose added chains, true if the device asked to be notified
+        bool publish();
+
+        bool hasUsed() const { return lastUsed != *usedIdx; }
+        // head of the next chain the device is done with, -1 if none; the chain is freed
+        int getUsed(uint32_t *length);
+
+        // stop / ask for interrupts on used chains; enableInterrupts() returns
+        // false if chains were used meanwhile and the caller should poll again
+        void disableInterrupts();
+        bool enableInterrupts();
+
+    private:
+        struct Descriptor
+        {
+            uint64_t address;
+            uint32_t length;
+            uint16_t flags;
+            uint16_t next;
+        } __attribute__((packed));
+
+        struct UsedElement
+        {
+            uint32_t id;
+            uint32_t length;
+        } __attribute__((packed));
+
+        Descriptor *desc;
+        volatile uint16_t *availFlags;
+        volatile uint16_t *availIdx;
+        volatile uint16_t *availRing;
+        volatile uint16_t *usedEvent;
+        volatile uint16_t *usedFlags;
+        volatile uint16_t *usedIdx;
+        volatile UsedElement *usedRing;
+        volatile uint16_t *availEvent;
+
+        uint16_t index;
+        uint16_t size;
+        uint16_t freeHead;
+        uint16_t numFree;
+        uint16_t lastUsed;
+        // avail index written by add() and the one the device last saw
+        uint16_t availShadow;
+        uint16_t availPublished;
+        bool eventIndex;
+    };
+}
+
+}
+
+#endif
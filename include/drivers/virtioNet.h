@@ -0,0 +1,138 @@
+#ifndef __DRIVERS_VIRTIO_NET_H__
+#define __DRIVERS_VIRTIO_NET_H__
+
+#include "common/types.h"
+#include "drivers/netDevice.h"
+#include "drivers/virtio.h"
+#include "hardwareCommunication/pci.h"
+#include "hardwareCommunication/interrupts.h"
+#include "hardwareCommunication/port.h"
+
+// receive / transmit queue pairs used at most, frames are spread over them by destination MAC
+#ifndef VIRTIO_NET_MAX_QUEUE_PAIRS
+#define VIRTIO_NET_MAX_QUEUE_PAIRS 4
+#endif
+
+// receive buffers posted per queue, each takes two descriptors
+#ifndef VIRTIO_NET_RECV_BUFFERS
+#define VIRTIO_NET_RECV_BUFFERS 128
+#endif
+
+namespace zoeos
+{
+
+namespace drivers
+{
+    using namespace hardwareCommunication;
+
+    // legacy / transitional virtio network card
+    class VirtioNet : public NetDevice, public InterruptRoutine
+    {
+    private:
+        // what the device prepends to every frame without MRG_RXBUF
+        struct Header
+        {
+            uint8_t flags;
+            uint8_t gsoType;
+            uint16_t headerLength;
+            uint16_t gsoSize;
+            uint16_t checksumStart;
+            uint16_t checksumOffset;
+        } __attribute__((packed));
+
+        struct ControlCommand
+        {
+            uint8_t commandClass;
+            uint8_t command;
+            uint16_t queuePairs;
+            volatile uint8_t ack;
+        } __attribute__((packed));
+
+        // what a finished transmit chain gives back
+        struct TxToken
+        {
+            TxCompletion completion;
+            void *cookie;
+            net::NetBuffer *copy;
+        };
+
+        struct QueuePair
+        {
+            Virtqueue recv;
+            Virtqueue send;
+            // the buffer posted at each receive head and the token of each send head
+            net::NetBuffer **recvBuffers;
+            TxToken *sendTokens;
+        };
+
+        static const uint32_t bufferSize = 1536;
+        // the header sits right before the frame, which starts 16 bytes into the buffer
+        static const uint32_t frameOffset = 16;
+
+        uint16_t portBase;
+        Port32Bit deviceFeaturesPort;
+        Port32Bit guestFeaturesPort;
+        Port32Bit queueAddressPort;
+        Port16Bit queueSizePort;
+        Port16Bit queueSelectPort;
+        Port16Bit queueNotifyPort;
+        Port8Bit deviceStatusPort;
+        Port8Bit ISRStatusPort;
+
+        uint32_t features;
+        uint64_t MACAddress;
+        QueuePair *pairs;
+        uint16_t numPairs;
+        Virtqueue controlQueue;
+        ControlCommand controlCommand;
+        net::NetBufferPool *recvPool;
+        net::NetBufferPool *sendPool;
+        volatile bool ready;
+        volatile bool controlPending;
+        volatile bool pollScheduled;
+        bool failed;
+
+        bool setupQueue(Virtqueue &queue, uint16_t index);
+        void notify(const Virtqueue &queue);
+        void refill(QueuePair &pair);
+        // finish used transmit chains of one pair
+        void reclaim(QueuePair &pair);
+        // hand the MQ command its answer once the device has used it
+        void checkControl();
+        // picks the queue pair from the destination MAC so one flow stays in order
+        QueuePair &selectPair(const TxFragment *fragments, int count);
+        // chain one frame, the device is notified by the caller
+        TxStatus queueFrame(QueuePair &pair, const TxFragment *fragments, int count, TxCompletion completion, void *cookie);
+        void publish(QueuePair &pair);
+
+    protected:
+        virtual TxStatus sendFrame(const TxFragment *fragments, int count, TxCompletion completion, void *cookie) override;
+        // one notification per touched queue for the whole batch
+        virtual int sendFrames(const TxFrame *frames, int count) override;
+
+    public:
+        VirtioNet(PciConfigSpace *device, InterruptManager *interrupts, uint16_t maxQueuePairs = VIRTIO_NET_MAX_QUEUE_PAIRS);
+        ~VirtioNet();
+
+        static const PciDeviceID idTable[];
+        static const PciDriver pciDriver;
+        static Driver *probe(PciConfigSpace *device, PciController *pci, InterruptManager *interrupts);
+
+        // sets DRIVER_OK and posts receive buffers, with several queue pairs the
+        // card is ready once it has acknowledged the MQ command
+        virtual void activate() override;
+        virtual void deactivate() override { }
+        virtual int reset() override;
+        virtual bool isReady() const override { return ready || failed; }
+        virtual const char *getName() const override { return "virtio_net"; }
+        virtual uint32_t routine(uint32_t esp) override;
+        // drain up to budget received frames over all queues, then re-arm the used event
+        virtual int poll(int budget) override;
+        virtual uint64_t getMACAddr() const override { return MACAddress; }
+        uint16_t getNumQueuePairs() const { return numPairs; }
+    };
+}
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef __DRIVERS_VIRTUAL_ETHERNET_H__
+#define __DRIVERS_VIRTUAL_ETHERNET_H__
+
+#include "common/types.h"
+#include "drivers/netDevice.h"
+
+namespace zoeos
+{
+
+namespace drivers
+{
+    // One end of an in-memory Ethernet cable. A sent frame is copied into a
+    // buffer of the peer and handed up from the peer's poll(), as a NIC
+    // would, so no device emulation cost mixes into stack measurements.
+    class VirtualEthernet : public NetDevice
+    {
+    public:
+        VirtualEthernet(uint64_t MACAddress, uint32_t queueDepth = 256);
+        ~VirtualEthernet();
+
+        // plug a and b into each other
+        static void connect(VirtualEthernet *a, VirtualEthernet *b);
+
+        virtual const char *getName() const override { return "veth"; }
+        virtual uint64_t getMACAddr() const override { return MACAddress; }
+        // hand up to budget queued frames to the wrapper
+        virtual int poll(int budget) override;
+        uint32_t getQueueLength() const { return queueLength; }
+
+    protected:
+        // copies the fragments, the completion runs before returning
+        virtual TxStatus sendFrame(const TxFragment *fragments, int count, TxCompletion completion, void *cookie) override;
+
+        VirtualEthernet *peer;
+
+    private:
+        // what the peer sent, oldest first
+        net::NetBuffer *queueHead;
+        net::NetBuffer *queueTail;
+        uint32_t queueLength;
+        net::NetBufferPool *pool;
+        uint64_t MACAddress;
+    };
+
+    // a cable from the device to itself
+    class Loopback : public VirtualEthernet
+    {
+    public:
+        Loopback(uint32_t queueDepth = 256);
+        ~Loopback();
+
+        virtual const char *getName() const override { return "lo"; }
+    };
+}
+
+}
+
+#endif
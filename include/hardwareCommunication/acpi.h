@@ -0,0 +1,77 @@
+#ifndef __HARDWARE_ACPI_H__
+#define __HARDWARE_ACPI_H__
+
+#include "common/types.h"
+
+namespace zoeos
+{
+
+namespace hardwareCommunication
+{
+    using common::uint8_t;
+    using common::uint16_t;
+    using common::uint32_t;
+    using common::uint64_t;
+
+    struct AcpiSDTHeader
+    {
+        char signature[4];
+        uint32_t length;
+        uint8_t revision;
+        uint8_t checksum;
+        char OEMID[6];
+        char OEMTableID[8];
+        uint32_t OEMRevision;
+        uint32_t creatorID;
+        uint32_t creatorRevision;
+    } __attribute__((packed));
+
+    // one PCI segment group in the MCFG table
+    struct AcpiMCFGEntry
+    {
+        uint64_t baseAddress;
+        uint16_t segment;
+        uint8_t startBus;
+        uint8_t endBus;
+        uint32_t reserved;
+    } __attribute__((packed));
+
+    class Acpi
+    {
+    public:
+        // locates the RSDP in the EBDA / BIOS area, paging is off so tables are read in place
+        Acpi();
+        ~Acpi();
+
+        bool isAvailable() const { return rootTable != nullptr; }
+        AcpiSDTHeader *findTable(const char *signature);
+
+        // the MCFG entry describing segment 0, nullptr if there is none
+        AcpiMCFGEntry *findMCFGEntry(uint16_t segment = 0);
+
+    private:
+        struct RSDPDescriptor
+        {
+            char signature[8];
+            uint8_t checksum;
+            char OEMID[6];
+            uint8_t revision;
+            uint32_t rsdtAddress;
+            // ACPI 2.0+
+            uint32_t length;
+            uint64_t xsdtAddress;
+            uint8_t extendedChecksum;
+            uint8_t reserved[3];
+        } __attribute__((packed));
+
+        static bool checksum(const void *table, uint32_t length);
+        static RSDPDescriptor *searchRSDP(uint32_t start, uint32_t length);
+
+        AcpiSDTHeader *rootTable;
+        bool extended;
+    };
+}
+
+}
+
+#endif
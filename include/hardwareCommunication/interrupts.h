@@ -100,6 +100,24 @@ namespace hardwareCommunication
         Port8BitSlow semiData;
     };
 
+    // disables interrupts for its lifetime and restores the previous state,
+    // so it nests and is safe inside interrupt routines
+    class InterruptGuard
+    {
+    public:
+        InterruptGuard()
+        {
+            __asm__ volatile("pushfl; popl %0; cli" : "=r"(eflags) : : "memory");
+        }
+        ~InterruptGuard()
+        {
+            __asm__ volatile("pushl %0; popfl" : : "r"(eflags) : "memory", "cc");
+        }
+
+    private:
+        uint32_t eflags;
+    };
+
     class InterruptRoutine
     {
     public:
@@ -0,0 +1,89 @@
+#ifndef __HARDWARE_IO_PROFILER_H__
+#define __HARDWARE_IO_PROFILER_H__
+
+#include "common/types.h"
+
+namespace zoeos
+{
+
+namespace hardwareCommunication
+{
+    // the subsystem owning a port or an MMIO window
+    enum IOSubsystem
+    {
+        IO_UNKNOWN = 0,
+        IO_PIC,
+        IO_PCI,
+        IO_KEYBOARD,
+        IO_MOUSE,
+        IO_NET,
+        IO_TIMER,
+        IO_SERIAL,
+        IO_NUM_SUBSYSTEMS
+    };
+
+    // Counts and times every port and MMIO access when the kernel is built
+    // with PROFILE_IO=1. Under a hypervisor each access is a VM exit, so the
+    // report shows which drivers cost the most exits.
+    class IOProfiler
+    {
+    public:
+        static void recordPort(common::uint16_t port, common::uint8_t subsystem, bool write, common::uint64_t cycles);
+        static void recordMMIO(common::uint32_t address, common::uint8_t subsystem, bool write, common::uint64_t cycles);
+
+        // print the topN busiest ports / MMIO addresses and a per-subsystem summary
+        static void report(int topN);
+        static void reset();
+
+        static inline common::uint64_t rdtsc()
+        {
+            common::uint32_t lo, hi;
+            __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+            return ((common::uint64_t)hi << 32) | lo;
+        }
+
+    private:
+        struct Entry
+        {
+            common::uint32_t key;
+            bool used;
+            bool mmio;
+            common::uint8_t subsystem;
+            common::uint32_t reads;
+            common::uint32_t writes;
+            common::uint64_t cycles;
+        };
+
+        struct Summary
+        {
+            common::uint32_t accesses;
+            common::uint64_t cycles;
+        };
+
+        static void record(common::uint32_t key, bool mmio, common::uint8_t subsystem, bool write, common::uint64_t cycles);
+
+        static const int tableSize = 512;
+        static Entry entries[tableSize];
+        static Summary summary[IO_NUM_SUBSYSTEMS];
+        static common::uint32_t overflow;
+    };
+}
+
+}
+
+#ifdef ZOEOS_PROFILE_IO
+#define IO_PROFILE_BEGIN() \
+    zoeos::common::uint64_t ioProfileStart_ = zoeos::hardwareCommunication::IOProfiler::rdtsc()
+#define IO_PROFILE_PORT(port, subsystem, isWrite) \
+    zoeos::hardwareCommunication::IOProfiler::recordPort(port, subsystem, isWrite, \
+        zoeos::hardwareCommunication::IOProfiler::rdtsc() - ioProfileStart_)
+#define IO_PROFILE_MMIO(address, subsystem, isWrite) \
+    zoeos::hardwareCommunication::IOProfiler::recordMMIO(address, subsystem, isWrite, \
+        zoeos::hardwareCommunication::IOProfiler::rdtsc() - ioProfileStart_)
+#else
+#define IO_PROFILE_BEGIN()
+#define IO_PROFILE_PORT(port, subsystem, isWrite)
+#define IO_PROFILE_MMIO(address, subsystem, isWrite)
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef __HARDWARE_MMIO_H__
+#define __HARDWARE_MMIO_H__
+
+#include "common/types.h"
+#include "hardwareCommunication/ioProfiler.h"
+
+namespace zoeos
+{
+
+namespace hardwareCommunication
+{
+    // memory mapped register access, counted by IOProfiler like port I/O
+
+    inline common::uint8_t mmioRead8(common::uint32_t address, common::uint8_t subsystem = IO_UNKNOWN)
+    {
+        IO_PROFILE_BEGIN();
+        common::uint8_t result = *(volatile common::uint8_t*)address;
+        IO_PROFILE_MMIO(address, subsystem, false);
+        return result;
+    }
+
+    inline common::uint16_t mmioRead16(common::uint32_t address, common::uint8_t subsystem = IO_UNKNOWN)
+    {
+        IO_PROFILE_BEGIN();
+        common::uint16_t result = *(volatile common::uint16_t*)address;
+        IO_PROFILE_MMIO(address, subsystem, false);
+        return result;
+    }
+
+    inline common::uint32_t mmioRead32(common::uint32_t address, common::uint8_t subsystem = IO_UNKNOWN)
+    {
+        IO_PROFILE_BEGIN();
+        common::uint32_t result = *(volatile common::uint32_t*)address;
+        IO_PROFILE_MMIO(address, subsystem, false);
+        return result;
+    }
+
+    inline void mmioWrite8(common::uint32_t address, common::uint8_t data, common::uint8_t subsystem = IO_UNKNOWN)
+    {
+        IO_PROFILE_BEGIN();
+        *(volatile common::uint8_t*)address = data;
+        IO_PROFILE_MMIO(address, subsystem, true);
+    }
+
+    inline void mmioWrite16(common::uint32_t address, common::uint16_t data, common::uint8_t subsystem = IO_UNKNOWN)
+    {
+        IO_PROFILE_BEGIN();
+        *(volatile common::uint16_t*)address = data;
+        IO_PROFILE_MMIO(address, subsystem, true);
+    }
+
+    inline void mmioWrite32(common::uint32_t address, common::uint32_t data, common::uint8_t subsystem = IO_UNKNOWN)
+    {
+        IO_PROFILE_BEGIN();
+        *(volatile common::uint32_t*)address = data;
+        IO_PROFILE_MMIO(address, subsystem, true);
+    }
+}
+
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include "common/types.h"
 #include "port.h"
 #include "interrupts.h"
+#include "acpi.h"
 #include "drivers/driver.h"
 
 namespace zoeos
@@ -19,9 +20,20 @@ namespace hardwareCommunication
     public:
         enum Type { MMIO = 0, IO = 1 };
 
+        BaseAddressRegister() : type(MMIO), prefetchable(false), is64Bit(false), address(nullptr), size(0) { }
+
+        Type getType() const { return type; }
+        bool isPrefetchable() const { return prefetchable; }
+        bool isWide() const { return is64Bit; }
+        // nullptr if the BAR is unimplemented or lies above 4 GiB
+        uint8_t *getAddress() const { return address; }
+        uint32_t getSize() const { return size; }
+        bool isValid() const { return address != nullptr && size != 0; }
+
     private:
         Type type;
         bool prefetchable;
+        bool is64Bit;
         uint8_t *address;
         uint32_t size;
     };
@@ -39,14 +51,25 @@ namespace hardwareCommunication
         ~PciConfigSpace();
         uint32_t getInterruptNum() const { return interrupt; }
         uint32_t getPortBase() const { return portBase; }
+        uint8_t getBus() const { return bus; }
+        uint8_t getDevice() const { return device; }
+        uint8_t getFunction() const { return function; }
+        uint16_t getVendorID() const { return vendorID; }
+        uint16_t getDeviceID() const { return deviceID; }
+        uint8_t getClassCode() const { return classCode; }
+        uint8_t getSubclass() const { return subclass; }
+        uint8_t getHeaderType() const { return headerType; }
+        const BaseAddressRegister &getBAR(int num) const { return bars[num]; }
 
     private:
+        BaseAddressRegister bars[6];
         uint32_t portBase;
         uint32_t interrupt;
 
         uint8_t bus;
         uint8_t device;
         uint8_t function;
+        uint8_t headerType;
 
         uint16_t deviceID;
         uint16_t vendorID;
@@ -56,28 +79,116 @@ namespace hardwareCommunication
         uint8_t revision;
     };
 
+    // one line of a driver's match table, PCI_ANY_ID is a wildcard
+    const uint16_t PCI_ANY_ID = 0xffff;
+
+    struct PciDeviceID
+    {
+        uint16_t vendorID;
+        uint16_t deviceID;
+        uint16_t classCode;
+        uint16_t subclass;
+    };
+
+    // a PCI driver: its match table is terminated by an entry with vendorID 0
+    struct PciDriver
+    {
+        const char *name;
+        const PciDeviceID *idTable;
+        drivers::Driver *(*probe)(PciConfigSpace *device, PciController *pci, InterruptManager *interrupts);
+    };
+
     class PciController
     {
     public:
         PciController();
         ~PciController();
 
-        uint32_t pciConfigReadWord(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
+        // offsets above 0xff are only reachable through ECAM
+        uint32_t pciConfigReadWord(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset);
+
+        void pciConfigWriteWord(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset, uint32_t value);
 
-        void pciConfigWriteWord(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value);
+        // switch config access to memory mapped ECAM when ACPI has an MCFG table
+        bool enableECAM(Acpi *acpi);
+        bool isECAMEnabled() const { return ecamBase != 0; }
+
+        // offset of a capability in the standard / PCIe extended list, 0 if absent
+        uint8_t findCapability(PciConfigSpace *device, uint8_t capabilityID);
+        uint16_t findExtendedCapability(PciConfigSpace *device, uint16_t capabilityID);
 
         bool isMultiFuncDevice(uint8_t bus, uint8_t device);
 
+        // enumerate the PCI hierarchy once and cache the result in the device table
+        void scan();
         void checkBuses(drivers::DriverManager *driverManager, InterruptManager *interrupts);
         PciConfigSpace getConfigSpace(uint8_t bus, uint8_t device, uint8_t function);
 
-        drivers::Driver *getDriver(PciConfigSpace device, InterruptManager *interrupts);
+        // device table queries, no config space access
+        int getNumDevices() const { return numDevices; }
+        PciConfigSpace *getDeviceByIndex(int index);
+        PciConfigSpace *findDevice(uint16_t vendorID, uint16_t deviceID, int start = 0);
+        PciConfigSpace *findClass(uint8_t classCode, uint8_t subclass, int start = 0);
+
+        // print the cost of the last scan
+        void reportScanCost();
+        // probe every bus/device/function like the old scan, only to compare the cost
+        void scanBruteForce();
+
+        bool registerDriver(const PciDriver *driver);
+        // probe the registered drivers whose match table covers the device
+        drivers::Driver *getDriver(PciConfigSpace *device, InterruptManager *interrupts);
 
         BaseAddressRegister getBaseAddressRegister(uint8_t bus, uint8_t device, uint8_t function, uint8_t num);
 
+        // command register bits
+        enum Command
+        {
+            COMMAND_IO_SPACE = 1 << 0,
+            COMMAND_MEMORY_SPACE = 1 << 1,
+            COMMAND_BUS_MASTER = 1 << 2,
+            COMMAND_INTERRUPT_DISABLE = 1 << 10
+        };
+        void setCommand(PciConfigSpace *device, uint16_t set, uint16_t clear = 0);
+        void enableBusMastering(PciConfigSpace *device) { setCommand(device, COMMAND_BUS_MASTER); }
+        void enableMemorySpace(PciConfigSpace *device) { setCommand(device, COMMAND_MEMORY_SPACE); }
+        void enableIOSpace(PciConfigSpace *device) { setCommand(device, COMMAND_IO_SPACE); }
+
+        // enable memory decoding and return the CPU address of an MMIO BAR, nullptr if unusable
+        void *mapBaseAddressRegister(PciConfigSpace *device, int num);
+
+        static PciController *activePci;
+
     private:
+        void scanBus(uint8_t bus);
+        // records the function, returns its header type; bit 7 marks a multifunction device
+        uint8_t scanFunction(uint8_t bus, uint8_t device, uint8_t function);
+        // decode and size one BAR, the caller must have disabled decoding
+        BaseAddressRegister sizeBaseAddressRegister(uint8_t bus, uint8_t device, uint8_t function, uint8_t num);
+
         Port32Bit dataPort;
         Port32Bit addressPort;
+
+        uint32_t ecamBase;
+        uint8_t ecamStartBus;
+        uint8_t ecamEndBus;
+
+        static bool matches(const PciDeviceID *id, PciConfigSpace *device);
+
+        static const int maxDrivers = 16;
+        const PciDriver *pciDrivers[maxDrivers];
+        int numPciDrivers;
+
+        static const int maxDevices = 64;
+        PciConfigSpace devices[maxDevices];
+        int numDevices;
+        bool scanned;
+        // one bit per bus, guards against misconfigured bridges forming loops
+        uint32_t scannedBuses[8];
+
+        uint32_t configAccesses;
+        uint32_t scanAccesses;
+        uint64_t scanCycles;
     };
 }
 
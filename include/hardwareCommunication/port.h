@@ -2,6 +2,7 @@
 #define __HARDWARE_PORT_H__
 
 #include "common/types.h"
+#include "hardwareCommunication/ioProfiler.h"
 
 namespace zoeos
 {
@@ -21,14 +22,15 @@ namespace hardwareCommunication
     {
     protected:
         uint16_t portnumber;
-        Port(uint16_t portnumber);
+        uint8_t subsystem;
+        Port(uint16_t portnumber, uint8_t subsystem = IO_UNKNOWN);
         ~Port();
     };
 
     class Port8Bit : public Port
     {
     public:
-        Port8Bit(uint16_t portnumber);
+        Port8Bit(uint16_t portnumber, uint8_t subsystem = IO_UNKNOWN);
         ~Port8Bit();
         virtual void write(uint8_t data);
         virtual uint8_t read();
@@ -37,7 +39,7 @@ namespace hardwareCommunication
     class Port8BitSlow : public Port8Bit
     {
     public:
-        Port8BitSlow(uint16_t portnumber);
+        Port8BitSlow(uint16_t portnumber, uint8_t subsystem = IO_UNKNOWN);
         ~Port8BitSlow();
         virtual void write(uint8_t data);
     };
@@ -45,7 +47,7 @@ namespace hardwareCommunication
     class Port16Bit : public Port
     {
     public:
-        Port16Bit(uint16_t portnumber);
+        Port16Bit(uint16_t portnumber, uint8_t subsystem = IO_UNKNOWN);
         ~Port16Bit();
         virtual void write(uint16_t data);
         virtual uint16_t read();
@@ -54,7 +56,7 @@ namespace hardwareCommunication
     class Port32Bit : public Port
     {
     public:
-        Port32Bit(uint16_t portnumber);
+        Port32Bit(uint16_t portnumber, uint8_t subsystem = IO_UNKNOWN);
         ~Port32Bit();
         virtual void write(uint32_t data);
         virtual uint32_t read();
@@ -34,6 +34,12 @@ private:
 
 using zoeos::common::size_t;
 
+namespace std
+{
+    // what <new> declares, the compiler passes it to new for over-aligned types
+    enum class align_val_t : size_t { };
+}
+
 void *operator new(size_t size);
 void *operator new[](size_t size);
 void *operator new(size_t size, void *ptr);
@@ -41,5 +47,14 @@ void *operator new[](size_t size, void *ptr);
 
 void operator delete(void *ptr);
 void operator delete[](void *ptr);
+void operator delete(void *ptr, size_t size);
+void operator delete[](void *ptr, size_t size);
+
+void *operator new(size_t size, std::align_val_t alignment) throw();
+void *operator new[](size_t size, std::align_val_t alignment) throw();
+void operator delete(void *ptr, std::align_val_t alignment);
+void operator delete[](void *ptr, std::align_val_t alignment);
+void operator delete(void *ptr, size_t size, std::align_val_t alignment);
+void operator delete[](void *ptr, size_t size, std::align_val_t alignment);
 
 #endif
@@ -24,8 +24,11 @@ public:
     CPUState *getCpuState() const { return cpuState; }
 
 private:
+    friend class TaskManager;
     uint8_t stack[4096];
     CPUState *cpuState;
+    // what the task sleeps on, nullptr while it can run
+    const void *volatile waitChannel;
 };
 
 class TaskManager
@@ -35,10 +38,26 @@ public:
     ~TaskManager();
 
     bool addTask(Task *task);
+    // round robin on every timer tick; the flow kernelMain ends in (its
+    // polling loop) takes part as one more task
     CPUState *schedule(CPUState *cpustate);
 
+    // Block the running task until wakeUp(channel). Call it with interrupts
+    // off after finding there is nothing to do, so a wakeUp cannot slip in
+    // between. Returns false in kernelMain's flow, which must never block.
+    bool sleep(const void *channel);
+    // make every task sleeping on channel runnable again
+    void wakeUp(const void *channel);
+    // give the rest of the time slice to the next task
+    static void yield();
+
+    // the software interrupt yield() raises, IRQ stub 0x31 above the 0x20 base
+    static const uint8_t yieldInterrupt = 0x51;
+    static TaskManager *activeTaskManager;
+
 private:
     Task *tasks[256];
+    CPUState *kernelState;
     int numTasks;
     int currentTask;
 };
@@ -0,0 +1,123 @@
+#ifndef __NET_ARP_H__
+#define __NET_ARP_H__
+
+#include "common/types.h"
+#include "net/etherframe.h"
+#include "net/netBuffer.h"
+
+// neighbor cache size in sets of four entries, a power of two
+#ifndef ZOEOS_ARP_CACHE_SETS
+#define ZOEOS_ARP_CACHE_SETS 32
+#endif
+
+namespace zoeos
+{
+
+namespace net
+{
+    struct AddressResolutionProtocolMessage
+    {
+        common::uint16_t hardwareType;
+        common::uint16_t protocol;
+        common::uint8_t hardwareAddressSize;
+        common::uint8_t protocolAddressSize;
+        common::uint16_t command;
+
+        common::uint64_t srcMAC : 48;
+        common::uint32_t srcIP;
+        common::uint64_t dstMAC : 48;
+        common::uint32_t dstIP;
+    } __attribute__((packed));
+
+    struct ArpStatistics
+    {
+        common::uint32_t requestsSent;
+        common::uint32_t requestsReceived;
+        common::uint32_t repliesSent;
+        common::uint32_t repliesReceived;
+        common::uint32_t cacheHits;
+        common::uint32_t cacheMisses;
+        // packets given up on: queue full or the neighbor never answered
+        common::uint32_t queueDrops;
+        common::uint32_t resolutionFailures;
+        common::uint32_t malformed;
+    } ZOEOS_CACHE_ALIGNED;
+
+    // ARP for IPv4 over Ethernet. IP addresses are in network byte order
+    // as loaded from a packet, like EtherFrameHeader's fields.
+    class AddressResolutionProtocol : public EtherFrameHandler
+    {
+    public:
+        AddressResolutionProtocol(EtherFrameWrapper *etherFrameWrapper, common::uint32_t ipAddress_BE);
+        ~AddressResolutionProtocol();
+
+        virtual bool onEtherFrameReceived(common::uint8_t *etherframePayload, common::uint32_t size) override;
+
+        // The IPv4 transmit path: known neighbors are sent to at once, others
+        // get a request and up to maxPending packets are copied and held
+        // until the reply comes (TX_QUEUED) or resolution fails.
+        drivers::TxStatus sendIPv4(common::uint32_t nextHopIP_BE, const drivers::TxFragment *fragments, int count,
+                drivers::TxCompletion completion = nullptr, void *cookie = nullptr);
+        // the cached MAC, 0 if unknown; stale entries are refreshed in the background
+        common::uint64_t resolve(common::uint32_t ipAddress_BE);
+        void requestMACAddress(common::uint32_t ipAddress_BE);
+        // tell the segment who we are
+        void announce();
+
+        common::uint32_t getIPAddress() const { return ipAddress; }
+        const ArpStatistics &getStatistics() const { return stats; }
+
+    private:
+        enum State
+        {
+            FREE = 0,
+            INCOMPLETE,
+            REACHABLE,
+            STALE
+        };
+
+        struct Neighbor
+        {
+            common::uint32_t ipAddress;
+            common::uint8_t state;
+            common::uint8_t retries;
+            common::uint8_t numPending;
+            common::uint64_t MACAddress;
+            // when the MAC was last confirmed and the last request went out
+            common::uint64_t confirmed;
+            common::uint64_t requested;
+            // frames waiting for the reply, oldest first
+            NetBuffer *pendingHead;
+            NetBuffer *pendingTail;
+        };
+
+        // in milliseconds
+        static const common::uint32_t reachableTime = 60000;
+        static const common::uint32_t staleTime = 600000;
+        static const common::uint32_t retransmitTime = 1000;
+        static const common::uint8_t maxRetries = 3;
+        static const common::uint8_t maxPending = 4;
+        static const int ways = 4;
+
+        Neighbor *lookup(common::uint32_t ipAddress_BE);
+        // the entry for ipAddress_BE, evicting the least recently confirmed one of its set
+        Neighbor *insert(common::uint32_t ipAddress_BE);
+        void update(Neighbor *neighbor, common::uint64_t MACAddress);
+        void sendRequest(Neighbor *neighbor);
+        void sendMessage(common::uint16_t command, common::uint64_t dstMAC, common::uint32_t dstIP, common::uint64_t etherDstMAC);
+        void flushPending(Neighbor *neighbor);
+        void dropPending(Neighbor *neighbor);
+        static common::uint64_t now();
+        // retransmits, ages and gives up, from the system timer
+        static void tick(void *arp);
+
+        Neighbor cache[ZOEOS_ARP_CACHE_SETS * ways];
+        NetBufferPool *pendingPool;
+        common::uint32_t ipAddress;
+        ArpStatistics stats;
+    };
+}
+
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef __NET_BENCHMARK_H__
+#define __NET_BENCHMARK_H__
+
+#include "common/types.h"
+
+namespace zoeos
+{
+
+namespace net
+{
+    // Pushes frames through EtherFrameWrapper without a NIC and prints the
+    // cycles per frame of: onRawDataReceived called directly, a veth pair
+    // (copy, queue, poll, dispatch) and the loopback device.
+    void benchmarkEtherFrame(common::uint32_t frames);
+}
+
+}
+
+#endif
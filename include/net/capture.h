@@ -0,0 +1,81 @@
+#ifndef __NET_CAPTURE_H__
+#define __NET_CAPTURE_H__
+
+#include "common/types.h"
+#include "drivers/netDevice.h"
+#include "drivers/serial.h"
+
+// records the ring holds, a power of two
+#ifndef ZOEOS_CAPTURE_SLOTS
+#define ZOEOS_CAPTURE_SLOTS 256
+#endif
+
+// bytes kept of every frame: Ethernet, IPv4 and TCP headers with all
+// their options take 14 + 60 + 60 = 134
+#ifndef ZOEOS_CAPTURE_SNAPLEN
+#define ZOEOS_CAPTURE_SNAPLEN 160
+#endif
+
+namespace zoeos
+{
+
+namespace net
+{
+    // Copies frames seen by a RawDataWrapper into a preallocated ring, any
+    // task may record while one drain task streams the ring to a serial port
+    // as a pcap file (qemu -serial file:capture.pcap). A full ring drops and
+    // counts the record instead of waiting.
+    class PacketCapture
+    {
+    public:
+        PacketCapture(drivers::SerialPort *serial, common::uint32_t slots = ZOEOS_CAPTURE_SLOTS,
+                common::uint32_t snapLength = ZOEOS_CAPTURE_SNAPLEN);
+        ~PacketCapture();
+
+        void record(const drivers::TxFragment *fragments, int count);
+        void record(const common::uint8_t *frame, common::uint32_t size);
+
+        // write out what is in the ring, the pcap header first; returns records written
+        int drain();
+        common::uint32_t getDrops() const { return drops; }
+        // the port the pcap stream owns, nobody else may write to it
+        drivers::SerialPort *getSerial() const { return serial; }
+
+        // entry point for a Task, drains activeCapture forever
+        static void drainTask();
+        static PacketCapture *activeCapture;
+
+    private:
+        struct Slot
+        {
+            // lock-free ring: the position the slot may be written at, +1 once filled
+            volatile common::uint32_t sequence;
+            common::uint32_t length;
+            common::uint32_t captured;
+            common::uint64_t timestamp;
+            common::uint8_t data[];
+        };
+
+        Slot *slot(common::uint32_t position) const { return (Slot*)(storage + (position & (slots - 1)) * slotSize); }
+        // claim a slot, nullptr if the ring is full
+        Slot *reserve();
+        void commit(Slot *slot);
+        void writeHeader();
+
+        drivers::SerialPort *serial;
+        common::uint8_t *storage;
+        common::uint32_t slots;
+        common::uint32_t slotSize;
+        common::uint32_t snapLength;
+        volatile common::uint32_t head;
+        common::uint32_t tail;
+        volatile common::uint32_t drops;
+        common::uint32_t reportedDrops;
+        common::uint64_t startTsc;
+        bool headerWritten;
+    };
+}
+
+}
+
+#endif
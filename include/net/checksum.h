@@ -0,0 +1,59 @@
+#ifndef __NET_CHECKSUM_H__
+#define __NET_CHECKSUM_H__
+
+#include "common/types.h"
+
+// Shorter runs take the scalar loop. The crossover was not measured in the
+// kernel: make checksumBench runs hosted on x86-64, where SSE2 pulls ahead
+// between 384 and 576 bytes both at -O2 and with BENCH_OPT=-O0 (the kernel's
+// unoptimized build). Neither counts the cli the kernel's SSE2 loop runs under.
+#ifndef ZOEOS_CHECKSUM_SSE2_MIN
+#define ZOEOS_CHECKSUM_SSE2_MIN 576
+#endif
+
+namespace zoeos
+{
+
+namespace net
+{
+    // RFC 1071 one's complement sums. 16-bit words are loaded little-endian,
+    // the sum does not care, so results are stored as they are. A partial
+    // sum is folded to 16 bits: partial sums of pieces add up, and finish()
+    // turns one into the field to store.
+    class InternetChecksum
+    {
+    public:
+        // use SSE2 if the CPU has it; sets CR0 and CR4 for it in the kernel
+        static void enableSSE2();
+        static bool hasSSE2() { return useSSE2; }
+
+        // the checksum field for size bytes
+        static common::uint16_t compute(const common::uint8_t *data, common::uint32_t size) { return finish(partial(data, size)); }
+
+        // adds size bytes to sum, which must end at an even offset; picks a loop by size
+        static common::uint32_t partial(const common::uint8_t *data, common::uint32_t size, common::uint32_t sum = 0);
+        // 32-bit loads, 32 bytes a round, into a 64-bit accumulator
+        static common::uint32_t partialScalar(const common::uint8_t *data, common::uint32_t size, common::uint32_t sum = 0);
+        // 64 bytes a round in XMM registers with interrupts off, only once hasSSE2()
+        static common::uint32_t partialSSE2(const common::uint8_t *data, common::uint32_t size, common::uint32_t sum = 0);
+        // copies size bytes to dst and sums them in the same pass
+        static common::uint32_t copyPartial(common::uint8_t *dst, const common::uint8_t *src, common::uint32_t size,
+                common::uint32_t sum = 0);
+        // adds the partial sum of a piece that starts offset bytes into the data
+        static common::uint32_t combine(common::uint32_t sum, common::uint32_t piece, common::uint32_t offset);
+
+        static common::uint32_t fold(common::uint64_t sum);
+        static common::uint16_t finish(common::uint32_t sum) { return ~fold(sum); }
+
+        // RFC 1624: the checksum after a 16-bit or 32-bit field changed from oldValue to newValue
+        static common::uint16_t adjust(common::uint16_t checksum, common::uint16_t oldValue, common::uint16_t newValue);
+        static common::uint16_t adjust32(common::uint16_t checksum, common::uint32_t oldValue, common::uint32_t newValue);
+
+    private:
+        static bool useSSE2;
+    };
+}
+
+}
+
+#endif
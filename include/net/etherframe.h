@@ -2,7 +2,7 @@
 #define __NET_H__
 
 #include "common/types.h"
-#include "drivers/amd_am79c973.h"
+#include "drivers/netDevice.h"
 #include "memoryManager.h"
 
 namespace zoeos
@@ -17,20 +17,55 @@ namespace net
         uint16_t etherType_BE;
     } __attribute__((packed));
 
+    struct EtherFrameStatistics
+    {
+        common::uint32_t rxFrames;
+        common::uint32_t txFrames;
+        // shorter than the header
+        common::uint32_t rxRunts;
+        // for another station's MAC
+        common::uint32_t notForUs;
+        // nobody handles the EtherType
+        common::uint32_t unknownType;
+    } ZOEOS_CACHE_ALIGNED;
+
     class EtherFrameHandler;
 
     class EtherFrameWrapper : public drivers::RawDataWrapper
     {
         friend class EtherFrameHandler;
     public:
-        EtherFrameWrapper(drivers::AMD_AM79C973 *backend);
+        EtherFrameWrapper(drivers::NetDevice *backend);
         ~EtherFrameWrapper();
 
-        virtual bool onRawDataReceived(uint8_t *buffer, uint32_t size) override;
-        void send(common::uint64_t dstMAC, common::uint16_t etherType, common::uint8_t* buffer, common::uint32_t size);
-        
+        virtual bool onRawDataReceived(drivers::NetDevice *device, uint8_t *buffer, uint32_t size) override;
+        // Without a completion the payload is copied. With one it is sent in
+        // place and must not change until completion(cookie) is called.
+        // The frame leaves through route(dstMAC), with that device's MAC as source.
+        drivers::TxStatus send(common::uint64_t dstMAC, common::uint16_t etherType, common::uint8_t* buffer, common::uint32_t size,
+                drivers::TxCompletion completion = nullptr, void *cookie = nullptr);
+        // the payload in up to NetDevice::maxFragments - 1 pieces
+        drivers::TxStatus send(common::uint64_t dstMAC, common::uint16_t etherType, const drivers::TxFragment *payload, int count,
+                drivers::TxCompletion completion = nullptr, void *cookie = nullptr);
+
+        const EtherFrameStatistics &getStatistics() const { return stats; }
+
     private:
-        EtherFrameHandler *handlers[65536];
+        // etherType_BE as read from the frame, nullptr if nobody handles it
+        EtherFrameHandler *findHandler(common::uint16_t etherType_BE) const;
+        bool registerHandler(common::uint16_t etherType_BE, EtherFrameHandler *handler);
+        void unregisterHandler(common::uint16_t etherType_BE);
+
+        // fast paths for what nearly every frame carries
+        EtherFrameHandler *ipv4Handler;
+        EtherFrameHandler *arpHandler;
+        EtherFrameHandler *ipv6Handler;
+        // anything else, scanned linearly: the types share one cache line
+        static const int maxHandlers = 8;
+        common::uint16_t otherTypes[maxHandlers];
+        EtherFrameHandler *otherHandlers[maxHandlers];
+        int numOtherHandlers;
+        EtherFrameStatistics stats;
     };
 
     class EtherFrameHandler
@@ -39,9 +74,10 @@ namespace net
         EtherFrameHandler(EtherFrameWrapper *etherFrameWrapper_, uint16_t etherType_);
         ~EtherFrameHandler();
 
-        bool onEtherFrameReceived(uint8_t *payload, uint32_t size);
-        void send(common::uint64_t dstMAC, common::uint8_t* etherframePayload, common::uint32_t size);
-    private:
+        virtual bool onEtherFrameReceived(uint8_t *payload, uint32_t size);
+        drivers::TxStatus send(common::uint64_t dstMAC, common::uint8_t* etherframePayload, common::uint32_t size,
+                drivers::TxCompletion completion = nullptr, void *cookie = nullptr);
+    protected:
         EtherFrameWrapper* etherFrameWrapper;
         uint16_t etherType;
     };
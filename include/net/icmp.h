@@ -0,0 +1,77 @@
+#ifndef __NET_ICMP_H__
+#define __NET_ICMP_H__
+
+#include "common/types.h"
+#include "net/ipv4.h"
+
+namespace zoeos
+{
+
+namespace net
+{
+    // destination unreachable codes
+    enum IcmpUnreachableCode
+    {
+        ICMP_NET_UNREACHABLE = 0,
+        ICMP_HOST_UNREACHABLE = 1,
+        ICMP_PROTOCOL_UNREACHABLE = 2,
+        ICMP_PORT_UNREACHABLE = 3,
+        ICMP_FRAGMENTATION_NEEDED = 4
+    };
+
+    struct InternetControlMessageProtocolMessage
+    {
+        common::uint8_t type;
+        common::uint8_t code;
+        common::uint16_t checksum;
+        // identifier and sequence number for echo, unused for errors
+        common::uint32_t data;
+    } __attribute__((packed));
+
+    struct IcmpStatistics
+    {
+        common::uint32_t echoRequests;
+        common::uint32_t echoReplies;
+        common::uint32_t errorsReceived;
+        common::uint32_t errorsSent;
+        // errors not sent because of the rate limit
+        common::uint32_t errorsSuppressed;
+        common::uint32_t malformed;
+    } ZOEOS_CACHE_ALIGNED;
+
+    // Answers pings in the receive buffer: the type and both checksums are
+    // patched, nothing is allocated or copied, and the driver resends the
+    // frame it received. Error messages go through a token bucket.
+    class InternetControlMessageProtocol : public InternetProtocolHandler
+    {
+    public:
+        InternetControlMessageProtocol(InternetProtocolProvider *backend);
+        ~InternetControlMessageProtocol();
+
+        virtual bool onInternetProtocolReceived(common::uint32_t srcIP_BE, common::uint32_t dstIP_BE,
+                common::uint8_t *payload, common::uint32_t size) override;
+
+        // about original, a received datagram of size bytes; quoted are its header and 8 bytes
+        void sendDestinationUnreachable(common::uint8_t code, const InternetProtocolV4Message *original, common::uint32_t size);
+        void sendTimeExceeded(common::uint8_t code, const InternetProtocolV4Message *original, common::uint32_t size);
+
+        const IcmpStatistics &getStatistics() const { return stats; }
+
+    private:
+        void sendError(common::uint8_t type, common::uint8_t code, const InternetProtocolV4Message *original, common::uint32_t size);
+        // takes a token if one is left
+        bool allowError();
+
+        // errorBurst errors at once, then errorsPerSecond
+        static const common::uint32_t errorsPerSecond = 100;
+        static const common::uint32_t errorBurst = 10;
+        // in timer ticks, up to errorBurst errors' worth
+        common::uint64_t errorCredit;
+        common::uint64_t lastRefill;
+        IcmpStatistics stats;
+    };
+}
+
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef __NET_IPV4_H__
+#define __NET_IPV4_H__
+
+#include "common/types.h"
+#include "net/etherframe.h"
+#include "net/arp.h"
+#include "net/checksum.h"
+
+// the largest datagram put back together from fragments
+#ifndef ZOEOS_IP_REASSEMBLY_SIZE
+#define ZOEOS_IP_REASSEMBLY_SIZE 8192
+#endif
+
+namespace zoeos
+{
+
+namespace net
+{
+    struct InternetProtocolV4Message
+    {
+        common::uint8_t headerLength : 4;
+        common::uint8_t version : 4;
+        common::uint8_t typeOfService;
+        common::uint16_t totalLength;
+
+        common::uint16_t identification;
+        common::uint16_t flagsAndOffset;
+
+        common::uint8_t timeToLive;
+        common::uint8_t protocol;
+        common::uint16_t checksum;
+
+        common::uint32_t srcIP;
+        common::uint32_t dstIP;
+    } __attribute__((packed));
+
+    struct IPv4Statistics
+    {
+        common::uint32_t rxPackets;
+        // dropped: bad version, length or checksum, or not for us
+        common::uint32_t headerErrors;
+        common::uint32_t addressErrors;
+        common::uint32_t unknownProtocol;
+        common::uint32_t fragmentsReceived;
+        common::uint32_t reassembled;
+        // timed out, evicted or larger than ZOEOS_IP_REASSEMBLY_SIZE
+        common::uint32_t reassemblyFailures;
+        common::uint32_t txPackets;
+        common::uint32_t fragmentsCreated;
+        common::uint32_t noRoute;
+    } ZOEOS_CACHE_ALIGNED;
+
+    struct IPv4ProtocolStatistics
+    {
+        common::uint32_t rxPackets;
+        common::uint32_t rxBytes;
+        common::uint32_t txPackets;
+        common::uint32_t txBytes;
+    } ZOEOS_CACHE_ALIGNED;
+
+    class InternetProtocolHandler;
+    class InternetControlMessageProtocol;
+
+    // IPv4 on top of ARP. Addresses and masks are in network byte order as
+    // loaded from a packet. Received datagrams are parsed in the receive
+    // buffer; only fragments are copied, into a few reassembly buffers.
+    class InternetProtocolProvider : public EtherFrameHandler
+    {
+        friend class InternetProtocolHandler;
+        friend class InternetControlMessageProtocol;
+    public:
+        // a route to subnetMask's network on the link and, unless 0, a default one via gatewayIP
+        InternetProtocolProvider(EtherFrameWrapper *etherFrameWrapper, AddressResolutionProtocol *arp,
+                common::uint32_t ipAddress_BE, common::uint32_t subnetMask_BE, common::uint32_t gatewayIP_BE);
+        ~InternetProtocolProvider();
+
+        virtual bool onEtherFrameReceived(common::uint8_t *etherframePayload, common::uint32_t size) override;
+
+        // Datagrams larger than the MTU are fragmented, the fragments are
+        // copied and completion runs before this returns.
+        drivers::TxStatus send(common::uint32_t dstIP_BE, common::uint8_t protocol, const drivers::TxFragment *payload, int count,
+                drivers::TxCompletion completion = nullptr, void *cookie = nullptr);
+
+        // gatewayIP_BE 0 means the network is on the link
+        bool addRoute(common::uint32_t network_BE, common::uint8_t prefixLength, common::uint32_t gatewayIP_BE);
+        void removeRoute(common::uint32_t network_BE, common::uint8_t prefixLength);
+        // the next hop of the longest matching prefix, 0 if there is none
+        common::uint32_t route(common::uint32_t dstIP_BE);
+
+        // For handlers: keep the frame holding the payload being delivered, see
+        // RawDataWrapper::claimReceiveBuffer. nullptr for reassembled datagrams.
+        NetBuffer *claimReceiveBuffer();
+        // for handlers: answer the datagram being delivered with an ICMP destination unreachable
+        void reportUnreachable(common::uint8_t code);
+
+        common::uint32_t getIPAddress() const { return ipAddress; }
+        // the largest datagram sent unfragmented
+        common::uint16_t getMTU() const { return mtu; }
+        const IPv4Statistics &getStatistics() const { return stats; }
+        // nullptr if nobody handles protocol
+        const IPv4ProtocolStatistics *getProtocolStatistics(common::uint8_t protocol) const;
+
+    private:
+        bool registerHandler(common::uint8_t protocol, InternetProtocolHandler *handler);
+        void unregisterHandler(common::uint8_t protocol);
+        // hand a datagram to its protocol, true if the handler wants the payload sent back
+        bool deliver(common::uint8_t protocol, common::uint32_t srcIP_BE, common::uint32_t dstIP_BE,
+                common::uint8_t *payload, common::uint32_t size);
+        void reassemble(InternetProtocolV4Message *ip, common::uint8_t *payload, common::uint32_t size);
+        drivers::TxStatus transmit(common::uint32_t dstIP_BE, const drivers::TxFragment *fragments, int count,
+                drivers::TxCompletion completion, void *cookie);
+        void fillHeader(InternetProtocolV4Message *ip, common::uint32_t dstIP_BE, common::uint8_t protocol,
+                common::uint16_t totalLength, common::uint16_t flagsAndOffset);
+        // ages the reassembly buffers once a second
+        static void tick(void *ip);
+
+        struct Route
+        {
+            common::uint32_t network;
+            common::uint32_t mask;
+            common::uint32_t gateway;
+            common::uint8_t prefixLength;
+        };
+
+        struct Reassembly
+        {
+            common::uint32_t srcIP;
+            common::uint32_t dstIP;
+            common::uint16_t identification;
+            common::uint8_t protocol;
+            // seconds until it is given up, 0 for a free buffer
+            common::uint8_t timeLeft;
+            // payload length, known once the last fragment is in
+            common::uint32_t totalLength;
+            // one bit per 8-byte fragment block received
+            common::uint32_t blocks[ZOEOS_IP_REASSEMBLY_SIZE / 8 / 32];
+            common::uint8_t *data;
+        };
+
+        // the table is kept longest prefix first, the first match wins
+        static const int maxRoutes = 16;
+        Route routes[maxRoutes];
+        int numRoutes;
+        // the last lookup; consecutive sends mostly go to one destination
+        common::uint32_t cachedDestination;
+        common::uint32_t cachedNextHop;
+
+        // protocol number -> 1 + index into handlers, 0 for none
+        static const int maxProtocols = 8;
+        common::uint8_t protocolSlot[256];
+        InternetProtocolHandler *handlers[maxProtocols];
+        IPv4ProtocolStatistics protocolStats[maxProtocols];
+
+        static const int maxReassemblies = 4;
+        static const common::uint8_t reassemblyTimeout = 30;
+        Reassembly reassemblies[maxReassemblies];
+
+        AddressResolutionProtocol *arp;
+        // reports undeliverable datagrams, if there is one
+        InternetControlMessageProtocol *icmp;
+        common::uint32_t ipAddress;
+        common::uint32_t subnetMask;
+        common::uint16_t mtu;
+        common::uint16_t nextIdentification;
+        // the datagram being delivered from a received frame, nullptr if reassembled
+        InternetProtocolV4Message *delivering;
+        common::uint32_t deliveringSize;
+        IPv4Statistics stats;
+    };
+
+    class InternetProtocolHandler
+    {
+    public:
+        InternetProtocolHandler(InternetProtocolProvider *backend_, common::uint8_t protocol_);
+        ~InternetProtocolHandler();
+
+        // return true to send the (modified) payload back to srcIP_BE
+        virtual bool onInternetProtocolReceived(common::uint32_t srcIP_BE, common::uint32_t dstIP_BE,
+                common::uint8_t *payload, common::uint32_t size);
+        drivers::TxStatus send(common::uint32_t dstIP_BE, common::uint8_t *payload, common::uint32_t size,
+                drivers::TxCompletion completion = nullptr, void *cookie = nullptr);
+        drivers::TxStatus send(common::uint32_t dstIP_BE, const drivers::TxFragment *payload, int count,
+                drivers::TxCompletion completion = nullptr, void *cookie = nullptr);
+
+    protected:
+        InternetProtocolProvider *backend;
+        common::uint8_t protocol;
+    };
+}
+
+}
+
+#endif
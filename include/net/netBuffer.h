@@ -0,0 +1,67 @@
+#ifndef __NET_BUFFER_H__
+#define __NET_BUFFER_H__
+
+#include "common/types.h"
+
+namespace zoeos
+{
+
+namespace net
+{
+    using common::uint8_t;
+    using common::uint32_t;
+
+    class NetBufferPool;
+
+    // what the NIC already verified on a received frame
+    enum NetBufferChecksum
+    {
+        CHECKSUM_NONE = 0,
+        CHECKSUM_IP_OK = 1 << 0,
+        CHECKSUM_L4_OK = 1 << 1
+    };
+
+    // a frame buffer; whoever holds the pointer owns it and must release() it
+    struct NetBuffer
+    {
+        // start of the storage, data may sit behind some headroom
+        uint8_t *head;
+        uint8_t *data;
+        uint32_t size;
+        // NetBufferChecksum bits
+        uint8_t checksum;
+        NetBuffer *next;
+        NetBufferPool *pool;
+
+        void release();
+    };
+
+    // Fixed-size frame buffers carved out of one allocation. alloc/free are
+    // O(1) and safe to use from interrupt routines.
+    class NetBufferPool
+    {
+    public:
+        NetBufferPool(uint32_t count, uint32_t bufferSize = 1536);
+        ~NetBufferPool();
+
+        NetBuffer *alloc();
+        void free(NetBuffer *buffer);
+
+        uint32_t getNumBuffers() const { return count; }
+        uint32_t getNumFree() const { return numFree; }
+        uint32_t getBufferSize() const { return bufferSize; }
+
+    private:
+        NetBuffer *buffers;
+        // the allocation the aligned frame storage was carved from
+        void *storage;
+        NetBuffer *freeList;
+        uint32_t count;
+        uint32_t numFree;
+        uint32_t bufferSize;
+    };
+}
+
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef __NET_NETSTAT_H__
+#define __NET_NETSTAT_H__
+
+#include "common/types.h"
+
+// Counter structs start a cache line of their own, so a hot counter never
+// shares one with the fields around it. Heap objects holding them come from
+// the aligned operator new.
+#define ZOEOS_CACHE_LINE 64
+#define ZOEOS_CACHE_ALIGNED __attribute__((aligned(ZOEOS_CACHE_LINE)))
+
+// a field of a counter struct, for NetStatistics::add
+#define NETSTAT_FIELD(type, field) { #field, __builtin_offsetof(type, field), sizeof(((type*)0)->field) }
+
+namespace zoeos
+{
+
+namespace net
+{
+    struct NetStatField
+    {
+        const char *name;
+        common::uint16_t offset;
+        // 4 or 8 bytes
+        common::uint8_t size;
+    };
+
+    // Every device's and every layer's counters by name. The layers keep
+    // incrementing their own structs; the registry only knows where they
+    // are and reads them when it dumps.
+    class NetStatistics
+    {
+    public:
+        enum Format
+        {
+            // a block per group, for people
+            TEXT,
+            // group.counter=value lines between netstat.begin and netstat.end, for diffing
+            KEY_VALUE
+        };
+
+        // counters described by fields; index >= 0 is appended to the name (eth0)
+        static bool add(const char *name, int index, const void *counters, const NetStatField *fields, int numFields);
+        static void remove(const void *counters);
+
+        // all groups out of COM1; to the console instead while a PacketCapture streams to COM1
+        static void dump(Format format);
+        // from interrupt routines: the dump happens at the next poll()
+        static void requestDump(Format format);
+        // called from kernelMain's loop
+        static void poll();
+
+    private:
+        struct Group
+        {
+            const char *name;
+            int index;
+            const void *counters;
+            const NetStatField *fields;
+            int numFields;
+        };
+
+        static const int maxGroups = 32;
+        static Group groups[maxGroups];
+        static int numGroups;
+        // Format + 1, 0 for none
+        static volatile int pendingDump;
+    };
+}
+
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef __NET_PKTGEN_H__
+#define __NET_PKTGEN_H__
+
+#include "common/types.h"
+#include "net/etherframe.h"
+
+// frames per second the generator aims at, 0 sends flat out
+#ifndef ZOEOS_PKTGEN_RATE
+#define ZOEOS_PKTGEN_RATE 0
+#endif
+
+// Ethernet frame size without FCS, 60 to 1514
+#ifndef ZOEOS_PKTGEN_FRAME_SIZE
+#define ZOEOS_PKTGEN_FRAME_SIZE 60
+#endif
+
+namespace zoeos
+{
+
+namespace net
+{
+    // IEEE local experimental EtherType, carried by generated frames
+    const common::uint16_t PKTGEN_ETHER_TYPE = 0x88b5;
+
+    // Sends numbered frames through EtherFrameWrapper::send at a fixed rate
+    // or flat out from its own task, reporting every second.
+    class PacketGenerator
+    {
+    public:
+        // count 0 sends forever, rate 0 as fast as the NIC takes them
+        PacketGenerator(EtherFrameWrapper *etherFrameWrapper, common::uint64_t dstMAC,
+                common::uint32_t frameSize = ZOEOS_PKTGEN_FRAME_SIZE,
+                common::uint32_t rate = ZOEOS_PKTGEN_RATE, common::uint32_t count = 0);
+        ~PacketGenerator();
+
+        // the task body, never returns
+        void run();
+        // entry point for a Task, runs activeGenerator
+        static void taskEntry();
+        static PacketGenerator *activeGenerator;
+
+    private:
+        EtherFrameWrapper *etherFrameWrapper;
+        common::uint64_t dstMAC;
+        common::uint32_t frameSize;
+        common::uint32_t rate;
+        common::uint32_t count;
+        common::uint8_t payload[1500];
+    };
+
+    // Counts the generator's frames and reports pps, Mbit/s and losses every second.
+    class PacketSink : public EtherFrameHandler
+    {
+    public:
+        PacketSink(EtherFrameWrapper *etherFrameWrapper);
+        ~PacketSink();
+
+        virtual bool onEtherFrameReceived(common::uint8_t *payload, common::uint32_t size) override;
+
+    private:
+        void report();
+
+        EtherFrameWrapper *wrapper;
+        common::uint64_t frames;
+        common::uint64_t bytes;
+        // sequence numbers that never arrived
+        common::uint64_t lost;
+        common::uint32_t expected;
+        common::uint64_t lastReportTick;
+        common::uint64_t lastReportFrames;
+        common::uint64_t lastReportBytes;
+        common::uint64_t lastReportLost;
+        common::uint64_t lastDeviceDrops;
+    };
+}
+
+}
+
+#endif
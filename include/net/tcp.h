@@ -0,0 +1,287 @@
+#ifndef __NET_TCP_H__
+#define __NET_TCP_H__
+
+#include "common/types.h"
+#include "net/ipv4.h"
+#include "net/netBuffer.h"
+#include "poller.h"
+
+// bytes of send and of receive buffer per connection, a power of two
+#ifndef ZOEOS_TCP_BUFFER_SIZE
+#define ZOEOS_TCP_BUFFER_SIZE 65536
+#endif
+
+namespace zoeos
+{
+
+namespace net
+{
+    struct TransmissionControlProtocolHeader
+    {
+        common::uint16_t srcPort;
+        common::uint16_t dstPort;
+        common::uint32_t sequenceNumber;
+        common::uint32_t acknowledgementNumber;
+
+        common::uint8_t reserved : 4;
+        // in 32-bit words, options included
+        common::uint8_t headerSize32 : 4;
+        common::uint8_t flags;
+
+        common::uint16_t windowSize;
+        common::uint16_t checksum;
+        common::uint16_t urgentPointer;
+    } __attribute__((packed));
+
+    enum TransmissionControlProtocolSocketState
+    {
+        TCP_CLOSED = 0,
+        TCP_LISTEN,
+        TCP_SYN_SENT,
+        TCP_SYN_RECEIVED,
+        TCP_ESTABLISHED,
+        TCP_FIN_WAIT1,
+        TCP_FIN_WAIT2,
+        TCP_CLOSING,
+        TCP_TIME_WAIT,
+        TCP_CLOSE_WAIT,
+        TCP_LAST_ACK
+    };
+
+    struct TcpStatistics
+    {
+        common::uint32_t activeOpens;
+        common::uint32_t passiveOpens;
+        // refused, timed out or no room in the accept queue
+        common::uint32_t failedOpens;
+        common::uint32_t resetsReceived;
+        common::uint32_t resetsSent;
+        common::uint64_t segmentsIn;
+        common::uint64_t segmentsOut;
+        // bad length, offset or checksum
+        common::uint32_t badSegments;
+        common::uint32_t retransmits;
+        common::uint32_t fastRetransmits;
+        common::uint32_t timeouts;
+        common::uint32_t outOfOrder;
+    } ZOEOS_CACHE_ALIGNED;
+
+    class TransmissionControlProtocolProvider;
+
+    // One end of a connection, or a listening port. Bytes sent wait in a
+    // ring until acknowledged, received bytes, in order or not, go straight
+    // to their place in the receive ring. Calls block the calling task by
+    // sleeping in the scheduler; kernelMain's flow gets -1 / nullptr instead.
+    // A listener is POLL_IN with a connection to accept; a connection is
+    // POLL_IN with data or the peer's FIN to read, POLL_OUT with room in the
+    // send ring, POLL_HUP after the FIN or once closed, POLL_ERR on a reset.
+    class TransmissionControlProtocolSocket : public PollSource
+    {
+        friend class TransmissionControlProtocolProvider;
+    public:
+        // queue up to size bytes, all of them when blocking; -1 once the connection is gone
+        int send(const common::uint8_t *data, common::uint32_t size, bool block = true);
+        // up to size bytes, 0 after the peer closed, -1 if nothing is there or on a reset
+        int receive(common::uint8_t *buffer, common::uint32_t size, bool block = true);
+        // the next established connection of a listening socket
+        TransmissionControlProtocolSocket *accept(bool block = true);
+        // send a FIN after the queued data; the socket is freed once the
+        // connection is over and must not be used after this
+        void close();
+        // send segments shorter than the MSS at once instead of waiting for an ACK (Nagle off)
+        void setNoDelay(bool noDelay_) { noDelay = noDelay_; }
+
+        TransmissionControlProtocolSocketState getState() const { return state; }
+        // bytes queued but not yet acknowledged
+        common::uint32_t getUnacknowledged() const { return sndEnd - dataStart(sndUna); }
+
+        virtual common::uint32_t pollEvents() const override;
+
+    private:
+        TransmissionControlProtocolSocket(TransmissionControlProtocolProvider *backend);
+        ~TransmissionControlProtocolSocket();
+
+        struct SackBlock
+        {
+            common::uint32_t start;
+            common::uint32_t end;
+        };
+
+        static const int maxSackBlocks = 4;
+        static const int backlog = 8;
+
+        // the first data sequence number at or after seq: the SYN takes one
+        common::uint32_t dataStart(common::uint32_t seq) const { return seq == iss ? iss + 1 : seq; }
+        common::uint32_t receiveWindow() const;
+
+        TransmissionControlProtocolProvider *backend;
+        TransmissionControlProtocolSocketState state;
+        common::uint32_t localIP;
+        common::uint32_t remoteIP;
+        common::uint16_t localPort_BE;
+        common::uint16_t remotePort_BE;
+
+        // RFC 793 send sequence space; sndMax is the highest ever sent, sndEnd
+        // the end of the queued data, the FIN takes sndEnd if there is one
+        common::uint32_t iss;
+        common::uint32_t sndUna;
+        common::uint32_t sndNxt;
+        common::uint32_t sndMax;
+        common::uint32_t sndEnd;
+        common::uint32_t sndWnd;
+        common::uint32_t sndWl1;
+        common::uint32_t sndWl2;
+        bool finQueued;
+        // byte seq lives at [(seq - iss - 1) & mask]
+        common::uint8_t *sendBuffer;
+
+        // receive sequence space; readSeq is the next byte the application gets
+        common::uint32_t irs;
+        common::uint32_t rcvNxt;
+        common::uint32_t readSeq;
+        // the right edge of the window last advertised
+        common::uint32_t rcvAdvertised;
+        bool finReceived;
+        // byte seq lives at [(seq - irs - 1) & mask]
+        common::uint8_t *receiveBuffer;
+        // data received above rcvNxt, most recent first as SACK reports it
+        SackBlock outOfOrder[maxSackBlocks];
+        int numOutOfOrder;
+
+        // negotiated in the handshake
+        common::uint16_t mss;
+        common::uint8_t sndWscale;
+        common::uint8_t rcvWscale;
+        bool sackPermitted;
+        // what the peer reported holding above sndUna
+        SackBlock sacked[maxSackBlocks];
+        int numSacked;
+        // retransmissions in recovery have covered everything below this
+        common::uint32_t highRetransmitted;
+
+        // NewReno congestion control
+        common::uint32_t cwnd;
+        common::uint32_t ssthresh;
+        common::uint32_t recover;
+        common::uint8_t dupAcks;
+        bool inRecovery;
+
+        // RFC 6298 round trip estimation in milliseconds, one segment timed at a time
+        common::uint32_t srtt;
+        common::uint32_t rttvar;
+        common::uint32_t rto;
+        bool rttTiming;
+        common::uint32_t rttSeq;
+        common::uint64_t rttStart;
+        common::uint8_t retries;
+
+        // deadlines in milliseconds, 0 when not armed
+        common::uint64_t retransmitAt;
+        common::uint64_t delayedAckAt;
+        common::uint64_t timeWaitAt;
+        common::uint8_t unackedSegments;
+        bool ackNow;
+        bool noDelay;
+
+        // a listener's completed connections, and how many are still in the handshake
+        TransmissionControlProtocolSocket *acceptQueue[backlog];
+        int acceptHead;
+        int acceptCount;
+        int numEmbryonic;
+        TransmissionControlProtocolSocket *listener;
+
+        bool closedByApplication;
+        bool reset;
+        TransmissionControlProtocolSocket *next;
+    };
+
+    class TransmissionControlProtocolProvider : public InternetProtocolHandler
+    {
+        friend class TransmissionControlProtocolSocket;
+    public:
+        TransmissionControlProtocolProvider(InternetProtocolProvider *backend);
+        ~TransmissionControlProtocolProvider();
+
+        virtual bool onInternetProtocolReceived(common::uint32_t srcIP_BE, common::uint32_t dstIP_BE,
+                common::uint8_t *payload, common::uint32_t size) override;
+
+        // blocking waits until the connection is established, nullptr if it fails
+        TransmissionControlProtocolSocket *connect(common::uint32_t ip_BE, common::uint16_t port, bool block = true);
+        // accept() connections to port on every address, nullptr if it is taken
+        TransmissionControlProtocolSocket *listen(common::uint16_t port);
+
+        const TcpStatistics &getStatistics() const { return stats; }
+
+    private:
+        typedef TransmissionControlProtocolSocket Socket;
+
+        static const common::uint32_t bufferMask = ZOEOS_TCP_BUFFER_SIZE - 1;
+        // milliseconds
+        static const common::uint32_t initialRTO = 1000;
+        static const common::uint32_t minRTO = 200;
+        static const common::uint32_t maxRTO = 60000;
+        static const common::uint32_t delayedAckTime = 40;
+        static const common::uint32_t timeWaitTime = 60000;
+        static const common::uint8_t maxSynRetries = 6;
+        static const common::uint8_t maxRetries = 12;
+
+        static common::uint64_t now();
+        // connections hashed by both ends
+        static common::uint32_t hash(common::uint32_t remoteIP_BE, common::uint16_t remotePort_BE, common::uint16_t localPort_BE);
+        // the per-connection part of the initial sequence number, keyed by isnSecret
+        common::uint32_t isnOffset(common::uint32_t localIP_BE, common::uint32_t remoteIP_BE, common::uint16_t localPort_BE,
+                common::uint16_t remotePort_BE) const;
+        Socket *lookup(common::uint32_t localIP_BE, common::uint32_t remoteIP_BE, common::uint16_t localPort_BE, common::uint16_t remotePort_BE) const;
+        Socket *lookupListener(common::uint16_t localPort_BE) const;
+        void insert(Socket *socket);
+        void remove(Socket *socket);
+        Socket *newSocket(common::uint32_t localIP_BE, common::uint32_t remoteIP_BE, common::uint16_t localPort_BE,
+                common::uint16_t remotePort_BE);
+        // drop the connection; freed now if the application closed it, else by close()
+        void terminate(Socket *socket, bool reset);
+        void destroy(Socket *socket);
+
+        void process(Socket *socket, TransmissionControlProtocolHeader *tcp, common::uint8_t *data, common::uint32_t dataSize);
+        void processListen(Socket *listener, common::uint32_t srcIP_BE, common::uint32_t dstIP_BE,
+                TransmissionControlProtocolHeader *tcp, common::uint32_t dataSize);
+        void processSynSent(Socket *socket, TransmissionControlProtocolHeader *tcp);
+        void processAck(Socket *socket, TransmissionControlProtocolHeader *tcp, common::uint32_t dataSize);
+        void processData(Socket *socket, common::uint32_t seq, common::uint8_t *data, common::uint32_t dataSize);
+        void processFin(Socket *socket);
+        void parseOptions(Socket *socket, TransmissionControlProtocolHeader *tcp);
+        void updateRTO(Socket *socket, common::uint32_t rtt);
+
+        // send what the windows and Nagle allow, and any ACK owed
+        void output(Socket *socket);
+        void retransmit(Socket *socket, common::uint32_t seq);
+        // the first sequence number from seq on the peer has not SACKed
+        common::uint32_t nextHole(Socket *socket, common::uint32_t seq) const;
+        void sendSegment(Socket *socket, common::uint32_t seq, common::uint32_t size, common::uint8_t flags);
+        void sendAck(Socket *socket) { sendSegment(socket, socket->sndNxt, 0, 0x10); }
+        void sendReset(common::uint32_t srcIP_BE, common::uint32_t dstIP_BE, TransmissionControlProtocolHeader *tcp,
+                common::uint32_t dataSize);
+        // payloadSum is the partial checksum of the payload; buffer, if any,
+        // holds it and is released once the NIC is done with it
+        void transmit(common::uint32_t localIP_BE, common::uint32_t remoteIP_BE, TransmissionControlProtocolHeader *tcp,
+                common::uint32_t headerSize, const drivers::TxFragment *payload, int count, common::uint32_t payloadSum,
+                NetBuffer *buffer);
+
+        // retransmission, delayed ACK and TIME-WAIT timers, every 10 ms
+        static void tick(void *tcp);
+        void timeout(Socket *socket, common::uint64_t time);
+
+        static const int hashBits = 8;
+        Socket *connections[1 << hashBits];
+        static const int maxListeners = 8;
+        Socket *listeners[maxListeners];
+        common::uint16_t nextEphemeralPort;
+        common::uint32_t isnSecret[2];
+        // segment payloads copied out of the send rings on their way to the NIC
+        NetBufferPool *txPool;
+        TcpStatistics stats;
+    };
+}
+
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef __NET_TCP_BENCHMARK_H__
+#define __NET_TCP_BENCHMARK_H__
+
+#include "common/types.h"
+#include "net/tcp.h"
+
+// the port the receiver listens on, iperf's
+#ifndef ZOEOS_TCP_BENCH_PORT
+#define ZOEOS_TCP_BENCH_PORT 5001
+#endif
+
+namespace zoeos
+{
+
+namespace net
+{
+    // Bulk transfer over one connection from its own task: the sender
+    // connects and writes as fast as the windows allow, the receiver
+    // accepts and reads, both reporting goodput every second.
+    class TcpBenchmark
+    {
+    public:
+        // a receiver when peerIP_BE is 0
+        TcpBenchmark(TransmissionControlProtocolProvider *tcp, common::uint32_t peerIP_BE,
+                common::uint16_t port = ZOEOS_TCP_BENCH_PORT);
+        ~TcpBenchmark();
+
+        // the task body, never returns
+        void run();
+        // entry point for a Task, runs activeBenchmark
+        static void taskEntry();
+        static TcpBenchmark *activeBenchmark;
+
+    private:
+        void send();
+        void receive();
+        // every second, bytes moved since the last report
+        void report(const char *name, common::uint64_t bytes, bool force = false);
+
+        TransmissionControlProtocolProvider *tcp;
+        common::uint32_t peerIP;
+        common::uint16_t port;
+        common::uint64_t lastReportTick;
+        common::uint64_t lastReportBytes;
+        common::uint8_t buffer[8192];
+    };
+}
+
+}
+
+#endif
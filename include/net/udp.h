@@ -0,0 +1,123 @@
+#ifndef __NET_UDP_H__
+#define __NET_UDP_H__
+
+#include "common/types.h"
+#include "net/ipv4.h"
+#include "net/netBuffer.h"
+#include "poller.h"
+
+// datagrams a socket holds until it is read, a power of two
+#ifndef ZOEOS_UDP_RING_SIZE
+#define ZOEOS_UDP_RING_SIZE 64
+#endif
+
+namespace zoeos
+{
+
+namespace net
+{
+    struct UserDatagramProtocolHeader
+    {
+        common::uint16_t srcPort;
+        common::uint16_t dstPort;
+        common::uint16_t length;
+        common::uint16_t checksum;
+    } __attribute__((packed));
+
+    struct UdpStatistics
+    {
+        common::uint32_t rxDatagrams;
+        common::uint32_t txDatagrams;
+        // no socket on the port
+        common::uint32_t noPort;
+        // short, bad length or bad checksum
+        common::uint32_t malformed;
+        // the socket's ring was full or a reassembled datagram found no buffer
+        common::uint32_t receiveErrors;
+    } ZOEOS_CACHE_ALIGNED;
+
+    class UserDatagramProtocolProvider;
+
+    // A bound port. Received datagrams stay in the frame they arrived in,
+    // the ring passes the NetBuffer from the receive path to one reader task.
+    // POLL_IN while the ring holds a datagram, always POLL_OUT.
+    class UserDatagramProtocolSocket : public PollSource
+    {
+        friend class UserDatagramProtocolProvider;
+    public:
+        drivers::TxStatus sendTo(common::uint32_t dstIP_BE, common::uint16_t dstPort, common::uint8_t *data, common::uint32_t size);
+
+        // The next datagram, its data and size set to the payload; release()
+        // it when done. Blocks the calling task while the ring is empty
+        // unless block is false or it is kernelMain's flow, then it returns nullptr.
+        NetBuffer *receive(common::uint32_t *srcIP_BE = nullptr, common::uint16_t *srcPort = nullptr, bool block = true);
+        // receive() copied into buffer, the payload size or -1; longer datagrams are cut
+        int recvFrom(common::uint8_t *buffer, common::uint32_t size, common::uint32_t *srcIP_BE = nullptr,
+                common::uint16_t *srcPort = nullptr, bool block = true);
+
+        common::uint16_t getLocalPort() const { return (localPort_BE >> 8) | (common::uint16_t)(localPort_BE << 8); }
+        // datagrams lost because the ring was full
+        common::uint32_t getDropped() const { return dropped; }
+
+        virtual common::uint32_t pollEvents() const override;
+
+    private:
+        UserDatagramProtocolSocket(UserDatagramProtocolProvider *backend, common::uint32_t localIP_BE, common::uint16_t localPort_BE);
+
+        struct Datagram
+        {
+            NetBuffer *buffer;
+            common::uint32_t srcIP;
+            common::uint16_t srcPort;
+        };
+
+        // only the receive path moves head, only the reader moves tail
+        Datagram ring[ZOEOS_UDP_RING_SIZE];
+        volatile common::uint32_t head;
+        volatile common::uint32_t tail;
+        common::uint32_t dropped;
+
+        UserDatagramProtocolProvider *backend;
+        common::uint32_t localIP;
+        common::uint16_t localPort_BE;
+        UserDatagramProtocolSocket *next;
+    };
+
+    class UserDatagramProtocolProvider : public InternetProtocolHandler
+    {
+    public:
+        UserDatagramProtocolProvider(InternetProtocolProvider *backend);
+        ~UserDatagramProtocolProvider();
+
+        virtual bool onInternetProtocolReceived(common::uint32_t srcIP_BE, common::uint32_t dstIP_BE,
+                common::uint8_t *payload, common::uint32_t size) override;
+
+        // localIP_BE 0 takes the port on every address, localPort 0 picks a free one;
+        // nullptr if the address and port are taken
+        UserDatagramProtocolSocket *bind(common::uint32_t localIP_BE, common::uint16_t localPort);
+        // frees the socket and any datagrams it still holds
+        void unbind(UserDatagramProtocolSocket *socket);
+        drivers::TxStatus sendTo(UserDatagramProtocolSocket *socket, common::uint32_t dstIP_BE, common::uint16_t dstPort,
+                common::uint8_t *data, common::uint32_t size);
+
+        const UdpStatistics &getStatistics() const { return stats; }
+
+    private:
+        // sockets hashed by local address and port
+        static const int hashBits = 6;
+        UserDatagramProtocolSocket *sockets[1 << hashBits];
+        static common::uint32_t hash(common::uint32_t ipAddress_BE, common::uint16_t port_BE);
+        UserDatagramProtocolSocket *lookup(common::uint32_t ipAddress_BE, common::uint16_t port_BE) const;
+        // the one's complement sum over the pseudo header
+        common::uint32_t pseudoHeaderSum(common::uint32_t srcIP_BE, common::uint32_t dstIP_BE, common::uint16_t length) const;
+
+        // datagrams put back together by IPv4 are not in a frame and get copied here
+        NetBufferPool *copyPool;
+        common::uint16_t nextEphemeralPort;
+        UdpStatistics stats;
+    };
+}
+
+}
+
+#endif
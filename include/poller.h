@@ -0,0 +1,104 @@
+#ifndef __POLLER_H__
+#define __POLLER_H__
+
+#include "common/types.h"
+
+namespace zoeos
+{
+
+using namespace zoeos::common;
+
+enum PollEvents
+{
+    // data, a connection to accept or the end of the stream to read
+    POLL_IN = 1 << 0,
+    // room to queue data
+    POLL_OUT = 1 << 1,
+    // reset or failed; always reported
+    POLL_ERR = 1 << 2,
+    // the peer is done sending or the connection is gone; always reported
+    POLL_HUP = 1 << 3
+};
+
+class Poller;
+class PollSource;
+
+struct PollEvent
+{
+    void *cookie;
+    // PollEvents that hold
+    uint32_t events;
+};
+
+// one source watched by one Poller
+struct PollEntry
+{
+    Poller *poller;
+    PollSource *source;
+    uint32_t events;
+    void *cookie;
+    bool edgeTriggered;
+    // events notified since the entry was last delivered
+    uint32_t pending;
+    bool queued;
+    PollEntry *nextReady;
+    PollEntry *nextWatcher;
+};
+
+// Something a Poller can watch: a socket, a queue, a device. It reports
+// what holds right now and calls notify() whenever an event may have
+// become true.
+class PollSource
+{
+    friend class Poller;
+public:
+    PollSource();
+    // drops it from every Poller watching it
+    virtual ~PollSource();
+
+    virtual uint32_t pollEvents() const = 0;
+    // queues the source on the Pollers that wait for any of events and wakes their task
+    void notify(uint32_t events);
+
+private:
+    PollEntry *watchers;
+};
+
+// Readiness notification for a task serving many sources, like epoll.
+// Notified sources go on a ready list, so wait() costs what is ready, not
+// what is watched. A level-triggered source is reported on every wait()
+// while its events hold, an edge-triggered one once per notify().
+class Poller
+{
+public:
+    Poller();
+    ~Poller();
+
+    // false if the source is watched already or there is no room
+    bool add(PollSource *source, uint32_t events, void *cookie, bool edgeTriggered = false);
+    bool modify(PollSource *source, uint32_t events, void *cookie, bool edgeTriggered = false);
+    void remove(PollSource *source);
+
+    // Fill up to max events and return how many. Blocks the calling task
+    // until a source is ready unless block is false or it is kernelMain's
+    // flow, then it returns 0.
+    int wait(PollEvent *events, int max, bool block = true);
+
+private:
+    friend class PollSource;
+
+    PollEntry *find(PollSource *source);
+    void enqueue(PollEntry *entry);
+    // unlink from the ready list and the source, and free
+    void release(PollEntry *entry);
+
+    static const int maxEntries = 64;
+    PollEntry entries[maxEntries];
+    PollEntry *freeEntries;
+    PollEntry *readyHead;
+    PollEntry *readyTail;
+};
+
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include "common/types.h"
+
+using namespace zoeos::common;
+
+// The 64-bit division helpers gcc calls on i386, normally found in libgcc,
+// which is not linked into the kernel. Plain shift-and-subtract.
+
+static uint64_t divide(uint64_t dividend, uint64_t divisor, uint64_t *remainder)
+{
+    uint64_t quotient = 0;
+    if (divisor == 0)
+    {
+        // the caller divided by zero, there is nothing sensible to return
+        *remainder = 0;
+        return 0;
+    }
+    if ((dividend >> 32) == 0 && (divisor >> 32) == 0)
+    {
+        *remainder = (uint32_t)dividend % (uint32_t)divisor;
+        return (uint32_t)dividend / (uint32_t)divisor;
+    }
+
+    int shift = 0;
+    while (!(divisor >> 63) && (divisor << 1) <= dividend)
+    {
+        divisor <<= 1;
+        shift++;
+    }
+    for (; shift >= 0; shift--, divisor >>= 1)
+    {
+        quotient <<= 1;
+        if (dividend >= divisor)
+        {
+            dividend -= divisor;
+            quotient |= 1;
+        }
+    }
+    *remainder = dividend;
+    return quotient;
+}
+
+extern "C" uint64_t __udivdi3(uint64_t dividend, uint64_t divisor)
+{
+    uint64_t remainder;
+    return divide(dividend, divisor, &remainder);
+}
+
+extern "C" uint64_t __umoddi3(uint64_t dividend, uint64_t divisor)
+{
+    uint64_t remainder;
+    divide(dividend, divisor, &remainder);
+    return remainder;
+}
@@ -1,27 +1,94 @@
 #include "drivers/amd_am79c973.h"
+#include "memoryManager.h"
 
 using namespace zoeos;
 using namespace zoeos::common;
 using namespace zoeos::drivers;
 using namespace zoeos::hardwareCommunication;
+using namespace zoeos::net;
 
 void printf(const char *);
 void printHex(uint8_t);
 
-AMD_AM79C973::AMD_AM79C973(PciConfigSpace *device, InterruptManager *interrupts) : Driver(),
+// bytes that may not be read in place are copied into a buffer of sendQueuePool
+struct AMD_AM79C973::SendQueueEntry
+{
+    TxFragment fragments[maxFragments];
+    int count;
+    TxCompletion completion;
+    void *cookie;
+    NetBuffer *copy;
+};
+
+const PciDeviceID AMD_AM79C973::idTable[] = {
+    { 0x1022, 0x2000, PCI_ANY_ID, PCI_ANY_ID },
+    { 0, 0, 0, 0 }
+};
+
+const PciDriver AMD_AM79C973::pciDriver = { "amd_am79c973", AMD_AM79C973::idTable, AMD_AM79C973::probe };
+
+Driver *AMD_AM79C973::probe(PciConfigSpace *device, PciController *pci, InterruptManager *interrupts)
+{
+    printf("information from AMD_AM79C973: ");
+    void *memory = MemoryManager::activeMM->malloc(sizeof(AMD_AM79C973));
+    if (memory == nullptr)
+    {
+        printf("failed\n");
+        return nullptr;
+    }
+    // the PCnet reads its rings and buffers by DMA
+    pci->setCommand(device, PciController::COMMAND_IO_SPACE | PciController::COMMAND_BUS_MASTER);
+    AMD_AM79C973 *driver = new (memory) AMD_AM79C973(device, interrupts);
+    printf("installed\n");
+    return driver;
+}
+
+static const NetStatField txFields[] =
+{
+    NETSTAT_FIELD(TxStatistics, framesSent),
+    NETSTAT_FIELD(TxStatistics, framesQueued),
+    NETSTAT_FIELD(TxStatistics, drops),
+    NETSTAT_FIELD(TxStatistics, errors),
+    NETSTAT_FIELD(TxStatistics, queueDepth),
+    NETSTAT_FIELD(TxStatistics, queueHighWater),
+    NETSTAT_FIELD(TxStatistics, reclaimed),
+    NETSTAT_FIELD(TxStatistics, reclaimCycles),
+    NETSTAT_FIELD(TxStatistics, maxReclaimCycles)
+};
+
+static int numControllers = 0;
+
+AMD_AM79C973::AMD_AM79C973(PciConfigSpace *device, InterruptManager *interrupts,
+        uint8_t recvRingLog2, uint8_t sendRingLog2, uint16_t sendQueueDepth_) : NetDevice(),
     InterruptRoutine(device->getInterruptNum() + interrupts->getOffset(), interrupts),
-    MACAddress0Port(device->getPortBase()),
-    MACAddress2Port(device->getPortBase() + 0x20),
-    MACAddress4Port(device->getPortBase() + 0x40),
-    registerDataPort(device->getPortBase() + 0x10),
-    registerAddressPort(device->getPortBase() + 0x12),
-    resetPort(device->getPortBase() + 0x14),
-    busControlRegisterDataPort(device->getPortBase() + 0x16)
+    MACAddress0Port(device->getPortBase(), IO_NET),
+    MACAddress2Port(device->getPortBase() + 0x02, IO_NET),
+    MACAddress4Port(device->getPortBase() + 0x04, IO_NET),
+    registerDataPort(device->getPortBase() + 0x10, IO_NET),
+    registerAddressPort(device->getPortBase() + 0x12, IO_NET),
+    resetPort(device->getPortBase() + 0x14, IO_NET),
+    busControlRegisterDataPort(device->getPortBase() + 0x16, IO_NET)
 {
-    wrapper = nullptr;
+    ready = false;
+    pollScheduled = false;
+    debugDump = false;
+    capabilities = NETDEV_SCATTER_GATHER;
 
+    if (recvRingLog2 > 9)
+        recvRingLog2 = 9;
+    if (sendRingLog2 > 9)
+        sendRingLog2 = 9;
+    recvRingSize = 1 << recvRingLog2;
+    sendRingSize = 1 << sendRingLog2;
     currentSendBuffer = 0;
     currentRecvBuffer = 0;
+    sendTail = 0;
+    sendInFlight = 0;
+    sendQueueDepth = sendQueueDepth_;
+    sendQueueHead = 0;
+    sendQueueCount = 0;
+    txStats = TxStatistics();
+    NetStatistics::add("pcnet", numControllers++, &txStats, txFields, sizeof(txFields) / sizeof(txFields[0]));
 
     uint64_t MAC0 = MACAddress0Port.read() % 256;
     uint64_t MAC1 = MACAddress0Port.read() / 256;
@@ -31,56 +98,97 @@ AMD_AM79C973::AMD_AM79C973(PciConfigSpace *device, InterruptManager *interrupts)
     uint64_t MAC5 = MACAddress4Port.read() / 256;
     uint64_t MAC = MAC5 << 40 | MAC4 << 32 | MAC3 << 24 | MAC2 << 16 | MAC1 << 8 | MAC0;
 
-    registerAddressPort.write(20);
-    busControlRegisterDataPort.write(0x102);
-    registerAddressPort.write(0);
-    registerDataPort.write(0x04);
+    // 32-bit software style
+    writeBCR(20, 0x102);
+    // STOP
+    writeCSR(0, 0x04);
 
     initBlock.mode = 0;
     initBlock.reserved1 = 0;
-    initBlock.transfer_length = 3;
+    initBlock.transfer_length = sendRingLog2;
     initBlock.reserved2 = 0;
-    initBlock.receive_length = 3;
+    initBlock.receive_length = recvRingLog2;
     initBlock.physical_address = MAC;
     initBlock.reserved3 = 0;
     initBlock.logical_address = 0;
 
-    sendBufferDesc = (BufferDescriptor *)(((uint32_t)&sendBufferDescMemory[0] + 15) & 0xfff0);
+    sendBufferDesc = (BufferDescriptor *)allocAligned(sendRingSize * sizeof(BufferDescriptor), 16);
+    sendBuffers = (uint8_t *)allocAligned(sendRingSize * bufferSize, 16);
+    recvBufferDesc = (BufferDescriptor *)allocAligned(recvRingSize * sizeof(BufferDescriptor), 16);
+    // twice the ring, so the upper layers can hold frames while the ring stays full
+    recvPool = new NetBufferPool(recvRingSize * 2, bufferSize);
+    recvRing = (NetBuffer **)MemoryManager::activeMM->malloc(recvRingSize * sizeof(NetBuffer *));
+    sendCompletions = (TxCompletion *)MemoryManager::activeMM->malloc(sendRingSize * sizeof(TxCompletion));
+    sendCookies = (void **)MemoryManager::activeMM->malloc(sendRingSize * sizeof(void *));
+    sendTimestamps = (uint64_t *)MemoryManager::activeMM->malloc(sendRingSize * sizeof(uint64_t));
+    sendQueue = nullptr;
+    sendQueuePool = nullptr;
+    if (sendQueueDepth)
+    {
+        sendQueue = (SendQueueEntry *)MemoryManager::activeMM->malloc(sendQueueDepth * sizeof(SendQueueEntry));
+        sendQueuePool = new NetBufferPool(sendQueueDepth, bufferSize);
+    }
     initBlock.transmit_descriptor = (uint32_t)sendBufferDesc;
-    recvBufferDesc = (BufferDescriptor *)(((uint32_t)&recvBufferDescMemory[0] + 15) & 0xfff0);
     initBlock.receive_descriptor = (uint32_t)recvBufferDesc;
 
-    for (uint8_t i = 0; i < 8; i++)
+    // BCNT is the negative buffer length with the top four bits set
+    uint32_t bcnt = 0xf000 | ((-bufferSize) & 0xfff);
+    for (uint16_t i = 0; i < sendRingSize; i++)
     {
-        sendBufferDesc[i].address = ((uint32_t)&sendBuffer[i] + 15) & 0xfff0;
-        sendBufferDesc[i].flags = 0xf7ff;
+        sendBufferDesc[i].address = (uint32_t)&sendBuffers[i * bufferSize];
+        sendBufferDesc[i].flags = bcnt;
         sendBufferDesc[i].flags2 = 0;
         sendBufferDesc[i].avail = 0;
-
-        recvBufferDesc[i].address = ((uint32_t)&recvBuffer[i] + 15) & 0xfff0;
-        recvBufferDesc[i].flags = 0xf7ff | 0x80000000;
+        sendCompletions[i] = nullptr;
+        sendCookies[i] = nullptr;
+    }
+    for (uint16_t i = 0; i < recvRingSize; i++)
+    {
+        recvRing[i] = recvPool->alloc();
+        recvBufferDesc[i].address = (uint32_t)recvRing[i]->data;
+        recvBufferDesc[i].flags = bcnt | 0x80000000;
         recvBufferDesc[i].flags2 = 0;
         recvBufferDesc[i].avail = 0;
     }
 
-    registerAddressPort.write(1);
-    registerDataPort.write((uint32_t)&initBlock);
-    registerAddressPort.write(2);
-    registerDataPort.write((uint32_t)&initBlock >> 16);
+    writeCSR(1, (uint32_t)&initBlock & 0xffff);
+    writeCSR(2, (uint32_t)&initBlock >> 16);
 }
 
-void AMD_AM79C973::activate()
+void *AMD_AM79C973::allocAligned(uint32_t size, uint32_t align)
+{
+    uint32_t memory = (uint32_t)MemoryManager::activeMM->malloc(size + align - 1);
+    return (void *)((memory + align - 1) & ~(align - 1));
+}
+
+uint16_t AMD_AM79C973::readCSR(uint16_t csr)
+{
+    InterruptGuard guard;
+    registerAddressPort.write(csr);
+    return registerDataPort.read();
+}
+
+void AMD_AM79C973::writeCSR(uint16_t csr, uint16_t value)
 {
-    registerAddressPort.write(0);
-    registerDataPort.write(0x41);
+    InterruptGuard guard;
+    registerAddressPort.write(csr);
+    registerDataPort.write(value);
+}
+
+void AMD_AM79C973::writeBCR(uint16_t bcr, uint16_t value)
+{
+    InterruptGuard guard;
+    registerAddressPort.write(bcr);
+    busControlRegisterDataPort.write(value);
+}
 
-    registerAddressPort.write(4);
-    uint32_t tmp = registerDataPort.read();
-    registerAddressPort.write(4);
-    registerDataPort.write(tmp | 0xc00);
+void AMD_AM79C973::activate()
+{
+    // auto pad transmit / auto strip receive
+    writeCSR(4, readCSR(4) | 0xc00);
 
-    registerAddressPort.write(0);
-    registerDataPort.write(0x42);
+    // INIT | INEA, the chip reads the init block and raises IDON when done
+    writeCSR(0, 0x41);
 }
 
 int AMD_AM79C973::reset()
@@ -92,109 +200,309 @@ int AMD_AM79C973::reset()
 
 uint32_t AMD_AM79C973::routine(uint32_t esp)
 {
-    printf("interrupt from AMD AM79C973: ");
-    registerAddressPort.write(0);
-    uint32_t tmp = registerDataPort.read();
-
-    if ((tmp & 0x8000) == 0x8000)
-        printf("AMD AM79C973 error!\n");
-    else if ((tmp & 0x2000) == 0x2000)
-        printf("AMD AM79C973 collision error!\n");
-    else if ((tmp & 0x1000) == 0x1000)
-        printf("AMD AM79C973 missed frame!\n");
-    else if ((tmp & 0x0800) == 0x0800)
-        printf("AMD AM79C973 memory error!\n");
-    else if ((tmp & 0x0400) == 0x0400)
-        receive();
-    else if ((tmp & 0x0200) == 0x0200)
-        printf("AMD AM79C973 data send interrupt!\n");
-    registerAddressPort.write(0);
-    registerDataPort.write(tmp);
+    uint32_t tmp = readCSR(0);
+
+    // ERR only sums up BABL, CERR, MISS and MERR
+    if ((tmp & 0x4000) == 0x4000)
+        stats.txErrors++;
+    if ((tmp & 0x2000) == 0x2000)
+        stats.collisions++;
+    if ((tmp & 0x1000) == 0x1000)
+        stats.rxMissed++;
+    if ((tmp & 0x0800) == 0x0800)
+        stats.busErrors++;
+    if ((tmp & 0x0200) == 0x0200)
+        reclaim();
+    if ((tmp & 0x0400) == 0x0400 && !pollScheduled)
+    {
+        // mask RINT and leave the ring to poll()
+        writeCSR(3, readCSR(3) | 0x0400);
+        pollScheduled = true;
+    }
+
+    // acknowledge the write-one-to-clear status bits, keep INEA
+    writeCSR(0, (tmp & 0xff00) | 0x40);
 
     if ((tmp & 0x0100) == 0x0100)
+    {
+        // STRT | INEA
+        writeCSR(0, 0x42);
+        ready = true;
         printf("AMD AD79C973 init done!\n");
+    }
     return esp;
 }
 
-void AMD_AM79C973::send(uint8_t *buffer, int size)
+TxStatus AMD_AM79C973::sendFrame(const TxFragment *fragments, int count, TxCompletion completion, void *cookie)
 {
-    int sendDesc = currentSendBuffer;
-    currentSendBuffer = (currentSendBuffer + 1) % 8;
-    if (size > 1518)
-        size = 1518;
+    reclaim();
 
-    for (uint8_t *src = buffer + size - 1,
-                 *dst = (uint8_t *)(sendBufferDesc[sendDesc].address + size - 1);
-         src >= buffer; src--, dst--)
-        *dst = *src;
-
-    sendBufferDesc[sendDesc].avail = 0;
-    sendBufferDesc[sendDesc].flags = 0x8300f000 | ((uint16_t)((-size) & 0xfff));
-    sendBufferDesc[sendDesc].flags2 = 0;
-    registerAddressPort.write(0);
-    registerDataPort.write(0x48);
+    // keep frames in order: once something is queued, everything queues behind it
+    InterruptGuard guard;
+    if (sendQueueCount == 0)
+    {
+        TxStatus status = transmit(fragments, count, completion, cookie);
+        if (status != TX_DROPPED)
+            return status;
+    }
+    return enqueue(fragments, count, completion, cookie);
 }
 
-void AMD_AM79C973::receive()
+TxStatus AMD_AM79C973::transmit(const TxFragment *fragments, int count, TxCompletion completion, void *cookie)
 {
-    printf("AMD AMD_AM79C973 received\n");
-    for (; (recvBufferDesc[currentRecvBuffer].flags & 0x80000000) == 0;
-         currentRecvBuffer = (currentRecvBuffer + 1) % 8)
+    InterruptGuard guard;
+    uint16_t mask = sendRingSize - 1;
+    uint16_t sizes[maxFragments];
+    int used = 0;
+    uint32_t total = 0;
+    // bytes already copied into the descriptor opened last, 0 if it maps a fragment in place
+    uint32_t bounced = 0;
+
+    for (int i = 0; i < count; i++)
     {
-        if (!(recvBufferDesc[currentRecvBuffer].flags & 0x40000000) &&
-            (recvBufferDesc[currentRecvBuffer].flags & 0x30000000) == 0x30000000)
-        {
-            uint32_t size = recvBufferDesc[currentRecvBuffer].flags && 0xfff;
-            if (size > 64)
-                size -= 4;
+        uint32_t size = fragments[i].size;
+        if (size == 0)
+            continue;
+        total += size;
+        if (total > 1518)
+            return TX_INVALID;
 
-            uint8_t *buffer = (uint8_t *)(recvBufferDesc[currentRecvBuffer].address);
-            for (int i = 0; i < size; i++)
+        if (completion == nullptr || size < copyBreak)
+        {
+            if (bounced == 0)
             {
-                printHex(buffer[i]);
-                printf(" ");
+                if (used >= maxFragments)
+                    return TX_INVALID;
+                uint16_t desc = (currentSendBuffer + used) & mask;
+                // the NIC still owns the descriptor
+                if (used >= sendRingSize - sendInFlight || (sendBufferDesc[desc].flags & 0x80000000))
+                    return TX_DROPPED;
+                sendBufferDesc[desc].address = (uint32_t)&sendBuffers[desc * bufferSize];
+                sizes[used++] = 0;
             }
-
-            if (wrapper)
+            uint16_t desc = (currentSendBuffer + used - 1) & mask;
+            uint32_t *dst = (uint32_t *)(sendBufferDesc[desc].address + bounced);
+            uint8_t *src = fragments[i].data;
+            uint32_t n = 0;
+            if ((bounced & 3) == 0 && ((uint32_t)src & 3) == 0)
             {
-                if (wrapper->onRawDataReceived(buffer, size))
-                {
-                    send(buffer, size);
-                }
+                for (; n + 4 <= size; n += 4)
+                    *dst++ = *(uint32_t *)(src + n);
             }
+            for (; n < size; n++)
+                ((uint8_t *)sendBufferDesc[desc].address)[bounced + n] = src[n];
+            bounced += size;
+            sizes[used - 1] = bounced;
+        }
+        else
+        {
+            if (used >= maxFragments)
+                return TX_INVALID;
+            uint16_t desc = (currentSendBuffer + used) & mask;
+            if (used >= sendRingSize - sendInFlight || (sendBufferDesc[desc].flags & 0x80000000))
+                return TX_DROPPED;
+            sendBufferDesc[desc].address = (uint32_t)fragments[i].data;
+            sizes[used++] = size;
+            bounced = 0;
         }
-        recvBufferDesc[currentRecvBuffer].flags2 = 0;
-        recvBufferDesc[currentRecvBuffer].flags = 0x8000f7ff;
     }
-}
+    if (used == 0)
+        return TX_INVALID;
 
-void AMD_AM79C973::setWrapper(RawDataWrapper *wrapper_)
-{
-    wrapper = wrapper_;
+    // hand the chain over back to front, the STP descriptor last
+    uint16_t first = currentSendBuffer;
+    uint16_t last = (first + used - 1) & mask;
+    sendCompletions[last] = completion;
+    sendCookies[last] = cookie;
+    sendTimestamps[last] = IOProfiler::rdtsc();
+    for (int i = used - 1; i >= 0; i--)
+    {
+        uint16_t desc = (first + i) & mask;
+        uint32_t flags = 0x8000f000 | ((-(uint32_t)sizes[i]) & 0xfff);
+        if (i == 0)
+            flags |= 0x02000000;
+        if (i == used - 1)
+            flags |= 0x01000000;
+        sendBufferDesc[desc].avail = 0;
+        sendBufferDesc[desc].flags2 = 0;
+        sendBufferDesc[desc].flags = flags;
+    }
+    currentSendBuffer = (first + used) & mask;
+    sendInFlight += used;
+    txStats.framesSent++;
+
+    // TDMD | INEA
+    writeCSR(0, 0x48);
+    return TX_SENT;
 }
 
-uint64_t AMD_AM79C973::getMACAddr() const
+TxStatus AMD_AM79C973::enqueue(const TxFragment *fragments, int count, TxCompletion completion, void *cookie)
 {
-    return initBlock.physical_address;
+    // what transmit() would refuse must be refused now, the caller takes TX_QUEUED as accepted
+    uint32_t total = 0;
+    for (int i = 0; i < count; i++)
+        total += fragments[i].size;
+    if (count <= 0 || count > maxFragments || total == 0 || total > 1518)
+        return TX_INVALID;
+
+    InterruptGuard guard;
+    NetBuffer *copy = sendQueueCount < sendQueueDepth ? sendQueuePool->alloc() : nullptr;
+    if (copy == nullptr)
+    {
+        txStats.drops++;
+        return TX_DROPPED;
+    }
+
+    SendQueueEntry &entry = sendQueue[(sendQueueHead + sendQueueCount) % sendQueueDepth];
+    entry.count = 0;
+    entry.completion = completion;
+    entry.cookie = cookie;
+    entry.copy = copy;
+
+    // the caller may reuse what transmit() would have copied, so copy it now
+    for (int i = 0; i < count; i++)
+    {
+        TxFragment fragment = fragments[i];
+        if (completion == nullptr || fragment.size < copyBreak)
+        {
+            if (copy->size + fragment.size > sendQueuePool->getBufferSize())
+            {
+                copy->release();
+                return TX_INVALID;
+            }
+            uint8_t *dst = copy->data + copy->size;
+            for (uint32_t n = 0; n < fragment.size; n++)
+                dst[n] = fragment.data[n];
+            copy->size += fragment.size;
+            fragment.data = dst;
+        }
+        entry.fragments[entry.count++] = fragment;
+    }
+
+    sendQueueCount++;
+    txStats.framesQueued++;
+    txStats.queueDepth = sendQueueCount;
+    if (sendQueueCount > txStats.queueHighWater)
+        txStats.queueHighWater = sendQueueCount;
+    return TX_QUEUED;
 }
 
-RawDataWrapper::RawDataWrapper(AMD_AM79C973 *backend_)
+void AMD_AM79C973::flushQueue()
 {
-    backend = backend_;
-    backend->setWrapper(this);
+    InterruptGuard guard;
+    while (sendQueueCount)
+    {
+        SendQueueEntry &entry = sendQueue[sendQueueHead];
+        TxStatus status = transmit(entry.fragments, entry.count, entry.completion, entry.cookie);
+        if (status == TX_DROPPED)
+            break;
+        // copied fragments are short and went into the descriptor buffers
+        entry.copy->release();
+        if (status == TX_INVALID)
+        {
+            // it was accepted as TX_QUEUED, so its completion is owed all the same
+            txStats.drops++;
+            if (entry.completion)
+                entry.completion(entry.cookie);
+        }
+        sendQueueHead = (sendQueueHead + 1) % sendQueueDepth;
+        sendQueueCount--;
+    }
+    txStats.queueDepth = sendQueueCount;
 }
 
-RawDataWrapper::~RawDataWrapper()
+void AMD_AM79C973::reclaim()
 {
-    backend->setWrapper(nullptr);
+    while (true)
+    {
+        TxCompletion completion;
+        void *cookie;
+        {
+            InterruptGuard guard;
+            if (sendInFlight == 0 || (sendBufferDesc[sendTail].flags & 0x80000000))
+                break;
+            completion = sendCompletions[sendTail];
+            cookie = sendCookies[sendTail];
+            sendCompletions[sendTail] = nullptr;
+            // ERR
+            if (sendBufferDesc[sendTail].flags & 0x40000000)
+                txStats.errors++;
+            if (sendBufferDesc[sendTail].flags & 0x01000000)
+            {
+                uint64_t latency = IOProfiler::rdtsc() - sendTimestamps[sendTail];
+                txStats.reclaimed++;
+                txStats.reclaimCycles += latency;
+                if (latency > txStats.maxReclaimCycles)
+                    txStats.maxReclaimCycles = latency;
+            }
+            sendTail = (sendTail + 1) & (sendRingSize - 1);
+            sendInFlight--;
+        }
+        if (completion)
+            completion(cookie);
+    }
+    if (sendQueueCount)
+        flushQueue();
 }
 
-bool RawDataWrapper::onRawDataReceived(uint8_t *buffer, uint32_t size)
+int AMD_AM79C973::poll(int budget)
 {
-    return false;
+    if (!pollScheduled)
+        return 0;
+
+    int work = 0;
+    for (; work < budget && (recvBufferDesc[currentRecvBuffer].flags & 0x80000000) == 0;
+         currentRecvBuffer = (currentRecvBuffer + 1) & (recvRingSize - 1), work++)
+    {
+        BufferDescriptor &desc = recvBufferDesc[currentRecvBuffer];
+        if (!(desc.flags & 0x40000000) && (desc.flags & 0x03000000) == 0x03000000)
+        {
+            // MCNT counts the frame check sequence too
+            uint32_t size = desc.flags2 & 0xfff;
+            size = size > 4 ? size - 4 : 0;
+
+            // swap in a fresh buffer and pass the filled one up; keep the old one if the pool is dry
+            NetBuffer *fresh = wrapper ? recvPool->alloc() : nullptr;
+            if (fresh)
+            {
+                NetBuffer *filled = recvRing[currentRecvBuffer];
+                filled->size = size;
+                recvRing[currentRecvBuffer] = fresh;
+                desc.address = (uint32_t)fresh->data;
+
+                if (debugDump)
+                {
+                    for (uint32_t i = 0; i < size; i++)
+                    {
+                        printHex(filled->data[i]);
+                        printf(" ");
+                    }
+                }
+                desc.flags2 = 0;
+                desc.flags = 0x80000000 | 0xf000 | ((-bufferSize) & 0xfff);
+                receive(filled);
+                continue;
+            }
+        }
+        stats.rxDropped++;
+        desc.flags2 = 0;
+        desc.flags = 0x80000000 | 0xf000 | ((-bufferSize) & 0xfff);
+    }
+
+    if (work < budget)
+    {
+        // ring drained: unmask RINT, a frame arriving from now on raises it again
+        InterruptGuard guard;
+        if (recvBufferDesc[currentRecvBuffer].flags & 0x80000000)
+        {
+            pollScheduled = false;
+            writeCSR(3, readCSR(3) & ~0x0400);
+        }
+    }
+    return work;
 }
 
-void RawDataWrapper::send(uint8_t *buffer, uint32_t size)
+uint64_t AMD_AM79C973::getMACAddr() const
 {
-    backend->send(buffer, size);
-}
\ No newline at end of file
+    return initBlock.physical_address;
+}
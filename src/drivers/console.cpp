@@ -0,0 +1,153 @@
+#include "drivers/console.h"
+#include "hardwareCommunication/interrupts.h"
+
+using namespace zoeos::drivers;
+using namespace zoeos::common;
+using namespace zoeos::hardwareCommunication;
+
+static uint16_t *const VideoMemory = (uint16_t*)0xb8000;
+// light grey on black
+static const uint16_t BLANK = 0x0700 | ' ';
+
+Console *Console::activeConsole = nullptr;
+
+// count cells, two at a time with rep movsl; every line is an even number of cells.
+// Moves forwards, so dst may overlap the end of src.
+static inline void moveCells(uint16_t *dst, const uint16_t *src, uint32_t count)
+{
+    uint32_t pairs = count / 2;
+    __asm__ volatile("rep movsl" : "+D"(dst), "+S"(src), "+c"(pairs) : : "memory");
+    if (count & 1)
+        *dst = *src;
+}
+
+static inline void fillCells(uint16_t *dst, uint16_t cell, uint32_t count)
+{
+    uint32_t pairs = count / 2;
+    __asm__ volatile("rep stosl" : "+D"(dst), "+c"(pairs) : "a"(cell | ((uint32_t)cell << 16)) : "memory");
+    if (count & 1)
+        *dst = cell;
+}
+
+Console::Console() : Driver()
+{
+    moveCells(shadow, VideoMemory, rows * columns);
+    cursorX = 0;
+    cursorY = 0;
+    dirtyFirst = rows;
+    dirtyLast = -1;
+    pointerX = 0;
+    pointerY = 0;
+    pointerVisible = false;
+    activeConsole = this;
+}
+
+Console::~Console()
+{
+    if (activeConsole == this)
+        activeConsole = nullptr;
+}
+
+void Console::markDirty(int firstRow, int lastRow)
+{
+    if (firstRow < dirtyFirst)
+        dirtyFirst = firstRow;
+    if (lastRow > dirtyLast)
+        dirtyLast = lastRow;
+}
+
+void Console::scroll()
+{
+    // one block move of everything below the first line, then a blank last line
+    moveCells(shadow, shadow + columns, (rows - 1) * columns);
+    fillCells(shadow + (rows - 1) * columns, BLANK, columns);
+    markDirty(0, rows - 1);
+}
+
+void Console::putChar(char c)
+{
+    if (c == '\n')
+    {
+        cursorX = 0;
+        cursorY++;
+    }
+    else
+    {
+        uint16_t *cell = &shadow[cursorY * columns + cursorX];
+        // the color already there is kept, as printf always did
+        *cell = (*cell & 0xff00) | (uint8_t)c;
+        markDirty(cursorY, cursorY);
+        cursorX++;
+    }
+
+    if (cursorX >= columns)
+    {
+        cursorX = 0;
+        cursorY++;
+    }
+    if (cursorY >= rows)
+    {
+        scroll();
+        cursorY = rows - 1;
+    }
+}
+
+void Console::write(const char *text)
+{
+    // interrupt routines print too
+    InterruptGuard guard;
+    for (int i = 0; text[i]; i++)
+        putChar(text[i]);
+}
+
+void Console::movePointer(int x, int y)
+{
+    if (x < 0 || x >= columns || y < 0 || y >= rows)
+        return;
+    InterruptGuard guard;
+    // the old cell gets its text back, the new one the pointer
+    markDirty(pointerY, pointerY);
+    markDirty(y, y);
+    pointerX = x;
+    pointerY = y;
+}
+
+void Console::togglePointer()
+{
+    InterruptGuard guard;
+    pointerVisible = !pointerVisible;
+    markDirty(pointerY, pointerY);
+}
+
+int Console::flush()
+{
+    int first, last, x, y;
+    bool visible;
+    {
+        InterruptGuard guard;
+        first = dirtyFirst;
+        last = dirtyLast;
+        dirtyFirst = rows;
+        dirtyLast = -1;
+        x = pointerX;
+        y = pointerY;
+        visible = pointerVisible;
+    }
+    if (first > last)
+        return 0;
+    // without interrupts held off: a line written meanwhile is marked again
+    // and goes out with the next flush
+    moveCells(VideoMemory + first * columns, shadow + first * columns, (last - first + 1) * columns);
+    // the pointer's line is marked whenever it moves, so its cell is only redrawn here
+    if (visible && y >= first && y <= last)
+    {
+        uint16_t cell = shadow[y * columns + x];
+        VideoMemory[y * columns + x] = ((cell & 0xf000) >> 4) | ((cell & 0x0f00) << 4) | (cell & 0x00ff);
+    }
+    return last - first + 1;
+}
+
+int Console::poll(int budget)
+{
+    return flush();
+}
@@ -6,7 +6,7 @@ using namespace zoeos::common;
 
 Driver::Driver()
 {
-
+    nextDriver = nullptr;
 }
 
 Driver::~Driver()
@@ -30,19 +30,79 @@ void Driver::deactivate()
 }
 
 DriverManager::DriverManager()
+{
+    first = nullptr;
+    last = nullptr;
+}
+
+DriverManager::~DriverManager()
 {
 
 }
 
 void DriverManager::addDriver(Driver *drv)
 {
-    drivers[numDrivers++] = drv;
+    drv->nextDriver = nullptr;
+    if (last)
+        last->nextDriver = drv;
+    else
+        first = drv;
+    last = drv;
+    numDrivers++;
 }
 
 void DriverManager::activeAll()
 {
-    for (uint8_t i = 0; i <numDrivers; i++)
+    for (Driver *drv = first; drv != nullptr; drv = drv->nextDriver)
     {
-        drivers[i]->activate();
+        drv->activate();
     }
-}
\ No newline at end of file
+}
+
+int DriverManager::numPending() const
+{
+    int pending = 0;
+    for (Driver *drv = first; drv != nullptr; drv = drv->nextDriver)
+    {
+        if (!drv->isReady())
+            pending++;
+    }
+    return pending;
+}
+
+int DriverManager::pollAll(int budget)
+{
+    int work = 0;
+    for (Driver *drv = first; drv != nullptr; drv = drv->nextDriver)
+    {
+        work += drv->poll(budget);
+    }
+    return work;
+}
+
+Driver *DriverManager::getDriver(const char *name)
+{
+    for (Driver *drv = first; drv != nullptr; drv = drv->nextDriver)
+    {
+        const char *a = drv->getName();
+        const char *b = name;
+        while (*a && *a == *b)
+        {
+            a++;
+            b++;
+        }
+        if (*a == *b)
+            return drv;
+    }
+    return nullptr;
+}
+
+Driver *DriverManager::getDriver(Driver::Type type, int index)
+{
+    for (Driver *drv = first; drv != nullptr; drv = drv->nextDriver)
+    {
+        if (drv->getType() == type && index-- == 0)
+            return drv;
+    }
+    return nullptr;
+}
@@ -0,0 +1,454 @@
+#include "drivers/e1000.h"
+#include "hardwareCommunication/mmio.h"
+#include "memoryManager.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::hardwareCommunication;
+using namespace zoeos::net;
+
+void printf(const char *);
+
+enum E1000Register
+{
+    E1000_CTRL = 0x0000,
+    E1000_EERD = 0x0014,
+    E1000_ICR = 0x00c0,
+    E1000_ITR = 0x00c4,
+    E1000_IMS = 0x00d0,
+    E1000_IMC = 0x00d8,
+    E1000_RCTL = 0x0100,
+    E1000_TCTL = 0x0400,
+    E1000_TIPG = 0x0410,
+    E1000_RDBAL = 0x2800,
+    E1000_RDBAH = 0x2804,
+    E1000_RDLEN = 0x2808,
+    E1000_RDH = 0x2810,
+    E1000_RDT = 0x2818,
+    E1000_RDTR = 0x2820,
+    E1000_TDBAL = 0x3800,
+    E1000_TDBAH = 0x3804,
+    E1000_TDLEN = 0x3808,
+    E1000_TDH = 0x3810,
+    E1000_TDT = 0x3818,
+    E1000_RXCSUM = 0x5000,
+    E1000_MTA = 0x5200,
+    E1000_RAL = 0x5400,
+    E1000_RAH = 0x5404
+};
+
+static const uint32_t CTRL_ASDE = 1 << 5;
+static const uint32_t CTRL_SLU = 1 << 6;
+static const uint32_t CTRL_RST = 1 << 26;
+
+static const uint32_t ICR_TXDW = 1 << 0;
+static const uint32_t ICR_LSC = 1 << 2;
+static const uint32_t ICR_RXDMT0 = 1 << 4;
+static const uint32_t ICR_RXO = 1 << 6;
+static const uint32_t ICR_RXT0 = 1 << 7;
+static const uint32_t ICR_RECEIVE = ICR_RXDMT0 | ICR_RXO | ICR_RXT0;
+
+static const uint32_t RCTL_EN = 1 << 1;
+static const uint32_t RCTL_BAM = 1 << 15;
+static const uint32_t RCTL_SECRC = 1 << 26;
+
+static const uint32_t TCTL_EN = 1 << 1;
+static const uint32_t TCTL_PSP = 1 << 3;
+
+static const uint32_t RXCSUM_IPOFLD = 1 << 8;
+static const uint32_t RXCSUM_TUOFLD = 1 << 9;
+
+static const uint8_t RX_STATUS_DD = 1 << 0;
+static const uint8_t RX_STATUS_EOP = 1 << 1;
+static const uint8_t RX_STATUS_IXSM = 1 << 2;
+static const uint8_t RX_STATUS_TCPCS = 1 << 5;
+static const uint8_t RX_STATUS_IPCS = 1 << 6;
+static const uint8_t RX_ERROR_CE = 1 << 0;
+static const uint8_t RX_ERROR_TCPE = 1 << 5;
+static const uint8_t RX_ERROR_IPE = 1 << 6;
+static const uint8_t RX_ERROR_RXE = 1 << 7;
+
+static const uint8_t TX_COMMAND_EOP = 1 << 0;
+static const uint8_t TX_COMMAND_IFCS = 1 << 1;
+static const uint8_t TX_COMMAND_RS = 1 << 3;
+static const uint8_t TX_STATUS_DD = 1 << 0;
+
+const PciDeviceID E1000::idTable[] = {
+    // 82540EM, 82545EM
+    { 0x8086, 0x100e, PCI_ANY_ID, PCI_ANY_ID },
+    { 0x8086, 0x100f, PCI_ANY_ID, PCI_ANY_ID },
+    { 0, 0, 0, 0 }
+};
+
+const PciDriver E1000::pciDriver = { "e1000", E1000::idTable, E1000::probe };
+
+Driver *E1000::probe(PciConfigSpace *device, PciController *pci, InterruptManager *interrupts)
+{
+    printf("information from e1000: ");
+    uint32_t registerBase = (uint32_t)pci->mapBaseAddressRegister(device, 0);
+    void *memory = registerBase ? MemoryManager::activeMM->malloc(sizeof(E1000)) : nullptr;
+    if (memory == nullptr)
+    {
+        printf("failed\n");
+        return nullptr;
+    }
+    pci->enableBusMastering(device);
+    E1000 *driver = new (memory) E1000(device, interrupts, registerBase);
+    printf("installed\n");
+    return driver;
+}
+
+E1000::E1000(PciConfigSpace *device, InterruptManager *interrupts, uint32_t registerBase_,
+        uint8_t recvRingLog2, uint8_t sendRingLog2) : NetDevice(),
+    InterruptRoutine(device->getInterruptNum() + interrupts->getOffset(), interrupts),
+    registerBase(registerBase_)
+{
+    ready = false;
+    pollScheduled = false;
+    capabilities = NETDEV_SCATTER_GATHER | NETDEV_RX_CHECKSUM_IP | NETDEV_RX_CHECKSUM_L4 | NETDEV_BATCH_TX;
+
+    if (recvRingLog2 < 3)
+        recvRingLog2 = 3;
+    if (recvRingLog2 > 12)
+        recvRingLog2 = 12;
+    if (sendRingLog2 < 3)
+        sendRingLog2 = 3;
+    if (sendRingLog2 > 12)
+        sendRingLog2 = 12;
+    recvRingSize = 1 << recvRingLog2;
+    sendRingSize = 1 << sendRingLog2;
+    currentRecvBuffer = 0;
+    currentSendBuffer = 0;
+    sendTail = 0;
+    sendInFlight = 0;
+
+    reset();
+
+    // QEMU and most firmware load the address into RAL0 / RAH0, otherwise ask the EEPROM
+    uint32_t ral = readRegister(E1000_RAL);
+    uint32_t rah = readRegister(E1000_RAH);
+    if (rah & 0x80000000)
+    {
+        MACAddress = (uint64_t)(rah & 0xffff) << 32 | ral;
+    }
+    else
+    {
+        MACAddress = 0;
+        for (int i = 0; i < 3; i++)
+            MACAddress |= (uint64_t)readEEPROM(i) << (16 * i);
+        writeRegister(E1000_RAL, (uint32_t)MACAddress);
+        writeRegister(E1000_RAH, (uint32_t)(MACAddress >> 32) | 0x80000000);
+    }
+    for (int i = 0; i < 128; i++)
+        writeRegister(E1000_MTA + i * 4, 0);
+
+    recvDesc = (RecvDescriptor *)allocAligned(recvRingSize * sizeof(RecvDescriptor), 128);
+    // twice the ring, so the upper layers can hold frames while the ring stays full
+    recvPool = new NetBufferPool(recvRingSize * 2, bufferSize);
+    recvRing = (NetBuffer **)MemoryManager::activeMM->malloc(recvRingSize * sizeof(NetBuffer *));
+    for (uint16_t i = 0; i < recvRingSize; i++)
+    {
+        recvRing[i] = recvPool->alloc();
+        recvDesc[i].address = (uint32_t)recvRing[i]->data;
+        recvDesc[i].status = 0;
+    }
+
+    sendDesc = (SendDescriptor *)allocAligned(sendRingSize * sizeof(SendDescriptor), 128);
+    sendBuffers = (uint8_t *)allocAligned(sendRingSize * bufferSize, 16);
+    sendLast = (uint16_t *)MemoryManager::activeMM->malloc(sendRingSize * sizeof(uint16_t));
+    sendCompletions = (TxCompletion *)MemoryManager::activeMM->malloc(sendRingSize * sizeof(TxCompletion));
+    sendCookies = (void **)MemoryManager::activeMM->malloc(sendRingSize * sizeof(void *));
+    for (uint16_t i = 0; i < sendRingSize; i++)
+    {
+        sendDesc[i].address = 0;
+        sendDesc[i].command = 0;
+        sendDesc[i].status = TX_STATUS_DD;
+        sendCompletions[i] = nullptr;
+    }
+
+    writeRegister(E1000_RDBAL, (uint32_t)recvDesc);
+    writeRegister(E1000_RDBAH, 0);
+    writeRegister(E1000_RDLEN, recvRingSize * sizeof(RecvDescriptor));
+    writeRegister(E1000_RDH, 0);
+    writeRegister(E1000_RDT, recvRingSize - 1);
+    // moderation is left to ITR rather than the per-packet receive timer
+    writeRegister(E1000_RDTR, 0);
+    writeRegister(E1000_RXCSUM, RXCSUM_IPOFLD | RXCSUM_TUOFLD);
+
+    writeRegister(E1000_TDBAL, (uint32_t)sendDesc);
+    writeRegister(E1000_TDBAH, 0);
+    writeRegister(E1000_TDLEN, sendRingSize * sizeof(SendDescriptor));
+    writeRegister(E1000_TDH, 0);
+    writeRegister(E1000_TDT, 0);
+    // IEEE 802.3 gaps for copper: IPGT 10, IPGR1 8, IPGR2 6
+    writeRegister(E1000_TIPG, 10 | (8 << 10) | (6 << 20));
+
+    // ITR counts in 256 ns units
+    writeRegister(E1000_ITR, 1000000000 / (E1000_INTERRUPT_RATE * 256));
+}
+
+E1000::~E1000() { }
+
+void *E1000::allocAligned(uint32_t size, uint32_t align)
+{
+    uint32_t memory = (uint32_t)MemoryManager::activeMM->malloc(size + align - 1);
+    return (void *)((memory + align - 1) & ~(align - 1));
+}
+
+uint32_t E1000::readRegister(uint16_t reg)
+{
+    return mmioRead32(registerBase + reg, IO_NET);
+}
+
+void E1000::writeRegister(uint16_t reg, uint32_t value)
+{
+    // descriptors written before a tail update must reach memory first
+    __asm__ volatile("" : : : "memory");
+    mmioWrite32(registerBase + reg, value, IO_NET);
+}
+
+uint16_t E1000::readEEPROM(uint8_t address)
+{
+    // 8254x layout: START in bit 0, DONE in bit 4, the word address from bit 8
+    writeRegister(E1000_EERD, ((uint32_t)address << 8) | 1);
+    uint32_t value;
+    for (int i = 0; i < 100000; i++)
+    {
+        value = readRegister(E1000_EERD);
+        if (value & 0x10)
+            return value >> 16;
+    }
+    return 0;
+}
+
+int E1000::reset()
+{
+    writeRegister(E1000_IMC, 0xffffffff);
+    writeRegister(E1000_CTRL, readRegister(E1000_CTRL) | CTRL_RST);
+    for (int i = 0; i < 100000 && (readRegister(E1000_CTRL) & CTRL_RST); i++);
+    writeRegister(E1000_IMC, 0xffffffff);
+    readRegister(E1000_ICR);
+    writeRegister(E1000_CTRL, readRegister(E1000_CTRL) | CTRL_SLU | CTRL_ASDE);
+    ready = false;
+    return 0;
+}
+
+void E1000::activate()
+{
+    // broadcasts accepted, the CRC stripped so descriptor lengths are frame lengths
+    writeRegister(E1000_RCTL, RCTL_EN | RCTL_BAM | RCTL_SECRC);
+    // collision threshold 15, collision distance 64
+    writeRegister(E1000_TCTL, TCTL_EN | TCTL_PSP | (0x0f << 4) | (0x40 << 12));
+    writeRegister(E1000_IMS, ICR_RECEIVE | ICR_TXDW | ICR_LSC);
+    ready = true;
+}
+
+void E1000::deactivate()
+{
+    writeRegister(E1000_IMC, 0xffffffff);
+    writeRegister(E1000_RCTL, 0);
+    writeRegister(E1000_TCTL, 0);
+    ready = false;
+}
+
+uint32_t E1000::routine(uint32_t esp)
+{
+    // reading ICR acknowledges every cause
+    uint32_t icr = readRegister(E1000_ICR);
+
+    if (icr & ICR_LSC)
+        writeRegister(E1000_CTRL, readRegister(E1000_CTRL) | CTRL_SLU);
+    // the receive FIFO overflowed and frames were lost
+    if (icr & ICR_RXO)
+        stats.rxMissed++;
+    if (icr & ICR_TXDW)
+        reclaim();
+    if ((icr & ICR_RECEIVE) && !pollScheduled)
+    {
+        // mask receive causes and leave the ring to poll()
+        writeRegister(E1000_IMC, ICR_RECEIVE);
+        pollScheduled = true;
+    }
+    return esp;
+}
+
+TxStatus E1000::sendFrame(const TxFragment *fragments, int count, TxCompletion completion, void *cookie)
+{
+    reclaim();
+
+    InterruptGuard guard;
+    TxStatus status = queueFrame(fragments, count, completion, cookie);
+    if (status == TX_SENT)
+        writeRegister(E1000_TDT, currentSendBuffer);
+    return status;
+}
+
+int E1000::sendFrames(const TxFrame *frames, int count)
+{
+    reclaim();
+
+    InterruptGuard guard;
+    int sent = 0;
+    while (sent < count &&
+           queueFrame(frames[sent].fragments, frames[sent].count, frames[sent].completion, frames[sent].cookie) == TX_SENT)
+        sent++;
+    if (sent)
+        writeRegister(E1000_TDT, currentSendBuffer);
+    return sent;
+}
+
+TxStatus E1000::queueFrame(const TxFragment *fragments, int count, TxCompletion completion, void *cookie)
+{
+    uint16_t mask = sendRingSize - 1;
+    uint16_t sizes[maxFragments];
+    int used = 0;
+    uint32_t total = 0;
+    // bytes already copied into the descriptor opened last, 0 if it maps a fragment in place
+    uint32_t bounced = 0;
+    // TDT == TDH means empty, so one descriptor always stays unused
+    int available = sendRingSize - 1 - sendInFlight;
+
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t size = fragments[i].size;
+        if (size == 0)
+            continue;
+        total += size;
+        if (total > 1514)
+            return TX_INVALID;
+
+        if (completion == nullptr || size < copyBreak)
+        {
+            if (bounced == 0)
+            {
+                if (used >= maxFragments)
+                    return TX_INVALID;
+                if (used >= available)
+                    return TX_DROPPED;
+                uint16_t desc = (currentSendBuffer + used) & mask;
+                sendDesc[desc].address = (uint32_t)&sendBuffers[desc * bufferSize];
+                sizes[used++] = 0;
+            }
+            uint16_t desc = (currentSendBuffer + used - 1) & mask;
+            uint8_t *dst = (uint8_t *)(uint32_t)sendDesc[desc].address + bounced;
+            for (uint32_t n = 0; n < size; n++)
+                dst[n] = fragments[i].data[n];
+            bounced += size;
+            sizes[used - 1] = bounced;
+        }
+        else
+        {
+            if (used >= maxFragments)
+                return TX_INVALID;
+            if (used >= available)
+                return TX_DROPPED;
+            uint16_t desc = (currentSendBuffer + used) & mask;
+            sendDesc[desc].address = (uint32_t)fragments[i].data;
+            sizes[used++] = size;
+            bounced = 0;
+        }
+    }
+    if (used == 0)
+        return TX_INVALID;
+
+    uint16_t first = currentSendBuffer;
+    uint16_t last = (first + used - 1) & mask;
+    for (int i = 0; i < used; i++)
+    {
+        SendDescriptor &desc = sendDesc[(first + i) & mask];
+        desc.length = sizes[i];
+        desc.checksumOffset = 0;
+        desc.checksumStart = 0;
+        desc.special = 0;
+        desc.status = 0;
+        // only the end of the frame reports status
+        desc.command = TX_COMMAND_IFCS | (i == used - 1 ? TX_COMMAND_EOP | TX_COMMAND_RS : 0);
+    }
+    sendLast[first] = last;
+    sendCompletions[last] = completion;
+    sendCookies[last] = cookie;
+    currentSendBuffer = (last + 1) & mask;
+    sendInFlight += used;
+    return TX_SENT;
+}
+
+void E1000::reclaim()
+{
+    while (true)
+    {
+        TxCompletion completion;
+        void *cookie;
+        {
+            InterruptGuard guard;
+            if (sendInFlight == 0)
+                break;
+            uint16_t last = sendLast[sendTail];
+            if (!(sendDesc[last].status & TX_STATUS_DD))
+                break;
+            completion = sendCompletions[last];
+            cookie = sendCookies[last];
+            sendCompletions[last] = nullptr;
+            sendInFlight -= ((last - sendTail) & (sendRingSize - 1)) + 1;
+            sendTail = (last + 1) & (sendRingSize - 1);
+        }
+        if (completion)
+            completion(cookie);
+    }
+}
+
+int E1000::poll(int budget)
+{
+    if (!pollScheduled)
+        return 0;
+
+    int work = 0;
+    uint16_t mask = recvRingSize - 1;
+    while (work < budget && (recvDesc[currentRecvBuffer].status & RX_STATUS_DD))
+    {
+        RecvDescriptor &desc = recvDesc[currentRecvBuffer];
+        NetBuffer *filled = nullptr;
+        // frames never span buffers: BSIZE is larger than the MTU
+        if ((desc.status & RX_STATUS_EOP) && !(desc.errors & (RX_ERROR_CE | RX_ERROR_RXE)))
+        {
+            // swap in a fresh buffer and pass the filled one up; keep the old one if the pool is dry
+            NetBuffer *fresh = wrapper ? recvPool->alloc() : nullptr;
+            if (fresh)
+            {
+                filled = recvRing[currentRecvBuffer];
+                filled->size = desc.length;
+                if (!(desc.status & RX_STATUS_IXSM))
+                {
+                    if ((desc.status & RX_STATUS_IPCS) && !(desc.errors & RX_ERROR_IPE))
+                        filled->checksum |= CHECKSUM_IP_OK;
+                    if ((desc.status & RX_STATUS_TCPCS) && !(desc.errors & RX_ERROR_TCPE))
+                        filled->checksum |= CHECKSUM_L4_OK;
+                }
+                recvRing[currentRecvBuffer] = fresh;
+                desc.address = (uint32_t)fresh->data;
+            }
+        }
+        if (filled == nullptr)
+            stats.rxDropped++;
+        desc.status = 0;
+        currentRecvBuffer = (currentRecvBuffer + 1) & mask;
+        work++;
+        if (filled)
+            receive(filled);
+    }
+    // hand the descriptors back in one write, RDT points at the last one software owns
+    if (work)
+        writeRegister(E1000_RDT, (currentRecvBuffer - 1) & mask);
+
+    if (work < budget)
+    {
+        // ring drained: unmask the receive causes, a frame arriving from now on raises them again
+        InterruptGuard guard;
+        if (!(recvDesc[currentRecvBuffer].status & RX_STATUS_DD))
+        {
+            pollScheduled = false;
+            writeRegister(E1000_IMS, ICR_RECEIVE);
+        }
+    }
+    return work;
+}
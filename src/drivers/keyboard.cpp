@@ -1,4 +1,5 @@
 #include "drivers/keyboard.h"
+#include "net/netstat.h"
 
 void printf(const char *);
 
@@ -8,8 +9,8 @@ using namespace zoeos::hardwareCommunication;
 
 KeyboardDriver::KeyboardDriver(InterruptManager *manager)
     : InterruptRoutine(0x01 + manager->getOffset(), manager),
-      dataPort(0x60),
-      commandPort(0x64)
+      dataPort(0x60, IO_KEYBOARD),
+      commandPort(0x64, IO_KEYBOARD)
 {
     
 }
@@ -114,6 +115,14 @@ uint32_t KeyboardDriver::routine(uint32_t esp)
 
     case 0x45:
         break;
+
+    // F11 and F12: dump the network counters once the interrupt is over
+    case 0x57:
+        zoeos::net::NetStatistics::requestDump(zoeos::net::NetStatistics::TEXT);
+        break;
+    case 0x58:
+        zoeos::net::NetStatistics::requestDump(zoeos::net::NetStatistics::KEY_VALUE);
+        break;
     default:
         if (key < 0x80)
         {
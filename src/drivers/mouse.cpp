@@ -1,4 +1,5 @@
 #include "drivers/mouse.h"
+#include "drivers/console.h"
 
 void printf(const char *);
 
@@ -8,8 +9,8 @@ using namespace zoeos::hardwareCommunication;
 
 MouseDriver::MouseDriver(InterruptManager *manager)
     : InterruptRoutine(0x0C + manager->getOffset(), manager),
-      dataPort(0x60),
-      commandPort(0x64),
+      dataPort(0x60, IO_MOUSE),
+      commandPort(0x64, IO_MOUSE),
       x(40), y(12)
 {
 
@@ -21,10 +22,11 @@ MouseDriver::~MouseDriver()
 
 void MouseDriver::activate()
 {
-    uint16_t* videoMemory = (uint16_t*)0xb8000;
-    videoMemory[y * 80 + x] = ((videoMemory[y * 80 + x] & 0xf000) >> 4) | 
-                              ((videoMemory[y * 80 + x] & 0x0f00) << 4) |
-                              (videoMemory[y * 80 + x] & 0x00ff);
+    if (Console::activeConsole)
+    {
+        Console::activeConsole->movePointer(x, y);
+        Console::activeConsole->togglePointer();
+    }
     commandPort.write(0xa8);
     commandPort.write(0x20);
     uint8_t status = (dataPort.read() | 0x02) & (~0x20);
@@ -45,10 +47,8 @@ uint32_t MouseDriver::routine(uint32_t esp)
     offset = (offset + 1) % 3;
     if (offset == 0)
     {
-        uint16_t* videoMemory = (uint16_t*)0xb8000;
-        videoMemory[y * 80 + x] = ((videoMemory[y * 80 + x] & 0xf000) >> 4) | 
-                                  ((videoMemory[y * 80 + x] & 0x0f00) << 4) |
-                                  (videoMemory[y * 80 + x] & 0x00ff);
+        // the console draws the pointer over the text when it flushes
+        Console *console = Console::activeConsole;
         x += buffer[1];
         x = (x < 0 ? 0 : x);
         x = (x >= 80 ? 79 : x);
@@ -57,17 +57,15 @@ uint32_t MouseDriver::routine(uint32_t esp)
         y = (y < 0 ? 0 : y);
         y = (y >= 25 ? 24 : y);
 
-        videoMemory[y * 80 + x] = ((videoMemory[y * 80 + x] & 0xf000) >> 4) | 
-                                  ((videoMemory[y * 80 + x] & 0x0f00) << 4) |
-                                  (videoMemory[y * 80 + x] & 0x00ff);
+        if (console)
+            console->movePointer(x, y);
         
         for (uint8_t i = 0; i < 3; i++)
         {
             if ((buffer[0] & (1 << i)) != (buttons & (1 << i)))
             {
-                videoMemory[y * 80 + x] = ((videoMemory[y * 80 + x] & 0xf000) >> 4) | 
-                ((videoMemory[y * 80 + x] & 0x0f00) << 4) |
-                (videoMemory[y * 80 + x] & 0x00ff);
+                if (console)
+                    console->togglePointer();
             }
         }
         buttons = buffer[0];
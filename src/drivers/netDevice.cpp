@@ -0,0 +1,215 @@
+#include "drivers/netDevice.h"
+#include "net/capture.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::net;
+
+static const NetStatField deviceFields[] =
+{
+    NETSTAT_FIELD(NetDeviceStatistics, rxPackets),
+    NETSTAT_FIELD(NetDeviceStatistics, rxBytes),
+    NETSTAT_FIELD(NetDeviceStatistics, rxDropped),
+    NETSTAT_FIELD(NetDeviceStatistics, txPackets),
+    NETSTAT_FIELD(NetDeviceStatistics, txBytes),
+    NETSTAT_FIELD(NetDeviceStatistics, txDropped),
+    NETSTAT_FIELD(NetDeviceStatistics, rxMissed),
+    NETSTAT_FIELD(NetDeviceStatistics, collisions),
+    NETSTAT_FIELD(NetDeviceStatistics, busErrors),
+    NETSTAT_FIELD(NetDeviceStatistics, txErrors)
+};
+
+// eth0, eth1, ... in the order the drivers come up
+static int numDevices = 0;
+
+NetDevice::NetDevice() : Driver()
+{
+    wrapper = nullptr;
+    stats = NetDeviceStatistics();
+    capabilities = 0;
+    mtu = 1500;
+    NetStatistics::add("eth", numDevices++, &stats, deviceFields, sizeof(deviceFields) / sizeof(deviceFields[0]));
+}
+
+NetDevice::~NetDevice()
+{
+    NetStatistics::remove(&stats);
+}
+
+TxStatus NetDevice::send(const TxFragment *fragments, int count, TxCompletion completion, void *cookie)
+{
+    TxStatus status = sendFrame(fragments, count, completion, cookie);
+    countSent(fragments, count, status);
+    return status;
+}
+
+void NetDevice::send(uint8_t *buffer, int size)
+{
+    TxFragment fragment = { buffer, (uint32_t)size };
+    send(&fragment, 1);
+}
+
+int NetDevice::sendBatch(const TxFrame *frames, int count)
+{
+    int sent = sendFrames(frames, count);
+    for (int i = 0; i < sent; i++)
+        countSent(frames[i].fragments, frames[i].count, TX_SENT);
+    return sent;
+}
+
+void NetDevice::countSent(const TxFragment *fragments, int count, TxStatus status)
+{
+    if (status != TX_SENT && status != TX_QUEUED)
+    {
+        stats.txDropped++;
+        return;
+    }
+    stats.txPackets++;
+    for (int i = 0; i < count; i++)
+        stats.txBytes += fragments[i].size;
+}
+
+TxStatus NetDevice::sendFrame(const TxFragment *fragments, int count, TxCompletion completion, void *cookie)
+{
+    return TX_INVALID;
+}
+
+int NetDevice::sendFrames(const TxFrame *frames, int count)
+{
+    int sent = 0;
+    for (; sent < count; sent++)
+    {
+        TxStatus status = sendFrame(frames[sent].fragments, frames[sent].count, frames[sent].completion, frames[sent].cookie);
+        if (status != TX_SENT && status != TX_QUEUED)
+            break;
+    }
+    return sent;
+}
+
+void NetDevice::receive(NetBuffer *buffer)
+{
+    stats.rxPackets++;
+    stats.rxBytes += buffer->size;
+    if (wrapper)
+        wrapper->onBufferReceived(this, buffer);
+    else
+        buffer->release();
+}
+
+void NetDevice::setWrapper(RawDataWrapper *wrapper_)
+{
+    wrapper = wrapper_;
+}
+
+RawDataWrapper::RawDataWrapper(NetDevice *backend_)
+{
+    numDevices = 0;
+    capture = nullptr;
+    receiving = nullptr;
+    if (backend_)
+        bind(backend_);
+}
+
+RawDataWrapper::~RawDataWrapper()
+{
+    while (numDevices)
+        unbind(devices[numDevices - 1]);
+}
+
+bool RawDataWrapper::bind(NetDevice *device)
+{
+    if (numDevices >= maxDevices)
+        return false;
+    devices[numDevices++] = device;
+    device->setWrapper(this);
+    return true;
+}
+
+void RawDataWrapper::unbind(NetDevice *device)
+{
+    for (int i = 0; i < numDevices; i++)
+    {
+        if (devices[i] != device)
+            continue;
+        device->setWrapper(nullptr);
+        devices[i] = devices[--numDevices];
+        return;
+    }
+}
+
+NetDevice *RawDataWrapper::route(uint64_t dstMAC) const
+{
+    if (numDevices <= 1)
+        return numDevices ? devices[0] : nullptr;
+    uint32_t hash = (uint32_t)dstMAC ^ (uint32_t)(dstMAC >> 24);
+    hash ^= hash >> 12;
+    hash ^= hash >> 6;
+    return devices[hash % numDevices];
+}
+
+static void releaseBuffer(void *buffer)
+{
+    ((NetBuffer*)buffer)->release();
+}
+
+void RawDataWrapper::onBufferReceived(NetDevice *device, NetBuffer *buffer)
+{
+    if (capture)
+        capture->record(buffer->data, buffer->size);
+    receiving = buffer;
+    bool sendBack = onRawDataReceived(device, buffer->data, buffer->size);
+    if (receiving == nullptr)
+        return;
+    receiving = nullptr;
+    if (sendBack)
+    {
+        // the reply goes out of the receive buffer itself, through the device it came in on
+        TxFragment fragment = { buffer->data, buffer->size };
+        TxStatus status = send(device, &fragment, 1, releaseBuffer, buffer);
+        if (status == TX_SENT || status == TX_QUEUED)
+            return;
+    }
+    buffer->release();
+}
+
+NetBuffer *RawDataWrapper::claimReceiveBuffer()
+{
+    NetBuffer *buffer = receiving;
+    receiving = nullptr;
+    return buffer;
+}
+
+bool RawDataWrapper::onRawDataReceived(NetDevice *device, uint8_t *buffer, uint32_t size)
+{
+    return false;
+}
+
+void RawDataWrapper::send(uint8_t *buffer, uint32_t size)
+{
+    TxFragment fragment = { buffer, size };
+    send(&fragment, 1);
+}
+
+TxStatus RawDataWrapper::send(const TxFragment *fragments, int count, TxCompletion completion, void *cookie)
+{
+    // the destination MAC leads the frame
+    uint64_t dstMAC = 0;
+    if (count > 0 && fragments[0].size >= 6)
+    {
+        for (int i = 0; i < 6; i++)
+            dstMAC |= (uint64_t)fragments[0].data[i] << (8 * i);
+    }
+    return send(route(dstMAC), fragments, count, completion, cookie);
+}
+
+TxStatus RawDataWrapper::send(NetDevice *device, const TxFragment *fragments, int count, TxCompletion completion, void *cookie)
+{
+    if (device == nullptr)
+        return TX_DROPPED;
+    TxStatus status = device->send(fragments, count, completion, cookie);
+    // only what the device took; a completion that already ran left the bytes in place
+    if (capture && (status == TX_SENT || status == TX_QUEUED))
+        capture->record(fragments, count);
+    return status;
+}
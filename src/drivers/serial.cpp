@@ -0,0 +1,66 @@
+#include "drivers/serial.h"
+
+using namespace zoeos::drivers;
+using namespace zoeos::common;
+using namespace zoeos::hardwareCommunication;
+
+SerialPort *SerialPort::activeSerial = nullptr;
+
+SerialPort::SerialPort(uint16_t portBase)
+    : dataPort(portBase, IO_SERIAL),
+      interruptEnablePort(portBase + 1, IO_SERIAL),
+      fifoControlPort(portBase + 2, IO_SERIAL),
+      lineControlPort(portBase + 3, IO_SERIAL),
+      modemControlPort(portBase + 4, IO_SERIAL),
+      lineStatusPort(portBase + 5, IO_SERIAL)
+{
+}
+
+SerialPort::~SerialPort()
+{
+    if (activeSerial == this)
+        activeSerial = nullptr;
+}
+
+void SerialPort::activate()
+{
+    interruptEnablePort.write(0x00);
+    // DLAB on, divisor 1 = 115200 baud
+    lineControlPort.write(0x80);
+    dataPort.write(0x01);
+    interruptEnablePort.write(0x00);
+    // 8 bits, no parity, one stop bit, DLAB off
+    lineControlPort.write(0x03);
+    // enable and clear the FIFOs, 14 byte threshold
+    fifoControlPort.write(0xc7);
+    // DTR | RTS
+    modemControlPort.write(0x03);
+    activeSerial = this;
+}
+
+void SerialPort::write(uint8_t data)
+{
+    // THRE
+    while (!(lineStatusPort.read() & 0x20));
+    dataPort.write(data);
+}
+
+void SerialPort::write(const uint8_t *data, uint32_t size)
+{
+    while (size)
+    {
+        while (!(lineStatusPort.read() & 0x20));
+        // an empty holding register means the whole 16 byte FIFO is free
+        uint32_t burst = size < 16 ? size : 16;
+        for (uint32_t i = 0; i < burst; i++)
+            dataPort.write(data[i]);
+        data += burst;
+        size -= burst;
+    }
+}
+
+void SerialPort::write(const char *text)
+{
+    for (; *text; text++)
+        write((uint8_t)*text);
+}
@@ -0,0 +1,124 @@
+#include "drivers/timer.h"
+#include "hardwareCommunication/ioProfiler.h"
+
+using namespace zoeos::drivers;
+using namespace zoeos::common;
+using namespace zoeos::hardwareCommunication;
+
+// input clock of the 8253/8254
+static const uint32_t PIT_FREQUENCY = 1193182;
+
+TimerDriver *TimerDriver::activeTimer = nullptr;
+
+TimerDriver::TimerDriver(InterruptManager *manager, uint32_t frequency_)
+    : InterruptRoutine(0x00 + manager->getOffset(), manager),
+      channel0Port(0x40, IO_TIMER),
+      commandPort(0x43, IO_TIMER)
+{
+    if (frequency_ < 19)
+        frequency_ = 19;
+    if (frequency_ > PIT_FREQUENCY)
+        frequency_ = PIT_FREQUENCY;
+    frequency = frequency_;
+    ticks = 0;
+    numPeriodic = 0;
+    firstTsc = 0;
+    lastTsc = 0;
+}
+
+TimerDriver::~TimerDriver()
+{
+    if (activeTimer == this)
+        activeTimer = nullptr;
+}
+
+void TimerDriver::activate()
+{
+    // the divisor is rounded, so the real rate differs from frequency by a few ppm
+    uint32_t divisor = (PIT_FREQUENCY + frequency / 2) / frequency;
+    // channel 0, lobyte/hibyte, mode 2 (rate generator)
+    commandPort.write(0x34);
+    channel0Port.write(divisor & 0xff);
+    channel0Port.write((divisor >> 8) & 0xff);
+    activeTimer = this;
+}
+
+uint32_t TimerDriver::routine(uint32_t esp)
+{
+    uint64_t now = IOProfiler::rdtsc();
+    if (ticks == 0)
+        firstTsc = now;
+    lastTsc = now;
+    ticks = ticks + 1;
+    return esp;
+}
+
+uint64_t TimerDriver::getTicks() const
+{
+    // two 32-bit loads, the routine must not carry into the upper half between them
+    InterruptGuard guard;
+    return ticks;
+}
+
+uint64_t TimerDriver::getCyclesPerSecond() const
+{
+    uint64_t first, last, count;
+    {
+        InterruptGuard guard;
+        first = firstTsc;
+        last = lastTsc;
+        count = ticks;
+    }
+    if (count < 2)
+        return 0;
+    return (last - first) * frequency / (count - 1);
+}
+
+void TimerDriver::wait(uint32_t count)
+{
+    uint64_t end = getTicks() + count;
+    while (getTicks() < end)
+        __asm__ volatile("hlt");
+}
+
+bool TimerDriver::addPeriodic(TimerCallback callback, void *cookie, uint32_t period)
+{
+    if (numPeriodic >= maxPeriodic)
+        return false;
+    if (period == 0)
+        period = 1;
+    Periodic &entry = periodic[numPeriodic++];
+    entry.callback = callback;
+    entry.cookie = cookie;
+    entry.period = period;
+    entry.next = getTicks() + period;
+    return true;
+}
+
+void TimerDriver::removePeriodic(TimerCallback callback, void *cookie)
+{
+    for (int i = 0; i < numPeriodic; i++)
+    {
+        if (periodic[i].callback == callback && periodic[i].cookie == cookie)
+        {
+            periodic[i] = periodic[--numPeriodic];
+            return;
+        }
+    }
+}
+
+int TimerDriver::poll(int budget)
+{
+    uint64_t now = getTicks();
+    int work = 0;
+    for (int i = 0; i < numPeriodic; i++)
+    {
+        if (now < periodic[i].next)
+            continue;
+        // a late run does not try to catch up
+        periodic[i].next = now + periodic[i].period;
+        periodic[i].callback(periodic[i].cookie);
+        work++;
+    }
+    return work;
+}
@@ -0,0 +1,154 @@
+#include "drivers/virtio.h"
+#include "memoryManager.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+
+static const uint16_t VIRTQ_DESC_F_NEXT = 1;
+static const uint16_t VIRTQ_DESC_F_WRITE = 2;
+static const uint16_t VIRTQ_AVAIL_F_NO_INTERRUPT = 1;
+static const uint16_t VIRTQ_USED_F_NO_NOTIFY = 1;
+
+// stores before loads are the only reordering x86 does
+static inline void memoryBarrier()
+{
+    __asm__ volatile("lock; addl $0, (%%esp)" : : : "memory", "cc");
+}
+
+static inline void compilerBarrier()
+{
+    __asm__ volatile("" : : : "memory");
+}
+
+Virtqueue::Virtqueue()
+{
+    desc = nullptr;
+    index = 0;
+    size = 0;
+    numFree = 0;
+    eventIndex = false;
+}
+
+Virtqueue::~Virtqueue() { }
+
+bool Virtqueue::init(uint16_t index_, uint16_t size_)
+{
+    // legacy devices dictate the size, it is always a power of two
+    if (size_ == 0 || (size_ & (size_ - 1)))
+        return false;
+
+    uint32_t usedOffset = (16 * size_ + 6 + 2 * size_ + 4095) & ~4095;
+    uint32_t total = usedOffset + ((6 + 8 * size_ + 4095) & ~4095);
+    uint32_t memory = (uint32_t)MemoryManager::activeMM->malloc(total + 4095);
+    if (memory == 0)
+        return false;
+    memory = (memory + 4095) & ~4095;
+    for (uint32_t i = 0; i < total; i++)
+        ((uint8_t*)memory)[i] = 0;
+
+    index = index_;
+    size = size_;
+    desc = (Descriptor*)memory;
+    availFlags = (uint16_t*)(memory + 16 * size);
+    availIdx = availFlags + 1;
+    availRing = availFlags + 2;
+    usedEvent = availRing + size;
+    usedFlags = (uint16_t*)(memory + usedOffset);
+    usedIdx = usedFlags + 1;
+    usedRing = (UsedElement*)(usedFlags + 2);
+    availEvent = (uint16_t*)(usedRing + size);
+
+    for (uint16_t i = 0; i < size; i++)
+        desc[i].next = i + 1;
+    freeHead = 0;
+    numFree = size;
+    lastUsed = 0;
+    availShadow = 0;
+    availPublished = 0;
+    return true;
+}
+
+int Virtqueue::add(const VirtqSegment *segments, int count)
+{
+    if (count <= 0 || count > numFree)
+        return -1;
+
+    uint16_t head = freeHead;
+    uint16_t current = head;
+    for (int i = 0; i < count; i++)
+    {
+        desc[current].address = (uint32_t)segments[i].data;
+        desc[current].length = segments[i].size;
+        desc[current].flags = (segments[i].writable ? VIRTQ_DESC_F_WRITE : 0) |
+                              (i + 1 < count ? VIRTQ_DESC_F_NEXT : 0);
+        if (i + 1 < count)
+            current = desc[current].next;
+    }
+    freeHead = desc[current].next;
+    numFree -= count;
+
+    availRing[availShadow & (size - 1)] = head;
+    availShadow++;
+    return head;
+}
+
+bool Virtqueue::publish()
+{
+    if (availShadow == availPublished)
+        return false;
+
+    // descriptors and ring entries must be visible before the index
+    compilerBarrier();
+    *availIdx = availShadow;
+    uint16_t old = availPublished;
+    availPublished = availShadow;
+    memoryBarrier();
+
+    if (eventIndex)
+        return (uint16_t)(availShadow - *availEvent - 1) < (uint16_t)(availShadow - old);
+    return !(*usedFlags & VIRTQ_USED_F_NO_NOTIFY);
+}
+
+int Virtqueue::getUsed(uint32_t *length)
+{
+    if (lastUsed == *usedIdx)
+        return -1;
+    compilerBarrier();
+
+    volatile UsedElement &element = usedRing[lastUsed & (size - 1)];
+    uint16_t head = element.id;
+    if (length)
+        *length = element.length;
+    lastUsed++;
+
+    // put the chain back on the free list
+    uint16_t tail = head;
+    numFree++;
+    while (desc[tail].flags & VIRTQ_DESC_F_NEXT)
+    {
+        tail = desc[tail].next;
+        numFree++;
+    }
+    desc[tail].next = freeHead;
+    freeHead = head;
+    return head;
+}
+
+void Virtqueue::disableInterrupts()
+{
+    // with event indices the device interrupts once when it passes usedEvent,
+    // leaving usedEvent behind is enough to stay quiet
+    if (!eventIndex)
+        *availFlags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+}
+
+bool Virtqueue::enableInterrupts()
+{
+    if (eventIndex)
+        *usedEvent = lastUsed;
+    else
+        *availFlags = 0;
+    memoryBarrier();
+    return lastUsed == *usedIdx;
+}
@@ -0,0 +1,444 @@
+#include "drivers/virtioNet.h"
+#include "memoryManager.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::hardwareCommunication;
+using namespace zoeos::net;
+
+void printf(const char *);
+void printDec(uint64_t);
+
+static const uint32_t VIRTIO_NET_F_MAC = 1u << 5;
+static const uint32_t VIRTIO_NET_F_STATUS = 1u << 16;
+static const uint32_t VIRTIO_NET_F_CTRL_VQ = 1u << 17;
+static const uint32_t VIRTIO_NET_F_MQ = 1u << 22;
+
+static const uint8_t VIRTIO_NET_CTRL_MQ = 4;
+static const uint8_t VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET = 0;
+static const uint8_t VIRTIO_NET_OK = 0;
+
+// read only, every transmitted frame starts with it: no checksum or segmentation offload
+static const uint8_t zeroHeader[10] = { 0 };
+
+const PciDeviceID VirtioNet::idTable[] = {
+    // transitional devices keep the legacy I/O interface
+    { 0x1af4, 0x1000, PCI_ANY_ID, PCI_ANY_ID },
+    { 0, 0, 0, 0 }
+};
+
+const PciDriver VirtioNet::pciDriver = { "virtio_net", VirtioNet::idTable, VirtioNet::probe };
+
+Driver *VirtioNet::probe(PciConfigSpace *device, PciController *pci, InterruptManager *interrupts)
+{
+    printf("information from virtio_net: ");
+    void *memory = MemoryManager::activeMM->malloc(sizeof(VirtioNet));
+    if (memory == nullptr)
+    {
+        printf("failed\n");
+        return nullptr;
+    }
+    pci->setCommand(device, PciController::COMMAND_IO_SPACE | PciController::COMMAND_BUS_MASTER);
+    VirtioNet *driver = new (memory) VirtioNet(device, interrupts);
+    printDec(driver->getNumQueuePairs());
+    printf(" queue pairs, installed\n");
+    return driver;
+}
+
+VirtioNet::VirtioNet(PciConfigSpace *device, InterruptManager *interrupts, uint16_t maxQueuePairs) : NetDevice(),
+    InterruptRoutine(device->getInterruptNum() + interrupts->getOffset(), interrupts),
+    portBase(device->getPortBase()),
+    deviceFeaturesPort(portBase + VIRTIO_REG_DEVICE_FEATURES, IO_NET),
+    guestFeaturesPort(portBase + VIRTIO_REG_GUEST_FEATURES, IO_NET),
+    queueAddressPort(portBase + VIRTIO_REG_QUEUE_ADDRESS, IO_NET),
+    queueSizePort(portBase + VIRTIO_REG_QUEUE_SIZE, IO_NET),
+    queueSelectPort(portBase + VIRTIO_REG_QUEUE_SELECT, IO_NET),
+    queueNotifyPort(portBase + VIRTIO_REG_QUEUE_NOTIFY, IO_NET),
+    deviceStatusPort(portBase + VIRTIO_REG_DEVICE_STATUS, IO_NET),
+    ISRStatusPort(portBase + VIRTIO_REG_ISR_STATUS, IO_NET)
+{
+    ready = false;
+    controlPending = false;
+    pollScheduled = false;
+    failed = false;
+    MACAddress = 0;
+    pairs = nullptr;
+    numPairs = 0;
+    recvPool = nullptr;
+    sendPool = nullptr;
+
+    deviceStatusPort.write(0);
+    deviceStatusPort.write(VIRTIO_STATUS_ACKNOWLEDGE);
+    deviceStatusPort.write(VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    // no MRG_RXBUF: the header stays 10 bytes and every buffer takes a whole frame
+    uint32_t wanted = VIRTIO_NET_F_MAC | VIRTIO_NET_F_STATUS | VIRTIO_NET_F_CTRL_VQ |
+                      VIRTIO_NET_F_MQ | VIRTIO_RING_F_EVENT_IDX;
+    features = deviceFeaturesPort.read() & wanted;
+    if (!(features & VIRTIO_NET_F_CTRL_VQ))
+        features &= ~VIRTIO_NET_F_MQ;
+    guestFeaturesPort.write(features);
+
+    if (features & VIRTIO_NET_F_MAC)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            Port8Bit configPort(portBase + VIRTIO_REG_CONFIG + i, IO_NET);
+            MACAddress |= (uint64_t)configPort.read() << (8 * i);
+        }
+    }
+
+    // queue pairs first, the control queue comes after the last pair the device supports
+    uint16_t devicePairs = 1;
+    if (features & VIRTIO_NET_F_MQ)
+    {
+        Port16Bit maxPairsPort(portBase + VIRTIO_REG_CONFIG + 8, IO_NET);
+        devicePairs = maxPairsPort.read();
+        if (devicePairs == 0)
+            devicePairs = 1;
+    }
+    numPairs = devicePairs < maxQueuePairs ? devicePairs : maxQueuePairs;
+    capabilities = NETDEV_SCATTER_GATHER | NETDEV_BATCH_TX;
+    if (numPairs == 0)
+        numPairs = 1;
+
+    pairs = new QueuePair[numPairs];
+    for (uint16_t i = 0; i < numPairs; i++)
+    {
+        if (!setupQueue(pairs[i].recv, 2 * i) || !setupQueue(pairs[i].send, 2 * i + 1))
+        {
+            // fall back to the pairs that did come up
+            numPairs = i;
+            break;
+        }
+        pairs[i].recvBuffers = (NetBuffer **)MemoryManager::activeMM->malloc(pairs[i].recv.getSize() * sizeof(NetBuffer *));
+        pairs[i].sendTokens = (TxToken *)MemoryManager::activeMM->malloc(pairs[i].send.getSize() * sizeof(TxToken));
+    }
+    if (numPairs > 1 && !setupQueue(controlQueue, 2 * devicePairs))
+        numPairs = 1;
+    if (numPairs == 0)
+    {
+        failed = true;
+        deviceStatusPort.write(VIRTIO_STATUS_FAILED);
+        return;
+    }
+
+    uint32_t recvBuffers = 0;
+    for (uint16_t i = 0; i < numPairs; i++)
+    {
+        uint32_t perQueue = pairs[i].recv.getSize() / 2;
+        recvBuffers += perQueue < VIRTIO_NET_RECV_BUFFERS ? perQueue : VIRTIO_NET_RECV_BUFFERS;
+    }
+    // twice what the queues hold, so the upper layers can keep frames while the queues stay full
+    recvPool = new NetBufferPool(recvBuffers * 2, bufferSize);
+    // copies of short fragments, one per frame in flight at most
+    sendPool = new NetBufferPool(numPairs * VIRTIO_NET_RECV_BUFFERS, bufferSize);
+}
+
+VirtioNet::~VirtioNet() { }
+
+bool VirtioNet::setupQueue(Virtqueue &queue, uint16_t index)
+{
+    queueSelectPort.write(index);
+    uint16_t size = queueSizePort.read();
+    if (!queue.init(index, size))
+        return false;
+    queue.setEventIndex(features & VIRTIO_RING_F_EVENT_IDX);
+    queueAddressPort.write(queue.getPageFrame());
+    return true;
+}
+
+void VirtioNet::notify(const Virtqueue &queue)
+{
+    queueNotifyPort.write(queue.getIndex());
+}
+
+void VirtioNet::activate()
+{
+    if (failed)
+        return;
+
+    for (uint16_t i = 0; i < numPairs; i++)
+    {
+        refill(pairs[i]);
+        // transmit chains are reclaimed by send() and poll(), their interrupts are not needed
+        pairs[i].send.disableInterrupts();
+    }
+    deviceStatusPort.write(VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+    for (uint16_t i = 0; i < numPairs; i++)
+        notify(pairs[i].recv);
+
+    if (numPairs == 1)
+    {
+        ready = true;
+        return;
+    }
+
+    // the device starts with one pair, ask for the others
+    controlCommand.commandClass = VIRTIO_NET_CTRL_MQ;
+    controlCommand.command = VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET;
+    controlCommand.queuePairs = numPairs;
+    controlCommand.ack = 0xff;
+    VirtqSegment segments[3] = {
+        { (uint8_t *)&controlCommand.commandClass, 2, false },
+        { (uint8_t *)&controlCommand.queuePairs, 2, false },
+        { (uint8_t *)&controlCommand.ack, 1, true }
+    };
+    controlPending = true;
+    controlQueue.enableInterrupts();
+    controlQueue.add(segments, 3);
+    if (controlQueue.publish())
+        notify(controlQueue);
+}
+
+int VirtioNet::reset()
+{
+    deviceStatusPort.write(0);
+    ready = false;
+    return 0;
+}
+
+void VirtioNet::checkControl()
+{
+    InterruptGuard guard;
+    if (!controlPending || controlQueue.getUsed(nullptr) < 0)
+        return;
+    controlPending = false;
+    if (controlCommand.ack != VIRTIO_NET_OK)
+        numPairs = 1;
+    if (numPairs > 1)
+        capabilities |= NETDEV_MULTIQUEUE;
+    ready = true;
+}
+
+uint32_t VirtioNet::routine(uint32_t esp)
+{
+    // reading the ISR acknowledges the interrupt
+    uint8_t isr = ISRStatusPort.read();
+    if (isr & 1)
+    {
+        pollScheduled = true;
+        if (controlPending)
+            checkControl();
+    }
+    return esp;
+}
+
+void VirtioNet::refill(QueuePair &pair)
+{
+    while (pair.recv.getNumFree() >= 2 &&
+           pair.recv.getSize() - pair.recv.getNumFree() < 2 * VIRTIO_NET_RECV_BUFFERS)
+    {
+        NetBuffer *buffer = recvPool->alloc();
+        if (buffer == nullptr)
+            break;
+        // the header goes in its own descriptor, legacy devices may not accept it merged
+        VirtqSegment segments[2] = {
+            { buffer->head + frameOffset - sizeof(Header), sizeof(Header), true },
+            { buffer->head + frameOffset, bufferSize - frameOffset, true }
+        };
+        int head = pair.recv.add(segments, 2);
+        pair.recvBuffers[head] = buffer;
+    }
+}
+
+void VirtioNet::reclaim(QueuePair &pair)
+{
+    while (true)
+    {
+        TxToken token;
+        {
+            InterruptGuard guard;
+            int head = pair.send.getUsed(nullptr);
+            if (head < 0)
+                break;
+            token = pair.sendTokens[head];
+        }
+        if (token.copy)
+            token.copy->release();
+        if (token.completion)
+            token.completion(token.cookie);
+    }
+}
+
+int VirtioNet::poll(int budget)
+{
+    if (failed)
+        return 0;
+    for (uint16_t i = 0; i < numPairs; i++)
+        reclaim(pairs[i]);
+    if (controlPending)
+        checkControl();
+    if (!pollScheduled)
+        return 0;
+
+    int work = 0;
+    for (uint16_t i = 0; i < numPairs; i++)
+    {
+        QueuePair &pair = pairs[i];
+        pair.recv.disableInterrupts();
+        uint32_t length;
+        int head;
+        for (; work < budget && (head = pair.recv.getUsed(&length)) >= 0; work++)
+        {
+            NetBuffer *buffer = pair.recvBuffers[head];
+            // both descriptors count, the header included
+            if (wrapper == nullptr || length <= sizeof(Header))
+            {
+                stats.rxDropped++;
+                buffer->release();
+                continue;
+            }
+            buffer->data = buffer->head + frameOffset;
+            buffer->size = length - sizeof(Header);
+            receive(buffer);
+        }
+        refill(pair);
+        if (pair.recv.publish())
+            notify(pair.recv);
+    }
+
+    if (work < budget)
+    {
+        // queues drained: re-arm, a chain used in between means another round
+        InterruptGuard guard;
+        pollScheduled = false;
+        for (uint16_t i = 0; i < numPairs; i++)
+        {
+            if (!pairs[i].recv.enableInterrupts())
+                pollScheduled = true;
+        }
+    }
+    return work;
+}
+
+VirtioNet::QueuePair &VirtioNet::selectPair(const TxFragment *fragments, int count)
+{
+    // the destination MAC leads the frame
+    uint16_t queue = 0;
+    if (numPairs > 1 && count > 0 && fragments[0].size >= 6)
+    {
+        uint8_t hash = 0;
+        for (int i = 0; i < 6; i++)
+            hash ^= fragments[0].data[i];
+        queue = hash % numPairs;
+    }
+    return pairs[queue];
+}
+
+void VirtioNet::publish(QueuePair &pair)
+{
+    if (pair.send.publish())
+        notify(pair.send);
+}
+
+TxStatus VirtioNet::sendFrame(const TxFragment *fragments, int count, TxCompletion completion, void *cookie)
+{
+    if (failed)
+        return TX_INVALID;
+    QueuePair &pair = selectPair(fragments, count);
+    reclaim(pair);
+
+    InterruptGuard guard;
+    TxStatus status = queueFrame(pair, fragments, count, completion, cookie);
+    if (status == TX_SENT)
+        publish(pair);
+    return status;
+}
+
+int VirtioNet::sendFrames(const TxFrame *frames, int count)
+{
+    if (failed)
+        return 0;
+    for (uint16_t i = 0; i < numPairs; i++)
+        reclaim(pairs[i]);
+
+    InterruptGuard guard;
+    uint32_t touched = 0;
+    int sent = 0;
+    for (; sent < count; sent++)
+    {
+        QueuePair &pair = selectPair(frames[sent].fragments, frames[sent].count);
+        if (queueFrame(pair, frames[sent].fragments, frames[sent].count, frames[sent].completion, frames[sent].cookie) != TX_SENT)
+            break;
+        touched |= 1u << (&pair - pairs);
+    }
+    for (uint16_t i = 0; i < numPairs; i++)
+    {
+        if (touched & (1u << i))
+            publish(pairs[i]);
+    }
+    return sent;
+}
+
+TxStatus VirtioNet::queueFrame(QueuePair &pair, const TxFragment *fragments, int count, TxCompletion completion, void *cookie)
+{
+    if (count <= 0 || count > maxFragments)
+        return TX_INVALID;
+
+    VirtqSegment segments[maxFragments + 1];
+    segments[0].data = (uint8_t *)zeroHeader;
+    segments[0].size = sizeof(Header);
+    segments[0].writable = false;
+    int used = 1;
+    uint32_t total = 0;
+    NetBuffer *copy = nullptr;
+    // bytes copied into the segment opened last, 0 if it maps a fragment in place
+    uint32_t copied = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t size = fragments[i].size;
+        if (size == 0)
+            continue;
+        total += size;
+        if (total > 1514)
+        {
+            if (copy)
+                copy->release();
+            return TX_INVALID;
+        }
+
+        if (completion == nullptr || size < copyBreak)
+        {
+            if (copy == nullptr && (copy = sendPool->alloc()) == nullptr)
+                return TX_DROPPED;
+            if (copied == 0)
+            {
+                segments[used].data = copy->data + copy->size;
+                segments[used].size = 0;
+                segments[used].writable = false;
+                used++;
+            }
+            uint8_t *dst = copy->data + copy->size;
+            for (uint32_t n = 0; n < size; n++)
+                dst[n] = fragments[i].data[n];
+            copy->size += size;
+            copied += size;
+            segments[used - 1].size = copied;
+        }
+        else
+        {
+            segments[used].data = fragments[i].data;
+            segments[used].size = size;
+            segments[used].writable = false;
+            used++;
+            copied = 0;
+        }
+    }
+    if (used == 1)
+        return TX_INVALID;
+
+    int head = pair.send.add(segments, used);
+    if (head < 0)
+    {
+        if (copy)
+            copy->release();
+        return TX_DROPPED;
+    }
+    pair.sendTokens[head].completion = completion;
+    pair.sendTokens[head].cookie = cookie;
+    pair.sendTokens[head].copy = copy;
+    return TX_SENT;
+}
@@ -0,0 +1,106 @@
+#include "hardwareCommunication/acpi.h"
+
+using namespace zoeos::common;
+using namespace zoeos::hardwareCommunication;
+
+Acpi::Acpi()
+{
+    rootTable = nullptr;
+    extended = false;
+
+    // the first KiB of the EBDA, then the BIOS read-only area
+    uint32_t ebda = (uint32_t)(*(uint16_t*)0x40e) << 4;
+    RSDPDescriptor *rsdp = nullptr;
+    if (ebda)
+        rsdp = searchRSDP(ebda, 1024);
+    if (rsdp == nullptr)
+        rsdp = searchRSDP(0xe0000, 0x20000);
+    if (rsdp == nullptr)
+        return;
+
+    if (rsdp->revision >= 2 && (rsdp->xsdtAddress >> 32) == 0 && checksum(rsdp, rsdp->length))
+    {
+        rootTable = (AcpiSDTHeader*)(uint32_t)rsdp->xsdtAddress;
+        extended = true;
+    }
+    else
+    {
+        rootTable = (AcpiSDTHeader*)rsdp->rsdtAddress;
+    }
+
+    if (!checksum(rootTable, rootTable->length))
+        rootTable = nullptr;
+}
+
+Acpi::~Acpi() { }
+
+bool Acpi::checksum(const void *table, uint32_t length)
+{
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++)
+        sum += ((const uint8_t*)table)[i];
+    return sum == 0;
+}
+
+Acpi::RSDPDescriptor *Acpi::searchRSDP(uint32_t start, uint32_t length)
+{
+    for (uint32_t addr = start; addr < start + length; addr += 16)
+    {
+        const char *sig = (const char*)addr;
+        if (sig[0] == 'R' && sig[1] == 'S' && sig[2] == 'D' && sig[3] == ' ' &&
+            sig[4] == 'P' && sig[5] == 'T' && sig[6] == 'R' && sig[7] == ' ' &&
+            checksum((void*)addr, 20))
+            return (RSDPDescriptor*)addr;
+    }
+    return nullptr;
+}
+
+AcpiSDTHeader *Acpi::findTable(const char *signature)
+{
+    if (rootTable == nullptr)
+        return nullptr;
+
+    uint32_t entrySize = extended ? 8 : 4;
+    uint32_t entries = (rootTable->length - sizeof(AcpiSDTHeader)) / entrySize;
+    uint8_t *list = (uint8_t*)rootTable + sizeof(AcpiSDTHeader);
+
+    for (uint32_t i = 0; i < entries; i++)
+    {
+        uint32_t address;
+        if (extended)
+        {
+            uint64_t address64 = *(uint64_t*)(list + i * 8);
+            if (address64 >> 32)
+                continue;
+            address = (uint32_t)address64;
+        }
+        else
+        {
+            address = *(uint32_t*)(list + i * 4);
+        }
+
+        AcpiSDTHeader *table = (AcpiSDTHeader*)address;
+        if (table->signature[0] == signature[0] && table->signature[1] == signature[1] &&
+            table->signature[2] == signature[2] && table->signature[3] == signature[3] &&
+            checksum(table, table->length))
+            return table;
+    }
+    return nullptr;
+}
+
+AcpiMCFGEntry *Acpi::findMCFGEntry(uint16_t segment)
+{
+    AcpiSDTHeader *mcfg = findTable("MCFG");
+    if (mcfg == nullptr)
+        return nullptr;
+
+    // the allocation entries follow the header and 8 reserved bytes
+    uint32_t offset = sizeof(AcpiSDTHeader) + 8;
+    for (; offset + sizeof(AcpiMCFGEntry) <= mcfg->length; offset += sizeof(AcpiMCFGEntry))
+    {
+        AcpiMCFGEntry *entry = (AcpiMCFGEntry*)((uint8_t*)mcfg + offset);
+        if (entry->segment == segment)
+            return entry;
+    }
+    return nullptr;
+}
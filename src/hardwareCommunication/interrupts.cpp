@@ -9,7 +9,7 @@ using namespace zoeos::hardwareCommunication;
 InterruptManager::GateDescriptor InterruptManager::IDT[256];
 InterruptManager *InterruptManager::activeInterruptManager = nullptr;
 
-InterruptManager::InterruptManager(uint16_t hardwareInterruptOffset_, GlobalDescriptorTable *gdt, TaskManager *taskManager_) : priCommand(0x20), priData(0x21), semiCommand(0xA0), semiData(0xA1)
+InterruptManager::InterruptManager(uint16_t hardwareInterruptOffset_, GlobalDescriptorTable *gdt, TaskManager *taskManager_) : priCommand(0x20, IO_PIC), priData(0x21, IO_PIC), semiCommand(0xA0, IO_PIC), semiData(0xA1, IO_PIC)
 {
     hardwareInterruptOffset = hardwareInterruptOffset_;
     taskManager = taskManager_;
@@ -141,7 +141,7 @@ uint32_t InterruptManager::handleInt(uint8_t interruptNumber, uint32_t esp)
     {
         esp = routines[interruptNumber]->routine(esp);
     }
-    else if (interruptNumber != hardwareInterruptOffset)
+    else if (interruptNumber != hardwareInterruptOffset && interruptNumber != TaskManager::yieldInterrupt)
     {
         char *msg = (char *)"unprocessed interrupt 0x00\n";
         const char *hex = "0123456789ABCDEF";
@@ -150,7 +150,7 @@ uint32_t InterruptManager::handleInt(uint8_t interruptNumber, uint32_t esp)
         printf(msg);
     }
 
-    if (interruptNumber == hardwareInterruptOffset)
+    if (interruptNumber == hardwareInterruptOffset || interruptNumber == TaskManager::yieldInterrupt)
     {
         esp = (uint32_t)taskManager->schedule((CPUState*)esp);
     }
@@ -0,0 +1,137 @@
+#include "hardwareCommunication/ioProfiler.h"
+
+using namespace zoeos::common;
+using namespace zoeos::hardwareCommunication;
+
+void printf(const char *);
+void printHex(uint8_t);
+void printDec(uint64_t);
+
+IOProfiler::Entry IOProfiler::entries[IOProfiler::tableSize];
+IOProfiler::Summary IOProfiler::summary[IO_NUM_SUBSYSTEMS];
+uint32_t IOProfiler::overflow = 0;
+
+static const char *subsystemNames[IO_NUM_SUBSYSTEMS] = {
+    "unknown", "pic", "pci", "keyboard", "mouse", "net", "timer", "serial"
+};
+
+void IOProfiler::recordPort(uint16_t port, uint8_t subsystem, bool write, uint64_t cycles)
+{
+    record(((uint32_t)subsystem << 16) | port, false, subsystem, write, cycles);
+}
+
+void IOProfiler::recordMMIO(uint32_t address, uint8_t subsystem, bool write, uint64_t cycles)
+{
+    record(address, true, subsystem, write, cycles);
+}
+
+void IOProfiler::record(uint32_t key, bool mmio, uint8_t subsystem, bool write, uint64_t cycles)
+{
+    if (subsystem >= IO_NUM_SUBSYSTEMS)
+        subsystem = IO_UNKNOWN;
+
+    // accesses happen both in interrupt routines and in normal code
+    uint32_t eflags;
+    __asm__ volatile("pushfl; popl %0; cli" : "=r"(eflags));
+
+    summary[subsystem].accesses++;
+    summary[subsystem].cycles += cycles;
+
+    // open addressing, fibonacci hashing
+    uint32_t slot = ((key ^ (mmio ? 0x80000000 : 0)) * 2654435761u) >> 23;
+    for (int probe = 0; probe < tableSize; probe++)
+    {
+        Entry &entry = entries[(slot + probe) & (tableSize - 1)];
+        if (!entry.used)
+        {
+            entry.used = true;
+            entry.key = key;
+            entry.mmio = mmio;
+            entry.subsystem = subsystem;
+        }
+        if (entry.key == key && entry.mmio == mmio)
+        {
+            if (write)
+                entry.writes++;
+            else
+                entry.reads++;
+            entry.cycles += cycles;
+            __asm__ volatile("pushl %0; popfl" : : "r"(eflags));
+            return;
+        }
+    }
+    overflow++;
+    __asm__ volatile("pushl %0; popfl" : : "r"(eflags));
+}
+
+void IOProfiler::reset()
+{
+    for (int i = 0; i < tableSize; i++)
+        entries[i].used = false;
+    for (int i = 0; i < IO_NUM_SUBSYSTEMS; i++)
+    {
+        summary[i].accesses = 0;
+        summary[i].cycles = 0;
+    }
+    overflow = 0;
+}
+
+void IOProfiler::report(int topN)
+{
+    printf("------------- I/O profile --------------\n");
+    bool printed[tableSize];
+    for (int i = 0; i < tableSize; i++)
+        printed[i] = false;
+
+    for (int n = 0; n < topN; n++)
+    {
+        int best = -1;
+        for (int i = 0; i < tableSize; i++)
+        {
+            if (!entries[i].used || printed[i])
+                continue;
+            if (best < 0 || entries[i].reads + entries[i].writes > entries[best].reads + entries[best].writes)
+                best = i;
+        }
+        if (best < 0)
+            break;
+        printed[best] = true;
+
+        Entry &entry = entries[best];
+        printf(entry.mmio ? "mmio 0x" : "port 0x");
+        if (entry.mmio)
+        {
+            printHex((entry.key >> 24) & 0xff);
+            printHex((entry.key >> 16) & 0xff);
+        }
+        printHex((entry.key >> 8) & 0xff);
+        printHex(entry.key & 0xff);
+        printf(" ");
+        printf(subsystemNames[entry.subsystem]);
+        printf(" r=");
+        printDec(entry.reads);
+        printf(" w=");
+        printDec(entry.writes);
+        printf(" cycles=");
+        printDec(entry.cycles);
+        printf("\n");
+    }
+
+    for (int i = 0; i < IO_NUM_SUBSYSTEMS; i++)
+    {
+        if (summary[i].accesses == 0)
+            continue;
+        printf(subsystemNames[i]);
+        printf(": accesses=");
+        printDec(summary[i].accesses);
+        printf(" cycles=");
+        printDec(summary[i].cycles);
+        printf("\n");
+    }
+    if (overflow)
+    {
+        printf("untracked accesses: ");
+        printDec(overflow);
+        printf("\n");
+    }
+}
@@ -1,6 +1,5 @@
 #include "hardwareCommunication/pci.h"
-#include "memoryManager.h"
-#include "drivers/amd_am79c973.h"
+#include "hardwareCommunication/mmio.h"
 
 using namespace zoeos::common;
 using namespace zoeos::hardwareCommunication;
@@ -8,6 +7,9 @@ using namespace zoeos::drivers;
 
 void printf(const char *);
 void printHex(uint8_t );
+void printDec(uint64_t);
+
+PciController *PciController::activePci = nullptr;
 
 PciConfigSpace::PciConfigSpace() { }
 
@@ -30,16 +32,43 @@ PciConfigSpace::PciConfigSpace(uint8_t bus_, uint8_t device_,
     revision = revision_;
     interrupt = interrupt_;
     portBase = portBase_;
+    headerType = 0;
 }
 
 PciConfigSpace::~PciConfigSpace() { }
 
-PciController::PciController() : dataPort(0xcfc), addressPort(0xcf8) { }
+PciController::PciController() : dataPort(0xcfc, IO_PCI), addressPort(0xcf8, IO_PCI)
+{
+    ecamBase = 0;
+    ecamStartBus = 0;
+    ecamEndBus = 0;
+    numPciDrivers = 0;
+    numDevices = 0;
+    scanned = false;
+    configAccesses = 0;
+    scanAccesses = 0;
+    scanCycles = 0;
+    activePci = this;
+}
 
-PciController::~PciController() { }
+PciController::~PciController()
+{
+    if (activePci == this)
+        activePci = nullptr;
+}
 
-uint32_t PciController::pciConfigReadWord (uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset)
+uint32_t PciController::pciConfigReadWord (uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset)
 {
+    configAccesses++;
+    if (ecamBase && bus >= ecamStartBus && bus <= ecamEndBus)
+    {
+        uint32_t address = ecamBase + (((uint32_t)bus << 20) |
+                ((slot & 0x1f) << 15) | ((func & 0x07) << 12) | (offset & 0xffc));
+        return mmioRead32(address, IO_PCI) >> (8 * (offset % 4));
+    }
+    if (offset > 0xff)
+        return 0xffffffff;
+
     uint32_t CONFIG_ADDRESS = 1 << 31 | ((bus & 0xff) << 16) |
                   ((slot & 0x1f) << 11) | 
                   ((func & 0x07) << 8) |
@@ -49,8 +78,19 @@ uint32_t PciController::pciConfigReadWord (uint8_t bus, uint8_t slot, uint8_t fu
     return result >> (8 * (offset % 4));
 }
 
-void PciController::pciConfigWriteWord(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value)
+void PciController::pciConfigWriteWord(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset, uint32_t value)
 {
+    configAccesses++;
+    if (ecamBase && bus >= ecamStartBus && bus <= ecamEndBus)
+    {
+        uint32_t address = ecamBase + (((uint32_t)bus << 20) |
+                ((slot & 0x1f) << 15) | ((func & 0x07) << 12) | (offset & 0xffc));
+        mmioWrite32(address, value, IO_PCI);
+        return;
+    }
+    if (offset > 0xff)
+        return;
+
     uint32_t CONFIG_ADDRESS = 1 << 31 | ((bus & 0xff) << 16) |
             ((slot & 0x1f) << 11) | 
             ((func & 0x07) << 8) |
@@ -59,6 +99,58 @@ void PciController::pciConfigWriteWord(uint8_t bus, uint8_t slot, uint8_t func,
     dataPort.write(value);
 }
 
+bool PciController::enableECAM(Acpi *acpi)
+{
+    if (acpi == nullptr || !acpi->isAvailable())
+        return false;
+
+    AcpiMCFGEntry *entry = acpi->findMCFGEntry(0);
+    // paging is off, so the window must lie below 4 GiB to be addressable
+    if (entry == nullptr || (entry->baseAddress >> 32) != 0 || entry->startBus > entry->endBus)
+        return false;
+
+    // the MCFG base corresponds to bus 0 even when startBus is not 0
+    ecamBase = (uint32_t)entry->baseAddress;
+    ecamStartBus = entry->startBus;
+    ecamEndBus = entry->endBus;
+    return true;
+}
+
+uint8_t PciController::findCapability(PciConfigSpace *device, uint8_t capabilityID)
+{
+    // status register bit 4: capability list present
+    if (!(pciConfigReadWord(device->bus, device->device, device->function, 0x04) & (1 << 20)))
+        return 0;
+
+    uint8_t offset = pciConfigReadWord(device->bus, device->device, device->function, 0x34) & 0xfc;
+    for (int i = 0; offset && i < 48; i++)
+    {
+        uint32_t header = pciConfigReadWord(device->bus, device->device, device->function, offset);
+        if ((header & 0xff) == capabilityID)
+            return offset;
+        offset = (header >> 8) & 0xfc;
+    }
+    return 0;
+}
+
+uint16_t PciController::findExtendedCapability(PciConfigSpace *device, uint16_t capabilityID)
+{
+    if (!isECAMEnabled())
+        return 0;
+
+    uint16_t offset = 0x100;
+    for (int i = 0; offset >= 0x100 && i < 960; i++)
+    {
+        uint32_t header = pciConfigReadWord(device->bus, device->device, device->function, offset);
+        if (header == 0 || header == 0xffffffff)
+            return 0;
+        if ((header & 0xffff) == capabilityID)
+            return offset;
+        offset = (header >> 20) & 0xffc;
+    }
+    return 0;
+}
+
 bool PciController::isMultiFuncDevice(uint8_t bus, uint8_t device)
 {
     return pciConfigReadWord(bus, device, 0, 0x0e) & (1 << 7);
@@ -66,21 +158,156 @@ bool PciController::isMultiFuncDevice(uint8_t bus, uint8_t device)
 
 PciConfigSpace PciController::getConfigSpace(uint8_t bus, uint8_t device, uint8_t function)
 {
-    uint16_t vendorID = pciConfigReadWord(bus, device, function, 0);
-    uint16_t deviceID = pciConfigReadWord(bus, device, function, 0x02);
+    // whole registers: 4 config reads instead of one per field
+    uint32_t id = pciConfigReadWord(bus, device, function, 0x00);
+    uint32_t classReg = pciConfigReadWord(bus, device, function, 0x08);
+    uint32_t headerReg = pciConfigReadWord(bus, device, function, 0x0c);
+    uint32_t interrupt = pciConfigReadWord(bus, device, function, 0x3c) & 0xff;
 
-    uint8_t classCode = pciConfigReadWord(bus, device, function, 0x0b);
-    uint8_t subclass = pciConfigReadWord(bus, device, function, 0x0a);
-    uint8_t progIF = pciConfigReadWord(bus, device, function, 0x09);
-    uint8_t revision = pciConfigReadWord(bus, device, function, 0x08);
+    PciConfigSpace res(bus, device, function, id & 0xffff, id >> 16,
+            classReg >> 24, (classReg >> 16) & 0xff, (classReg >> 8) & 0xff,
+            classReg & 0xff, interrupt);
+    res.headerType = (headerReg >> 16) & 0xff;
+    return res;
+}
 
-    uint32_t interrupt = pciConfigReadWord(bus, device, function, 0x3c);
+void PciController::scan()
+{
+    numDevices = 0;
+    for (int i = 0; i < 8; i++)
+        scannedBuses[i] = 0;
+
+    uint32_t accesses = configAccesses;
+    uint64_t start = IOProfiler::rdtsc();
+
+    // a multi-function host bridge at 00:00.0 means one host controller per function
+    if ((pciConfigReadWord(0, 0, 0, 0x0e) & 0x80) == 0)
+    {
+        scanBus(0);
+    }
+    else
+    {
+        for (uint8_t function = 0; function < 8; function++)
+        {
+            if ((pciConfigReadWord(0, 0, function, 0x00) & 0xffff) != 0xffff)
+                scanBus(function);
+        }
+    }
 
-    return PciConfigSpace(bus, device, function, vendorID, deviceID, classCode, subclass, progIF, revision, interrupt);
+    scanCycles = IOProfiler::rdtsc() - start;
+    scanAccesses = configAccesses - accesses;
+    scanned = true;
 }
 
-void PciController::checkBuses(drivers::DriverManager *driverManager, InterruptManager *interrupts)
+void PciController::scanBus(uint8_t bus)
 {
+    if (scannedBuses[bus >> 5] & (1u << (bus & 31)))
+        return;
+    scannedBuses[bus >> 5] |= 1u << (bus & 31);
+
+    for (uint8_t device = 0; device < 32; device++)
+    {
+        uint16_t vendorID = pciConfigReadWord(bus, device, 0, 0x00);
+        if (vendorID == 0xffff || vendorID == 0)
+            continue;
+
+        // not devices[numDevices - 1]: a bridge appends what is behind it first
+        if (scanFunction(bus, device, 0) & 0x80)
+        {
+            for (uint8_t function = 1; function < 8; function++)
+            {
+                vendorID = pciConfigReadWord(bus, device, function, 0x00);
+                if (vendorID != 0xffff && vendorID != 0)
+                    scanFunction(bus, device, function);
+            }
+        }
+    }
+}
+
+uint8_t PciController::scanFunction(uint8_t bus, uint8_t device, uint8_t function)
+{
+    // with the table full no other function would be recorded either
+    if (numDevices >= maxDevices)
+        return 0;
+
+    PciConfigSpace &dev = devices[numDevices++];
+    dev = getConfigSpace(bus, device, function);
+
+    if ((dev.headerType & 0x7f) == 0x00)
+    {
+        // size all BARs with decoding switched off once
+        uint32_t command = pciConfigReadWord(bus, device, function, 0x04) & 0xffff;
+        pciConfigWriteWord(bus, device, function, 0x04, command & ~(COMMAND_IO_SPACE | COMMAND_MEMORY_SPACE));
+        for (uint8_t num = 0; num < 6; num++)
+        {
+            BaseAddressRegister &BAR = dev.bars[num];
+            BAR = sizeBaseAddressRegister(bus, device, function, num);
+            if (BAR.address && (BAR.type == BaseAddressRegister::Type::IO) && dev.portBase == 0)
+            {
+                dev.portBase = (uint32_t)BAR.address;
+            }
+            // the upper half of a 64-bit BAR is not a BAR of its own
+            if (BAR.is64Bit)
+                num++;
+        }
+        pciConfigWriteWord(bus, device, function, 0x04, command);
+    }
+    else if ((dev.headerType & 0x7f) == 0x01 && dev.classCode == 0x06 && dev.subclass == 0x04)
+    {
+        // PCI-to-PCI bridge: only descend into the buses behind it
+        uint32_t busNumbers = pciConfigReadWord(bus, device, function, 0x18);
+        uint8_t secondary = (busNumbers >> 8) & 0xff;
+        uint8_t subordinate = (busNumbers >> 16) & 0xff;
+        if (secondary > bus && secondary <= subordinate)
+            scanBus(secondary);
+    }
+    return dev.headerType;
+}
+
+PciConfigSpace *PciController::getDeviceByIndex(int index)
+{
+    if (index < 0 || index >= numDevices)
+        return nullptr;
+    return &devices[index];
+}
+
+PciConfigSpace *PciController::findDevice(uint16_t vendorID, uint16_t deviceID, int start)
+{
+    for (int i = start; i < numDevices; i++)
+    {
+        if (devices[i].vendorID == vendorID && devices[i].deviceID == deviceID)
+            return &devices[i];
+    }
+    return nullptr;
+}
+
+PciConfigSpace *PciController::findClass(uint8_t classCode, uint8_t subclass, int start)
+{
+    for (int i = start; i < numDevices; i++)
+    {
+        if (devices[i].classCode == classCode && devices[i].subclass == subclass)
+            return &devices[i];
+    }
+    return nullptr;
+}
+
+void PciController::reportScanCost()
+{
+    printf(isECAMEnabled() ? "PCI scan (ECAM): " : "PCI scan (port I/O): ");
+    printDec(numDevices);
+    printf(" functions, ");
+    printDec(scanAccesses);
+    printf(" config accesses, ");
+    printDec(scanCycles);
+    printf(" cycles\n");
+}
+
+void PciController::scanBruteForce()
+{
+    uint32_t accesses = configAccesses;
+    uint64_t start = IOProfiler::rdtsc();
+    uint32_t found = 0;
+
     for (uint16_t bus = 0; bus < 256; bus++)
     {
         for (uint8_t device = 0; device < 32; device++)
@@ -91,112 +318,166 @@ void PciController::checkBuses(drivers::DriverManager *driverManager, InterruptM
                 PciConfigSpace deviceConfigSpace = getConfigSpace(bus, device, function);
                 if (deviceConfigSpace.vendorID == 0 || deviceConfigSpace.vendorID == 0xffff)
                     continue;
-                
-                // printf("PCI BUS ");
-                // printHex(bus & 0xff);
-
-                // printf(", DEVICE ");
-                // printHex(device);
-
-                // printf(", FUNCTION ");
-                // printHex(function);
-
-                // printf(" = VENDOR ");
-                // printHex((deviceConfigSpace.vendorID & 0xff00) >> 8);
-                // printHex(deviceConfigSpace.vendorID & 0xff);
-
-                // printf(", DEVICE ");
-                // printHex((deviceConfigSpace.deviceID & 0xff00) >> 8);
-                // printHex(deviceConfigSpace.deviceID & 0xff);
-                // printf("\n");
-
                 for (uint8_t num = 0; num < 6; num++)
-                {
-                    BaseAddressRegister BAR = getBaseAddressRegister(bus, device, function, num);
-                    if (BAR.address && (BAR.type == BaseAddressRegister::Type::IO))
-                    {
-                        deviceConfigSpace.portBase = (uint32_t)BAR.address;
-                    }
-                }
-                Driver *driver = getDriver(deviceConfigSpace, interrupts);
-                if (driver)
-                {
-                    driverManager->addDriver(driver);
-                }
+                    getBaseAddressRegister(bus, device, function, num);
+                found++;
             }
         }
     }
+
+    uint64_t cycles = IOProfiler::rdtsc() - start;
+    printf("PCI brute-force scan: ");
+    printDec(found);
+    printf(" functions, ");
+    printDec(configAccesses - accesses);
+    printf(" config accesses, ");
+    printDec(cycles);
+    printf(" cycles\n");
 }
 
-Driver *PciController::getDriver(PciConfigSpace device, InterruptManager *interrupts)
+void PciController::checkBuses(drivers::DriverManager *driverManager, InterruptManager *interrupts)
 {
-    Driver *driver;
-    switch (device.vendorID)
+    if (!scanned)
+        scan();
+
+    for (int i = 0; i < numDevices; i++)
     {
-        case 0x1022:
+        Driver *driver = getDriver(&devices[i], interrupts);
+        if (driver)
         {
-            if (device.deviceID == 0x2000)
-            {
-                printf("information from AMD_AM79C973: ");
-                driver = (AMD_AM79C973*)MemoryManager::activeMM->malloc(sizeof(AMD_AM79C973));
-                if (driver != nullptr)
-                {
-                    driver = new AMD_AM79C973(&device, interrupts);
-                    printf("installed\n");
-                }
-                else
-                {
-                    printf("failed\n");
-                }
-                return driver;
-            }
+            driverManager->addDriver(driver);
         }
-        case 0x8086:
-            break;
     }
+}
+
+bool PciController::registerDriver(const PciDriver *driver)
+{
+    if (numPciDrivers >= maxDrivers)
+        return false;
+    pciDrivers[numPciDrivers++] = driver;
+    return true;
+}
+
+bool PciController::matches(const PciDeviceID *id, PciConfigSpace *device)
+{
+    return (id->vendorID == PCI_ANY_ID || id->vendorID == device->vendorID) &&
+           (id->deviceID == PCI_ANY_ID || id->deviceID == device->deviceID) &&
+           (id->classCode == PCI_ANY_ID || id->classCode == device->classCode) &&
+           (id->subclass == PCI_ANY_ID || id->subclass == device->subclass);
+}
 
-    switch (device.classCode)
+Driver *PciController::getDriver(PciConfigSpace *device, InterruptManager *interrupts)
+{
+    for (int i = 0; i < numPciDrivers; i++)
     {
-        case 0x03:
+        for (const PciDeviceID *id = pciDrivers[i]->idTable; id->vendorID != 0; id++)
         {
-            if (device.subclass == 0x00)
-            {
-                printf("VGA");
-                break;
-            }
+            if (!matches(id, device))
+                continue;
+            Driver *driver = pciDrivers[i]->probe(device, this, interrupts);
+            if (driver)
+                return driver;
             break;
         }
     }
-    return 0;
+    return nullptr;
 }
 
 BaseAddressRegister PciController::getBaseAddressRegister(uint8_t bus, uint8_t device, uint8_t function, uint8_t num)
+{
+    uint32_t command = pciConfigReadWord(bus, device, function, 0x04) & 0xffff;
+    pciConfigWriteWord(bus, device, function, 0x04, command & ~(COMMAND_IO_SPACE | COMMAND_MEMORY_SPACE));
+    BaseAddressRegister res = sizeBaseAddressRegister(bus, device, function, num);
+    pciConfigWriteWord(bus, device, function, 0x04, command);
+    return res;
+}
+
+BaseAddressRegister PciController::sizeBaseAddressRegister(uint8_t bus, uint8_t device, uint8_t function, uint8_t num)
 {
     BaseAddressRegister res;
-    uint32_t headerType = pciConfigReadWord(bus, device, function, 0x0e) & 0x7e;
+    uint32_t headerType = pciConfigReadWord(bus, device, function, 0x0e) & 0x7f;
     int numOfBAR = 6 - 4 * headerType;
     // 返回空对象
     if (num >= numOfBAR)
         return res;
 
-    uint32_t attribute = pciConfigReadWord(bus, device, function, 0x10 + 4 * num);
+    uint8_t offset = 0x10 + 4 * num;
+    uint32_t attribute = pciConfigReadWord(bus, device, function, offset);
     res.type = (attribute & 1) ? BaseAddressRegister::Type::IO : BaseAddressRegister::Type::MMIO;
 
+    // writing all ones returns the size mask in the writable address bits
+    pciConfigWriteWord(bus, device, function, offset, 0xffffffff);
+    uint32_t mask = pciConfigReadWord(bus, device, function, offset);
+    pciConfigWriteWord(bus, device, function, offset, attribute);
+
     if (res.type == BaseAddressRegister::Type::MMIO)
     {
+        res.prefetchable = attribute & 0x8;
+        uint64_t address = attribute & ~0xf;
+        uint64_t sizeMask = 0xffffffff00000000ull | (mask & ~0xf);
         switch ((attribute >> 1) & 0x3)
         {
-            case 0: 
-            case 1: 
+            // 32-bit, anywhere below 4 GiB
+            case 0:
+                break;
+            // below 1 MiB, legacy
+            case 1:
+                break;
+            // 64-bit, the next BAR holds the upper half
             case 2:
+            {
+                if (num + 1 >= numOfBAR)
+                    return res;
+                res.is64Bit = true;
+                uint32_t high = pciConfigReadWord(bus, device, function, offset + 4);
+                pciConfigWriteWord(bus, device, function, offset + 4, 0xffffffff);
+                uint32_t highMask = pciConfigReadWord(bus, device, function, offset + 4);
+                pciConfigWriteWord(bus, device, function, offset + 4, high);
+                address |= (uint64_t)high << 32;
+                sizeMask = ((uint64_t)highMask << 32) | (mask & ~0xf);
                 break;
+            }
+            default:
+                return res;
         }
+
+        uint64_t size = ~sizeMask + 1;
+        // without paging only the low 4 GiB can be addressed
+        if ((mask & ~0xf) == 0 || (address >> 32) != 0 || (size >> 32) != 0)
+            return res;
+        res.address = (uint8_t*)(uint32_t)address;
+        res.size = (uint32_t)size;
     }
     else
     {
         res.address = (uint8_t*)(attribute & ~0x3);
         res.prefetchable = false;
+        // I/O BARs may leave the upper 16 bits unimplemented
+        uint32_t ioMask = (mask & ~0x3) | 0xffff0000;
+        if ((mask & ~0x3) != 0)
+            res.size = ~ioMask + 1;
     }
     return res;
 }
 
+void PciController::setCommand(PciConfigSpace *device, uint16_t set, uint16_t clear)
+{
+    // the status half of the register is write-one-to-clear, so write zeros there
+    uint32_t command = pciConfigReadWord(device->bus, device->device, device->function, 0x04) & 0xffff;
+    command = (command | set) & ~(uint32_t)clear;
+    pciConfigWriteWord(device->bus, device->device, device->function, 0x04, command);
+}
+
+void *PciController::mapBaseAddressRegister(PciConfigSpace *device, int num)
+{
+    if (num < 0 || num >= 6)
+        return nullptr;
+    const BaseAddressRegister &BAR = device->bars[num];
+    if (BAR.type != BaseAddressRegister::Type::MMIO || !BAR.isValid())
+        return nullptr;
+
+    // Paging is off, so the BAR is identity mapped and its caching type comes
+    // from the firmware MTRRs, which mark the PCI hole uncacheable.
+    enableMemorySpace(device);
+    return BAR.address;
+}
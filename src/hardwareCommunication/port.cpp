@@ -2,86 +2,100 @@
 
 using namespace zoeos::hardwareCommunication;
 
-Port::Port(uint16_t portnumber)
-    : portnumber(portnumber) {}
+Port::Port(uint16_t portnumber, uint8_t subsystem)
+    : portnumber(portnumber), subsystem(subsystem) {}
 
 Port::~Port() {}
 
-Port8Bit::Port8Bit(uint16_t portnumber)
-    : Port(portnumber) {}
+Port8Bit::Port8Bit(uint16_t portnumber, uint8_t subsystem)
+    : Port(portnumber, subsystem) {}
 
 Port8Bit::~Port8Bit() {}
 
 inline void Port8Bit::write(uint8_t data)
 {
+    IO_PROFILE_BEGIN();
     __asm__ volatile("outb %0, %1"
                      :
                      : "a"(data), "Nd"(portnumber));
+    IO_PROFILE_PORT(portnumber, subsystem, true);
 }
 
 inline uint8_t Port8Bit::read()
 {
+    IO_PROFILE_BEGIN();
     uint8_t result;
     __asm__ volatile("inb %1, %0"
                      : "=a"(result)
                      : "Nd"(portnumber)
     );
+    IO_PROFILE_PORT(portnumber, subsystem, false);
     return result;
 }
 
-Port8BitSlow::Port8BitSlow(uint16_t portnumber)
-    : Port8Bit(portnumber) {}
+Port8BitSlow::Port8BitSlow(uint16_t portnumber, uint8_t subsystem)
+    : Port8Bit(portnumber, subsystem) {}
 
 Port8BitSlow::~Port8BitSlow() {}
 
 inline void Port8BitSlow::write(uint8_t data)
 {
+    IO_PROFILE_BEGIN();
     __asm__ volatile("outb %0, %1\njmp 1f\n1: jmp 1f\n1:"
                      : 
                      : "a"(data), "Nd"(portnumber)
     );
+    IO_PROFILE_PORT(portnumber, subsystem, true);
 }
 
-Port16Bit::Port16Bit(uint16_t portnumber)
-    : Port(portnumber) {}
+Port16Bit::Port16Bit(uint16_t portnumber, uint8_t subsystem)
+    : Port(portnumber, subsystem) {}
 
 Port16Bit::~Port16Bit() {}
 
 inline void Port16Bit::write(uint16_t data)
 {
+    IO_PROFILE_BEGIN();
     __asm__ volatile("outw %0, %1"
                      :
                      : "a"(data), "Nd"(portnumber)
     );
+    IO_PROFILE_PORT(portnumber, subsystem, true);
 }
 
 inline uint16_t Port16Bit::read()
 {
+    IO_PROFILE_BEGIN();
     uint16_t result;
     __asm__ volatile("inw %1, %0"
                      : "=a"(result)
                      : "Nd"(portnumber));
+    IO_PROFILE_PORT(portnumber, subsystem, false);
     return result;
 }
 
-Port32Bit::Port32Bit(uint16_t portnumber)
-    : Port(portnumber) {}
+Port32Bit::Port32Bit(uint16_t portnumber, uint8_t subsystem)
+    : Port(portnumber, subsystem) {}
 
 Port32Bit::~Port32Bit() {}
 
 inline void Port32Bit::write(uint32_t data)
 {
+    IO_PROFILE_BEGIN();
     __asm__ volatile("outl %0, %1"
                      :
                      : "a"(data), "Nd"(portnumber)
     );
+    IO_PROFILE_PORT(portnumber, subsystem, true);
 }
 
 inline uint32_t Port32Bit::read()
 {
+    IO_PROFILE_BEGIN();
     uint32_t result;
     __asm__ volatile("inl %1, %0"
                      : "=a"(result)
                      : "Nd"(portnumber));
+    IO_PROFILE_PORT(portnumber, subsystem, false);
     return result;
 }
\ No newline at end of file
@@ -3,12 +3,28 @@
 #include "hardwareCommunication/interrupts.h"
 #include "drivers/keyboard.h"
 #include "drivers/mouse.h"
+#include "drivers/timer.h"
+#include "drivers/serial.h"
+#include "drivers/console.h"
 #include "drivers/driver.h"
 #include "hardwareCommunication/pci.h"
 #include "multitask.h"
 #include "memoryManager.h"
 #include "drivers/amd_am79c973.h"
+#include "drivers/virtioNet.h"
+#include "drivers/e1000.h"
 #include "net/etherframe.h"
+#include "net/arp.h"
+#include "net/ipv4.h"
+#include "net/icmp.h"
+#include "net/udp.h"
+#include "net/tcp.h"
+#include "net/tcpBenchmark.h"
+#include "net/benchmark.h"
+#include "net/pktgen.h"
+#include "net/capture.h"
+#include "net/netstat.h"
+#include "poller.h"
 
 using namespace zoeos;
 using namespace zoeos::drivers;
@@ -17,12 +33,12 @@ using namespace zoeos::net;
 
 void printf(const char *str);
 void printHex(uint8_t);
+void printDec(uint64_t);
 void fTask1();
 void fTask2();
 
-// screen address
-static uint16_t *VideoMemory = (uint16_t*)0xb8000;
-static uint8_t x = 0, y = 0;
+// built before kernelMain, so the first printf has a screen to go to
+static Console console;
 
 void printHex(uint8_t n) {
     char* str = (char*)"00";
@@ -32,37 +48,23 @@ void printHex(uint8_t n) {
     printf((const char*)str);
 }
 
-void printf(const char *str)
+void printDec(uint64_t n)
 {
-    for (int i = 0; str[i]; i++)
+    char str[21];
+    int len = 20;
+    str[len] = 0;
+    do
     {
-        switch (str[i])
-        {
-            case '\n':
-                y++;
-                x = 0;
-                break;
-            default:
-                VideoMemory[80 * y + x] = (VideoMemory[80 * y + x] & 0xFF00) | str[i];
-                x++;
-        }
+        str[--len] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    printf(str + len);
+}
 
-        if (x >= 80)
-        {
-            x = 0;
-            y++;
-        }
-        if (y >= 25)
-        {
-            for (y = 0; y < 25; y++)
-            {
-                for (x = 0; x < 80; x++)
-                    VideoMemory[i] = (VideoMemory[i] & 0xFF00) | ' ';
-            }
-            x = 0;
-            y = 0;
-        }
-    }
+void printf(const char *str)
+{
+    // shows up once the kernel's loop polls the console
+    console.write(str);
 }
 
 void fTask1()
@@ -81,6 +83,62 @@ void fTask2()
     }
 }
 
+#ifdef ZOEOS_ECHO
+// RFC 862 echo on UDP and TCP port 7, every socket served by one task
+// that sleeps in Poller::wait
+static UserDatagramProtocolSocket *echoSocket = nullptr;
+static TransmissionControlProtocolSocket *echoListener = nullptr;
+// too big for the task's stack
+static Poller *echoPoller = nullptr;
+static uint8_t echoBuffer[512];
+
+void echoTask()
+{
+    Poller &poller = *echoPoller;
+    PollEvent events[8];
+    poller.add(echoSocket, POLL_IN, echoSocket);
+    poller.add(echoListener, POLL_IN, echoListener);
+    while (1)
+    {
+        int count = poller.wait(events, 8);
+        for (int i = 0; i < count; i++)
+        {
+            if (events[i].cookie == echoSocket)
+            {
+                uint32_t srcIP;
+                uint16_t srcPort;
+                while (NetBuffer *datagram = echoSocket->receive(&srcIP, &srcPort, false))
+                {
+                    echoSocket->sendTo(srcIP, srcPort, datagram->data, datagram->size);
+                    datagram->release();
+                }
+            }
+            else if (events[i].cookie == echoListener)
+            {
+                while (TransmissionControlProtocolSocket *connection = echoListener->accept(false))
+                {
+                    if (!poller.add(connection, POLL_IN, connection))
+                        connection->close();
+                }
+            }
+            else
+            {
+                TransmissionControlProtocolSocket *connection = (TransmissionControlProtocolSocket*)events[i].cookie;
+                int received;
+                while ((received = connection->receive(echoBuffer, sizeof(echoBuffer), false)) > 0)
+                    connection->send(echoBuffer, received);
+                // the peer closed or reset it
+                if (received == 0 || connection->getState() == TCP_CLOSED)
+                {
+                    poller.remove(connection);
+                    connection->close();
+                }
+            }
+        }
+    }
+}
+#endif
+
 void kernelMain(void *multiboot_structure, uint32_t magicnumber)
 {
     printf("hello world\n");
@@ -90,6 +148,8 @@ void kernelMain(void *multiboot_structure, uint32_t magicnumber)
     size_t heap = 10 * 1024 * 1024;
     uint32_t *memupper = (uint32_t*)((size_t)multiboot_structure + 8);
     MemoryManager memoryManager(heap, (*memupper) * 1024 - heap - 10 * 1024);
+    // the checksum loops use XMM registers when the CPU has them
+    InternetChecksum::enableSSE2();
 
     TaskManager taskManager;
     // Task task1(&gdt, fTask1);
@@ -99,6 +159,7 @@ void kernelMain(void *multiboot_structure, uint32_t magicnumber)
 
     InterruptManager interrupts(0x20, &gdt, &taskManager);
     DriverManager drvManager;
+    drvManager.addDriver(&console);
 
     KeyboardDriver keyboard(&interrupts);
     drvManager.addDriver(&keyboard);
@@ -106,13 +167,82 @@ void kernelMain(void *multiboot_structure, uint32_t magicnumber)
     MouseDriver mouse(&interrupts);
     drvManager.addDriver(&mouse);
 
+    TimerDriver timer(&interrupts, 1000);
+    drvManager.addDriver(&timer);
+
+    SerialPort serial;
+    drvManager.addDriver(&serial);
+
+    Acpi acpi;
     PciController PCI;
+    PCI.registerDriver(&AMD_AM79C973::pciDriver);
+    PCI.registerDriver(&VirtioNet::pciDriver);
+    PCI.registerDriver(&E1000::pciDriver);
+    PCI.enableECAM(&acpi);
+    PCI.scan();
+    PCI.reportScanCost();
+#ifdef ZOEOS_PROFILE_IO
+    PCI.scanBruteForce();
+#endif
     PCI.checkBuses(&drvManager, &interrupts);
     drvManager.activeAll();
+#ifdef ZOEOS_PROFILE_IO
+    IOProfiler::report(10);
+#endif
 
-    AMD_AM79C973 *eth0 = (AMD_AM79C973*)(drvManager.drivers[2]);
-    EtherFrameWrapper etherFrameWrapper(eth0);
-    etherFrameWrapper.send(0xffffffffffff, 0x608, (uint8_t*)"Hello networks", 13);
+    NetDevice *eth0 = (NetDevice*)drvManager.getDriver(Driver::NETWORK);
+    if (eth0)
+    {
+        EtherFrameWrapper *etherFrameWrapper = new EtherFrameWrapper(eth0);
+        // further cards share the Ethernet layer, destinations are spread over them
+        for (int i = 1; Driver *driver = drvManager.getDriver(Driver::NETWORK, i); i++)
+            etherFrameWrapper->bind((NetDevice*)driver);
+#ifdef ZOEOS_CAPTURE
+        etherFrameWrapper->setCapture(new PacketCapture(&serial));
+        taskManager.addTask(new Task(&gdt, PacketCapture::drainTask));
+#endif
+        // QEMU user networking: we are 10.0.2.15, the gateway is 10.0.2.2.
+        // A PCnet keeps the request in its TX ring until the init-done interrupt starts the chip.
+#ifdef ZOEOS_TCP_BENCH_TX
+        // the sending guest of a pair takes the next address
+        uint32_t ipAddress = 0x1002000a;
+#else
+        uint32_t ipAddress = 0x0f02000a;
+#endif
+        AddressResolutionProtocol *arp = new AddressResolutionProtocol(etherFrameWrapper, ipAddress);
+        arp->requestMACAddress(0x0202000a);
+        InternetProtocolProvider *ipv4 = new InternetProtocolProvider(etherFrameWrapper, arp, ipAddress, 0x00ffffff, 0x0202000a);
+        new InternetControlMessageProtocol(ipv4);
+        UserDatagramProtocolProvider *udp = new UserDatagramProtocolProvider(ipv4);
+        TransmissionControlProtocolProvider *tcp = new TransmissionControlProtocolProvider(ipv4);
+#ifdef ZOEOS_ECHO
+        echoSocket = udp->bind(0, 7);
+        echoListener = tcp->listen(7);
+        echoPoller = new Poller();
+        taskManager.addTask(new Task(&gdt, echoTask));
+#endif
+
+#ifdef ZOEOS_PKTGEN_TX
+        // broadcast, so the sink needs no address
+        new PacketGenerator(etherFrameWrapper, 0xffffffffffff);
+        taskManager.addTask(new Task(&gdt, PacketGenerator::taskEntry));
+#endif
+#ifdef ZOEOS_PKTGEN_RX
+        new PacketSink(etherFrameWrapper);
+#endif
+#ifdef ZOEOS_TCP_BENCH_TX
+        new TcpBenchmark(tcp, 0x0f02000a);
+        taskManager.addTask(new Task(&gdt, TcpBenchmark::taskEntry));
+#endif
+#ifdef ZOEOS_TCP_BENCH_RX
+        new TcpBenchmark(tcp, 0);
+        taskManager.addTask(new Task(&gdt, TcpBenchmark::taskEntry));
+#endif
+    }
+
+#ifdef ZOEOS_NET_BENCH
+    benchmarkEtherFrame(100000);
+#endif
 
     interrupts.activate();
 
@@ -129,7 +259,12 @@ void kernelMain(void *multiboot_structure, uint32_t magicnumber)
     printHex((size_t)allocated & 0xff);
     printf("\n------------- end test allocate --------------\n");
 
-    while (1);
+    // deferred driver work, e.g. draining NIC receive rings, and counter dumps asked for by F11/F12
+    while (1)
+    {
+        drvManager.pollAll(64);
+        NetStatistics::poll();
+    }
 }
 
 typedef void (*constructor)();
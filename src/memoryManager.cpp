@@ -125,3 +125,57 @@ void operator delete[](void *ptr)
         MemoryManager::activeMM->free(ptr);
     }
 }
+
+// what the compiler calls for deleting complete objects
+void operator delete(void *ptr, size_t size)
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t size)
+{
+    operator delete[](ptr);
+}
+
+// Over-aligned objects: the chunk is padded so the object can start on the
+// boundary, and the pointer malloc gave sits in the word before it. These
+// are throw(), so the compiler checks for nullptr before constructing.
+void *operator new(size_t size, std::align_val_t alignment) throw()
+{
+    size_t align = (size_t)alignment;
+    if (MemoryManager::activeMM == nullptr)
+        return nullptr;
+    // malloc, not operator new, whose result the compiler may assume is not nullptr
+    uint8_t *raw = (uint8_t*)MemoryManager::activeMM->malloc(size + align + sizeof(void*));
+    if (raw == nullptr)
+        return nullptr;
+    void **aligned = (void**)(((size_t)raw + sizeof(void*) + align - 1) & ~(align - 1));
+    aligned[-1] = raw;
+    return aligned;
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) throw()
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void *ptr, std::align_val_t alignment)
+{
+    if (ptr)
+        operator delete(((void**)ptr)[-1]);
+}
+
+void operator delete[](void *ptr, std::align_val_t alignment)
+{
+    operator delete(ptr, alignment);
+}
+
+void operator delete(void *ptr, size_t size, std::align_val_t alignment)
+{
+    operator delete(ptr, alignment);
+}
+
+void operator delete[](void *ptr, size_t size, std::align_val_t alignment)
+{
+    operator delete(ptr, alignment);
+}
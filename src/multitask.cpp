@@ -18,9 +18,15 @@ Task::Task(GlobalDescriptorTable *gdt, void (*entrypoint)())
     cpuState->eip = (uint32_t)entrypoint;
     cpuState->cs = gdt->getCodeSegmentSelector() << 3;
     cpuState->eflags = 0x202;
+    waitChannel = nullptr;
 }
 
-TaskManager::TaskManager() : numTasks(0), currentTask(-1) { }
+TaskManager *TaskManager::activeTaskManager = nullptr;
+
+TaskManager::TaskManager() : kernelState(nullptr), numTasks(0), currentTask(-1)
+{
+    activeTaskManager = this;
+}
 
 bool TaskManager::addTask(Task *task)
 {
@@ -35,9 +41,41 @@ CPUState *TaskManager::schedule(CPUState *cpuState)
     if (numTasks <= 0)
         return cpuState;
     
-    tasks[currentTask]->saveState(cpuState);
-    if (++currentTask >= numTasks)
-        currentTask %= numTasks;
-    return tasks[currentTask]->getCpuState();
+    // -1 is the kernel's own flow
+    if (currentTask < 0)
+        kernelState = cpuState;
+    else
+        tasks[currentTask]->saveState(cpuState);
+    // sleeping tasks are skipped, the kernel's flow always runs
+    while (++currentTask < numTasks)
+    {
+        if (tasks[currentTask]->waitChannel == nullptr)
+            return tasks[currentTask]->getCpuState();
+    }
+    currentTask = -1;
+    return kernelState;
+}
+
+bool TaskManager::sleep(const void *channel)
+{
+    if (currentTask < 0)
+        return false;
+    tasks[currentTask]->waitChannel = channel;
+    yield();
+    return true;
+}
+
+void TaskManager::wakeUp(const void *channel)
+{
+    for (int i = 0; i < numTasks; i++)
+    {
+        if (tasks[i]->waitChannel == channel)
+            tasks[i]->waitChannel = nullptr;
+    }
+}
+
+void TaskManager::yield()
+{
+    __asm__ volatile("int %0" : : "i"(yieldInterrupt));
 }
 
@@ -0,0 +1,336 @@
+#include "net/arp.h"
+#include "drivers/timer.h"
+#include "hardwareCommunication/interrupts.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::hardwareCommunication;
+using namespace zoeos::net;
+
+static const uint16_t ARP_ETHERTYPE = 0x0806;
+static const uint16_t ETHERTYPE_IPV4_BE = 0x0008;
+static const uint16_t ARP_REQUEST_BE = 0x0100;
+static const uint16_t ARP_REPLY_BE = 0x0200;
+static const uint64_t BROADCAST_MAC = 0xffffffffffff;
+
+static const NetStatField arpFields[] =
+{
+    NETSTAT_FIELD(ArpStatistics, requestsSent),
+    NETSTAT_FIELD(ArpStatistics, requestsReceived),
+    NETSTAT_FIELD(ArpStatistics, repliesSent),
+    NETSTAT_FIELD(ArpStatistics, repliesReceived),
+    NETSTAT_FIELD(ArpStatistics, cacheHits),
+    NETSTAT_FIELD(ArpStatistics, cacheMisses),
+    NETSTAT_FIELD(ArpStatistics, queueDrops),
+    NETSTAT_FIELD(ArpStatistics, resolutionFailures),
+    NETSTAT_FIELD(ArpStatistics, malformed)
+};
+
+AddressResolutionProtocol::AddressResolutionProtocol(EtherFrameWrapper *etherFrameWrapper, uint32_t ipAddress_BE)
+    : EtherFrameHandler(etherFrameWrapper, ARP_ETHERTYPE)
+{
+    ipAddress = ipAddress_BE;
+    stats = ArpStatistics();
+    NetStatistics::add("arp", -1, &stats, arpFields, sizeof(arpFields) / sizeof(arpFields[0]));
+    for (int i = 0; i < ZOEOS_ARP_CACHE_SETS * ways; i++)
+    {
+        cache[i].state = FREE;
+        cache[i].pendingHead = nullptr;
+        cache[i].pendingTail = nullptr;
+        cache[i].numPending = 0;
+    }
+    // a few packets per unresolved neighbor, shared by all of them
+    pendingPool = new NetBufferPool(ZOEOS_ARP_CACHE_SETS, 1536);
+    if (TimerDriver::activeTimer)
+        TimerDriver::activeTimer->addPeriodic(tick, this, TimerDriver::activeTimer->getFrequency() / 10);
+}
+
+AddressResolutionProtocol::~AddressResolutionProtocol()
+{
+    NetStatistics::remove(&stats);
+    if (TimerDriver::activeTimer)
+        TimerDriver::activeTimer->removePeriodic(tick, this);
+    for (int i = 0; i < ZOEOS_ARP_CACHE_SETS * ways; i++)
+        dropPending(&cache[i]);
+    delete pendingPool;
+}
+
+uint64_t AddressResolutionProtocol::now()
+{
+    return TimerDriver::activeTimer ? TimerDriver::activeTimer->getMilliseconds() : 0;
+}
+
+AddressResolutionProtocol::Neighbor *AddressResolutionProtocol::lookup(uint32_t ipAddress_BE)
+{
+    uint32_t hash = ipAddress_BE * 2654435761u;
+    Neighbor *set = &cache[((hash >> 16) & (ZOEOS_ARP_CACHE_SETS - 1)) * ways];
+    for (int i = 0; i < ways; i++)
+    {
+        if (set[i].state != FREE && set[i].ipAddress == ipAddress_BE)
+            return &set[i];
+    }
+    return nullptr;
+}
+
+AddressResolutionProtocol::Neighbor *AddressResolutionProtocol::insert(uint32_t ipAddress_BE)
+{
+    uint32_t hash = ipAddress_BE * 2654435761u;
+    Neighbor *set = &cache[((hash >> 16) & (ZOEOS_ARP_CACHE_SETS - 1)) * ways];
+    Neighbor *victim = nullptr;
+    for (int i = 0; i < ways; i++)
+    {
+        if (set[i].state == FREE)
+        {
+            victim = &set[i];
+            break;
+        }
+        // keep entries with waiting packets, then the most recently confirmed
+        if (victim == nullptr || (victim->numPending && !set[i].numPending) ||
+            (!victim->numPending == !set[i].numPending && set[i].confirmed < victim->confirmed))
+            victim = &set[i];
+    }
+    dropPending(victim);
+    victim->ipAddress = ipAddress_BE;
+    victim->state = INCOMPLETE;
+    victim->retries = 0;
+    victim->MACAddress = 0;
+    victim->confirmed = 0;
+    victim->requested = 0;
+    return victim;
+}
+
+void AddressResolutionProtocol::update(Neighbor *neighbor, uint64_t MACAddress)
+{
+    neighbor->MACAddress = MACAddress;
+    neighbor->state = REACHABLE;
+    neighbor->confirmed = now();
+    neighbor->retries = 0;
+    flushPending(neighbor);
+}
+
+bool AddressResolutionProtocol::onEtherFrameReceived(uint8_t *etherframePayload, uint32_t size)
+{
+    if (size < sizeof(AddressResolutionProtocolMessage))
+    {
+        stats.malformed++;
+        return false;
+    }
+    AddressResolutionProtocolMessage *arp = (AddressResolutionProtocolMessage*)etherframePayload;
+    // tasks sending through sendIPv4() change the cache too
+    InterruptGuard guard;
+    // Ethernet, IPv4
+    if (arp->hardwareType != 0x0100 || arp->protocol != ETHERTYPE_IPV4_BE ||
+        arp->hardwareAddressSize != 6 || arp->protocolAddressSize != 4)
+    {
+        stats.malformed++;
+        return false;
+    }
+
+    // RFC 826: refresh a known sender whatever the target, learn it if we are the target
+    Neighbor *neighbor = lookup(arp->srcIP);
+    if (neighbor)
+        update(neighbor, arp->srcMAC);
+    if (arp->dstIP != ipAddress)
+        return false;
+    if (neighbor == nullptr && arp->srcIP != 0)
+        update(insert(arp->srcIP), arp->srcMAC);
+
+    if (arp->command == ARP_REQUEST_BE)
+    {
+        stats.requestsReceived++;
+        // not answered in place: the reply must carry the MAC of the device send() picks
+        sendMessage(ARP_REPLY_BE, arp->srcMAC, arp->srcIP, arp->srcMAC);
+        stats.repliesSent++;
+    }
+    else if (arp->command == ARP_REPLY_BE)
+    {
+        stats.repliesReceived++;
+    }
+    return false;
+}
+
+void AddressResolutionProtocol::sendMessage(uint16_t command, uint64_t dstMAC, uint32_t dstIP, uint64_t etherDstMAC)
+{
+    NetDevice *device = etherFrameWrapper->route(etherDstMAC);
+    if (device == nullptr)
+        return;
+
+    AddressResolutionProtocolMessage arp;
+    arp.hardwareType = 0x0100;
+    arp.protocol = ETHERTYPE_IPV4_BE;
+    arp.hardwareAddressSize = 6;
+    arp.protocolAddressSize = 4;
+    arp.command = command;
+    arp.srcMAC = device->getMACAddr();
+    arp.srcIP = ipAddress;
+    arp.dstMAC = dstMAC;
+    arp.dstIP = dstIP;
+    send(etherDstMAC, (uint8_t*)&arp, sizeof(AddressResolutionProtocolMessage));
+}
+
+void AddressResolutionProtocol::sendRequest(Neighbor *neighbor)
+{
+    neighbor->requested = now();
+    neighbor->retries++;
+    // a stale neighbor is asked directly first, like Linux' unicast probes
+    uint64_t etherDstMAC = neighbor->state == STALE && neighbor->retries == 1 ? neighbor->MACAddress : BROADCAST_MAC;
+    sendMessage(ARP_REQUEST_BE, 0, neighbor->ipAddress, etherDstMAC);
+    stats.requestsSent++;
+}
+
+void AddressResolutionProtocol::requestMACAddress(uint32_t ipAddress_BE)
+{
+    InterruptGuard guard;
+    Neighbor *neighbor = lookup(ipAddress_BE);
+    if (neighbor == nullptr)
+        neighbor = insert(ipAddress_BE);
+    if (neighbor->state == INCOMPLETE && neighbor->retries)
+        return;
+    sendRequest(neighbor);
+}
+
+void AddressResolutionProtocol::announce()
+{
+    // gratuitous ARP: a request for our own address
+    sendMessage(ARP_REQUEST_BE, 0, ipAddress, BROADCAST_MAC);
+    stats.requestsSent++;
+}
+
+uint64_t AddressResolutionProtocol::resolve(uint32_t ipAddress_BE)
+{
+    Neighbor *neighbor = lookup(ipAddress_BE);
+    if (neighbor == nullptr || neighbor->state == INCOMPLETE)
+    {
+        stats.cacheMisses++;
+        return 0;
+    }
+    stats.cacheHits++;
+    uint64_t time = now();
+    if (neighbor->state == REACHABLE && time - neighbor->confirmed >= reachableTime)
+    {
+        neighbor->state = STALE;
+        neighbor->retries = 0;
+    }
+    // keep using the old MAC while asking again, at most once per retransmitTime
+    if (neighbor->state == STALE && neighbor->retries < maxRetries &&
+        (neighbor->retries == 0 || time - neighbor->requested >= retransmitTime))
+        sendRequest(neighbor);
+    return neighbor->MACAddress;
+}
+
+TxStatus AddressResolutionProtocol::sendIPv4(uint32_t nextHopIP_BE, const TxFragment *fragments, int count,
+        TxCompletion completion, void *cookie)
+{
+    // tasks send while kernelMain's flow runs the receive path and tick(),
+    // and the timer can switch between them in the middle of a queue update
+    InterruptGuard guard;
+    uint64_t MACAddress = resolve(nextHopIP_BE);
+    if (MACAddress)
+        return etherFrameWrapper->send(MACAddress, ETHERTYPE_IPV4_BE, fragments, count, completion, cookie);
+
+    Neighbor *neighbor = lookup(nextHopIP_BE);
+    if (neighbor == nullptr)
+    {
+        neighbor = insert(nextHopIP_BE);
+        sendRequest(neighbor);
+    }
+
+    NetBuffer *copy = neighbor->numPending < maxPending ? pendingPool->alloc() : nullptr;
+    if (copy == nullptr)
+    {
+        stats.queueDrops++;
+        return TX_DROPPED;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (copy->size + fragments[i].size > pendingPool->getBufferSize())
+        {
+            copy->release();
+            return TX_INVALID;
+        }
+        for (uint32_t n = 0; n < fragments[i].size; n++)
+            copy->data[copy->size + n] = fragments[i].data[n];
+        copy->size += fragments[i].size;
+    }
+    if (neighbor->pendingTail)
+        neighbor->pendingTail->next = copy;
+    else
+        neighbor->pendingHead = copy;
+    neighbor->pendingTail = copy;
+    neighbor->numPending++;
+
+    // the caller's fragments are no longer needed
+    if (completion)
+        completion(cookie);
+    return TX_QUEUED;
+}
+
+void AddressResolutionProtocol::flushPending(Neighbor *neighbor)
+{
+    while (neighbor->pendingHead)
+    {
+        NetBuffer *buffer = neighbor->pendingHead;
+        neighbor->pendingHead = buffer->next;
+        buffer->next = nullptr;
+        etherFrameWrapper->send(neighbor->MACAddress, ETHERTYPE_IPV4_BE, buffer->data, buffer->size);
+        buffer->release();
+    }
+    neighbor->pendingTail = nullptr;
+    neighbor->numPending = 0;
+}
+
+void AddressResolutionProtocol::dropPending(Neighbor *neighbor)
+{
+    while (neighbor->pendingHead)
+    {
+        NetBuffer *buffer = neighbor->pendingHead;
+        neighbor->pendingHead = buffer->next;
+        buffer->next = nullptr;
+        buffer->release();
+        stats.queueDrops++;
+    }
+    neighbor->pendingTail = nullptr;
+    neighbor->numPending = 0;
+}
+
+void AddressResolutionProtocol::tick(void *cookie)
+{
+    AddressResolutionProtocol *arp = (AddressResolutionProtocol*)cookie;
+    InterruptGuard guard;
+    uint64_t time = now();
+    for (int i = 0; i < ZOEOS_ARP_CACHE_SETS * ways; i++)
+    {
+        Neighbor *neighbor = &arp->cache[i];
+        switch (neighbor->state)
+        {
+        case INCOMPLETE:
+            if (time - neighbor->requested < retransmitTime)
+                break;
+            if (neighbor->retries >= maxRetries)
+            {
+                arp->stats.resolutionFailures++;
+                arp->dropPending(neighbor);
+                neighbor->state = FREE;
+            }
+            else
+            {
+                arp->sendRequest(neighbor);
+            }
+            break;
+        case REACHABLE:
+            if (time - neighbor->confirmed >= reachableTime)
+            {
+                neighbor->state = STALE;
+                neighbor->retries = 0;
+            }
+            break;
+        case STALE:
+            // unused for long, or asked maxRetries times without an answer
+            if (time - neighbor->confirmed >= staleTime ||
+                (neighbor->retries >= maxRetries && time - neighbor->requested >= retransmitTime))
+                neighbor->state = FREE;
+            break;
+        }
+    }
+}
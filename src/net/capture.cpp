@@ -0,0 +1,201 @@
+#include "net/capture.h"
+#include "drivers/timer.h"
+#include "hardwareCommunication/ioProfiler.h"
+#include "memoryManager.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::hardwareCommunication;
+using namespace zoeos::net;
+
+void printf(const char *);
+void printDec(uint64_t);
+
+PacketCapture *PacketCapture::activeCapture = nullptr;
+
+struct PcapFileHeader
+{
+    uint32_t magic;
+    uint16_t versionMajor;
+    uint16_t versionMinor;
+    int32_t timezone;
+    uint32_t sigfigs;
+    uint32_t snapLength;
+    uint32_t linkType;
+} __attribute__((packed));
+
+struct PcapRecordHeader
+{
+    uint32_t seconds;
+    uint32_t microseconds;
+    uint32_t captured;
+    uint32_t length;
+} __attribute__((packed));
+
+PacketCapture::PacketCapture(SerialPort *serial_, uint32_t slots_, uint32_t snapLength_)
+{
+    serial = serial_;
+    // round down to a power of two
+    slots = 1;
+    while (slots * 2 <= slots_)
+        slots *= 2;
+    snapLength = snapLength_;
+    slotSize = (sizeof(Slot) + snapLength + 15) & ~15;
+    storage = (uint8_t*)MemoryManager::activeMM->malloc(slots * slotSize);
+    if (storage == nullptr)
+        slots = 0;
+    for (uint32_t i = 0; i < slots; i++)
+        slot(i)->sequence = i;
+    head = 0;
+    tail = 0;
+    drops = 0;
+    reportedDrops = 0;
+    startTsc = IOProfiler::rdtsc();
+    headerWritten = false;
+    activeCapture = this;
+}
+
+PacketCapture::~PacketCapture()
+{
+    if (activeCapture == this)
+        activeCapture = nullptr;
+    MemoryManager::activeMM->free(storage);
+}
+
+PacketCapture::Slot *PacketCapture::reserve()
+{
+    if (slots == 0)
+        return nullptr;
+    uint32_t position = head;
+    while (true)
+    {
+        Slot *candidate = slot(position);
+        int32_t difference = (int32_t)(candidate->sequence - position);
+        if (difference == 0)
+        {
+            uint32_t seen = __sync_val_compare_and_swap(&head, position, position + 1);
+            if (seen == position)
+                return candidate;
+            position = seen;
+        }
+        else if (difference < 0)
+        {
+            // the drain task has not caught up with this slot
+            __sync_fetch_and_add(&drops, 1);
+            return nullptr;
+        }
+        else
+        {
+            // another producer took it
+            position = head;
+        }
+    }
+}
+
+void PacketCapture::commit(Slot *filled)
+{
+    // the record must be complete before the drain task may see it
+    __asm__ volatile("" : : : "memory");
+    filled->sequence = filled->sequence + 1;
+}
+
+void PacketCapture::record(const TxFragment *fragments, int count)
+{
+    Slot *empty = reserve();
+    if (empty == nullptr)
+        return;
+    empty->timestamp = IOProfiler::rdtsc();
+    empty->length = 0;
+    empty->captured = 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t size = fragments[i].size;
+        empty->length += size;
+        uint32_t room = snapLength - empty->captured;
+        if (size > room)
+            size = room;
+        for (uint32_t n = 0; n < size; n++)
+            empty->data[empty->captured + n] = fragments[i].data[n];
+        empty->captured += size;
+    }
+    commit(empty);
+}
+
+void PacketCapture::record(const uint8_t *frame, uint32_t size)
+{
+    TxFragment fragment = { (uint8_t*)frame, size };
+    record(&fragment, 1);
+}
+
+void PacketCapture::writeHeader()
+{
+    PcapFileHeader header;
+    header.magic = 0xa1b2c3d4;
+    header.versionMajor = 2;
+    header.versionMinor = 4;
+    header.timezone = 0;
+    header.sigfigs = 0;
+    header.snapLength = snapLength;
+    // LINKTYPE_ETHERNET
+    header.linkType = 1;
+    serial->write((const uint8_t*)&header, sizeof(header));
+    headerWritten = true;
+}
+
+int PacketCapture::drain()
+{
+    if (serial == nullptr || slots == 0)
+        return 0;
+    if (!headerWritten)
+        writeHeader();
+
+    TimerDriver *timer = TimerDriver::activeTimer;
+    uint64_t cyclesPerSecond = timer ? timer->getCyclesPerSecond() : 0;
+    int written = 0;
+    while (true)
+    {
+        Slot *filled = slot(tail);
+        if (filled->sequence != tail + 1)
+            break;
+        __asm__ volatile("" : : : "memory");
+
+        PcapRecordHeader header;
+        header.seconds = 0;
+        header.microseconds = 0;
+        if (cyclesPerSecond)
+        {
+            uint64_t elapsed = filled->timestamp - startTsc;
+            header.seconds = elapsed / cyclesPerSecond;
+            header.microseconds = elapsed % cyclesPerSecond * 1000000 / cyclesPerSecond;
+        }
+        header.captured = filled->captured;
+        header.length = filled->length;
+        serial->write((const uint8_t*)&header, sizeof(header));
+        serial->write(filled->data, filled->captured);
+
+        // hand the slot to the producers of the next lap
+        filled->sequence = tail + slots;
+        tail++;
+        written++;
+    }
+
+    uint32_t dropped = drops;
+    if (dropped != reportedDrops)
+    {
+        printf("capture: ");
+        printDec(dropped - reportedDrops);
+        printf(" frames dropped\n");
+        reportedDrops = dropped;
+    }
+    return written;
+}
+
+void PacketCapture::drainTask()
+{
+    while (1)
+    {
+        if (activeCapture == nullptr || activeCapture->drain() == 0)
+            __asm__ volatile("hlt");
+    }
+}
@@ -0,0 +1,186 @@
+#include "net/checksum.h"
+#ifndef ZOEOS_HOSTED
+#include "hardwareCommunication/interrupts.h"
+#endif
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::net;
+
+bool InternetChecksum::useSSE2 = false;
+
+void InternetChecksum::enableSSE2()
+{
+#ifdef ZOEOS_HOSTED
+    // every x86-64 has it and the OS saves the registers
+    useSSE2 = true;
+#else
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    // SSE2 and FXSAVE
+    if (!(edx & (1 << 26)) || !(edx & (1 << 24)))
+        return;
+
+    // no FPU emulation, WAIT honours TS
+    uint32_t cr0;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 = (cr0 & ~(1 << 2)) | (1 << 1);
+    __asm__ volatile("mov %0, %%cr0" : : "r"(cr0));
+    // OSFXSR and OSXMMEXCPT, without them SSE instructions fault
+    uint32_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= (1 << 9) | (1 << 10);
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4));
+    useSSE2 = true;
+#endif
+}
+
+uint32_t InternetChecksum::fold(uint64_t sum)
+{
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    uint32_t folded = sum;
+    folded = (folded & 0xffff) + (folded >> 16);
+    folded = (folded & 0xffff) + (folded >> 16);
+    return folded;
+}
+
+uint32_t InternetChecksum::combine(uint32_t sum, uint32_t piece, uint32_t offset)
+{
+    // at an odd offset the piece's bytes sit in the other halves of the words
+    if (offset & 1)
+        piece = ((piece & 0xff) << 8) | ((piece >> 8) & 0xff);
+    return fold((uint64_t)sum + piece);
+}
+
+uint32_t InternetChecksum::partial(const uint8_t *data, uint32_t size, uint32_t sum)
+{
+    if (useSSE2 && size >= ZOEOS_CHECKSUM_SSE2_MIN)
+        return partialSSE2(data, size, sum);
+    return partialScalar(data, size, sum);
+}
+
+uint32_t InternetChecksum::partialScalar(const uint8_t *data, uint32_t size, uint32_t sum)
+{
+    // the sum of the 32-bit words folds to the sum of their 16-bit halves,
+    // carries pile up in the upper half of the accumulator
+    uint64_t total = sum;
+    while (size >= 32)
+    {
+        const uint32_t *words = (const uint32_t*)data;
+        total += (uint64_t)words[0] + words[1] + words[2] + words[3];
+        total += (uint64_t)words[4] + words[5] + words[6] + words[7];
+        data += 32;
+        size -= 32;
+    }
+    while (size >= 4)
+    {
+        total += *(const uint32_t*)data;
+        data += 4;
+        size -= 4;
+    }
+    if (size >= 2)
+    {
+        total += *(const uint16_t*)data;
+        data += 2;
+        size -= 2;
+    }
+    if (size)
+        total += *data;
+    return fold(total);
+}
+
+// GCC spills the vectors with movaps and expects a 16-byte aligned stack,
+// which neither the boot stack nor the task stacks are, so realign on entry
+__attribute__((target("sse2"), force_align_arg_pointer))
+uint32_t InternetChecksum::partialSSE2(const uint8_t *data, uint32_t size, uint32_t sum)
+{
+    typedef uint32_t Vector __attribute__((vector_size(16)));
+    typedef uint32_t UnalignedVector __attribute__((vector_size(16), aligned(1)));
+    const Vector low = { 0xffff, 0xffff, 0xffff, 0xffff };
+
+    uint64_t total = sum;
+    {
+#ifndef ZOEOS_HOSTED
+        // task switches do not save the XMM registers
+        hardwareCommunication::InterruptGuard guard;
+#endif
+        while (size >= 64)
+        {
+            // lanes take four 16-bit words a round, 8192 rounds stay below 2^32
+            uint32_t rounds = size / 64 < 8192 ? size / 64 : 8192;
+            Vector lowHalves = { 0, 0, 0, 0 };
+            Vector highHalves = { 0, 0, 0, 0 };
+            for (uint32_t i = 0; i < rounds; i++)
+            {
+                Vector a = *(const UnalignedVector*)data;
+                Vector b = *(const UnalignedVector*)(data + 16);
+                Vector c = *(const UnalignedVector*)(data + 32);
+                Vector d = *(const UnalignedVector*)(data + 48);
+                lowHalves += (a & low) + (b & low) + (c & low) + (d & low);
+                highHalves += (a >> 16) + (b >> 16) + (c >> 16) + (d >> 16);
+                data += 64;
+            }
+            size -= rounds * 64;
+            for (int lane = 0; lane < 4; lane++)
+                total += (uint64_t)lowHalves[lane] + highHalves[lane];
+        }
+    }
+    return partialScalar(data, size, fold(total));
+}
+
+uint32_t InternetChecksum::copyPartial(uint8_t *dst, const uint8_t *src, uint32_t size, uint32_t sum)
+{
+    uint64_t total = sum;
+    while (size >= 16)
+    {
+        uint32_t a = ((const uint32_t*)src)[0];
+        uint32_t b = ((const uint32_t*)src)[1];
+        uint32_t c = ((const uint32_t*)src)[2];
+        uint32_t d = ((const uint32_t*)src)[3];
+        ((uint32_t*)dst)[0] = a;
+        ((uint32_t*)dst)[1] = b;
+        ((uint32_t*)dst)[2] = c;
+        ((uint32_t*)dst)[3] = d;
+        total += (uint64_t)a + b + c + d;
+        src += 16;
+        dst += 16;
+        size -= 16;
+    }
+    while (size >= 4)
+    {
+        uint32_t word = *(const uint32_t*)src;
+        *(uint32_t*)dst = word;
+        total += word;
+        src += 4;
+        dst += 4;
+        size -= 4;
+    }
+    if (size >= 2)
+    {
+        uint16_t half = *(const uint16_t*)src;
+        *(uint16_t*)dst = half;
+        total += half;
+        src += 2;
+        dst += 2;
+        size -= 2;
+    }
+    if (size)
+    {
+        *dst = *src;
+        total += *src;
+    }
+    return fold(total);
+}
+
+uint16_t InternetChecksum::adjust(uint16_t checksum, uint16_t oldValue, uint16_t newValue)
+{
+    // HC' = ~(~HC + ~m + m')
+    return finish((uint32_t)(uint16_t)~checksum + (uint16_t)~oldValue + newValue);
+}
+
+uint16_t InternetChecksum::adjust32(uint16_t checksum, uint32_t oldValue, uint32_t newValue)
+{
+    return finish((uint32_t)(uint16_t)~checksum + (uint16_t)~oldValue + (uint16_t)~(oldValue >> 16) +
+        (newValue & 0xffff) + (newValue >> 16));
+}
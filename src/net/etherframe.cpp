@@ -5,64 +5,178 @@ using namespace zoeos::common;
 using namespace zoeos::net;
 using namespace zoeos::drivers;
 
-EtherFrameWrapper::EtherFrameWrapper(drivers::AMD_AM79C973 *backend)
+void printf(const char *);
+
+// EtherTypes in network byte order, as a little-endian load of the frame sees them
+static const uint16_t ETHERTYPE_IPV4_BE = 0x0008;
+static const uint16_t ETHERTYPE_ARP_BE = 0x0608;
+static const uint16_t ETHERTYPE_IPV6_BE = 0xdd86;
+
+static const NetStatField etherFields[] =
+{
+    NETSTAT_FIELD(EtherFrameStatistics, rxFrames),
+    NETSTAT_FIELD(EtherFrameStatistics, txFrames),
+    NETSTAT_FIELD(EtherFrameStatistics, rxRunts),
+    NETSTAT_FIELD(EtherFrameStatistics, notForUs),
+    NETSTAT_FIELD(EtherFrameStatistics, unknownType)
+};
+
+EtherFrameWrapper::EtherFrameWrapper(drivers::NetDevice *backend)
     : RawDataWrapper(backend)
 {
-    for (uint32_t i = 0; i < 65536; i++)
-    {
-        handlers[i] = nullptr;
-    }
+    ipv4Handler = nullptr;
+    arpHandler = nullptr;
+    ipv6Handler = nullptr;
+    numOtherHandlers = 0;
+    stats = EtherFrameStatistics();
+    NetStatistics::add("ether", -1, &stats, etherFields, sizeof(etherFields) / sizeof(etherFields[0]));
 }
 
-EtherFrameWrapper::~EtherFrameWrapper() { }
+EtherFrameWrapper::~EtherFrameWrapper()
+{
+    NetStatistics::remove(&stats);
+}
 
-bool EtherFrameWrapper::onRawDataReceived(uint8_t *buffer, uint32_t size)
+bool EtherFrameWrapper::onRawDataReceived(NetDevice *device, uint8_t *buffer, uint32_t size)
 {
+    if (size < sizeof(EtherFrameHeader))
+    {
+        stats.rxRunts++;
+        return false;
+    }
+    stats.rxFrames++;
     EtherFrameHeader *frame = (EtherFrameHeader*)buffer;
     bool sendBack = false;
-    if ((frame->dstMAC_BE == 0xffffffffffff) || (frame->dstMAC_BE == backend->getMACAddr()))
+    if ((frame->dstMAC_BE == 0xffffffffffff) || (frame->dstMAC_BE == device->getMACAddr()))
     {
-        if (handlers[frame->etherType_BE] != 0)
+        EtherFrameHandler *handler = findHandler(frame->etherType_BE);
+        if (handler)
+        {
+            sendBack = handler->onEtherFrameReceived(buffer + sizeof(EtherFrameHeader), size - sizeof(EtherFrameHeader));
+        }
+        else
         {
-            sendBack = handlers[frame->etherType_BE]->onEtherFrameReceived(buffer + sizeof(EtherFrameHeader), size - sizeof(EtherFrameHeader));
+            stats.unknownType++;
         }
     }
+    else
+    {
+        stats.notForUs++;
+    }
 
     if (sendBack)
     {
         frame->dstMAC_BE = frame->srcMAC_BE;
-        frame->srcMAC_BE = backend->getMACAddr();
+        frame->srcMAC_BE = device->getMACAddr();
     }
     return sendBack;
 }
 
-void EtherFrameWrapper::send(uint64_t dstMAC, uint16_t etherType, common::uint8_t* buffer, common::uint32_t size)
+EtherFrameHandler *EtherFrameWrapper::findHandler(uint16_t etherType_BE) const
+{
+    if (etherType_BE == ETHERTYPE_IPV4_BE)
+        return ipv4Handler;
+    if (etherType_BE == ETHERTYPE_ARP_BE)
+        return arpHandler;
+    if (etherType_BE == ETHERTYPE_IPV6_BE)
+        return ipv6Handler;
+    for (int i = 0; i < numOtherHandlers; i++)
+    {
+        if (otherTypes[i] == etherType_BE)
+            return otherHandlers[i];
+    }
+    return nullptr;
+}
+
+bool EtherFrameWrapper::registerHandler(uint16_t etherType_BE, EtherFrameHandler *handler)
 {
-    uint8_t *frame = (uint8_t*)MemoryManager::activeMM->malloc(sizeof(EtherFrameHeader) + size);
-    EtherFrameHeader *frameHeader = (EtherFrameHeader*)frame;
-    frameHeader->dstMAC_BE = dstMAC;
-    frameHeader->srcMAC_BE = backend->getMACAddr();
-    frameHeader->etherType_BE = etherType;
-
-    uint8_t *src = buffer;
-    uint8_t *dst = frame + sizeof(EtherFrameHeader);
-    for (uint32_t i = 0; i < size; i++)
+    if (etherType_BE == ETHERTYPE_IPV4_BE)
+        ipv4Handler = handler;
+    else if (etherType_BE == ETHERTYPE_ARP_BE)
+        arpHandler = handler;
+    else if (etherType_BE == ETHERTYPE_IPV6_BE)
+        ipv6Handler = handler;
+    else
     {
-        dst[i] = src[i];
+        // a second handler for a type replaces the first, as before
+        for (int i = 0; i < numOtherHandlers; i++)
+        {
+            if (otherTypes[i] == etherType_BE)
+            {
+                otherHandlers[i] = handler;
+                return true;
+            }
+        }
+        if (numOtherHandlers >= maxHandlers)
+            return false;
+        otherTypes[numOtherHandlers] = etherType_BE;
+        otherHandlers[numOtherHandlers++] = handler;
+    }
+    return true;
+}
+
+void EtherFrameWrapper::unregisterHandler(uint16_t etherType_BE)
+{
+    if (etherType_BE == ETHERTYPE_IPV4_BE)
+        ipv4Handler = nullptr;
+    else if (etherType_BE == ETHERTYPE_ARP_BE)
+        arpHandler = nullptr;
+    else if (etherType_BE == ETHERTYPE_IPV6_BE)
+        ipv6Handler = nullptr;
+    for (int i = 0; i < numOtherHandlers; i++)
+    {
+        if (otherTypes[i] == etherType_BE)
+        {
+            otherTypes[i] = otherTypes[--numOtherHandlers];
+            otherHandlers[i] = otherHandlers[numOtherHandlers];
+            return;
+        }
     }
-    backend->send(frame, size + sizeof(EtherFrameHeader));
+}
+
+drivers::TxStatus EtherFrameWrapper::send(uint64_t dstMAC, uint16_t etherType, common::uint8_t* buffer, common::uint32_t size,
+        TxCompletion completion, void *cookie)
+{
+    TxFragment payload = { buffer, size };
+    return send(dstMAC, etherType, &payload, 1, completion, cookie);
+}
+
+drivers::TxStatus EtherFrameWrapper::send(uint64_t dstMAC, uint16_t etherType, const TxFragment *payload, int count,
+        TxCompletion completion, void *cookie)
+{
+    if (count < 0 || count >= NetDevice::maxFragments)
+        return TX_INVALID;
+    NetDevice *device = route(dstMAC);
+    if (device == nullptr)
+        return TX_DROPPED;
+
+    EtherFrameHeader frameHeader;
+    frameHeader.dstMAC_BE = dstMAC;
+    frameHeader.srcMAC_BE = device->getMACAddr();
+    frameHeader.etherType_BE = etherType;
+
+    TxFragment fragments[NetDevice::maxFragments];
+    fragments[0].data = (uint8_t*)&frameHeader;
+    fragments[0].size = sizeof(EtherFrameHeader);
+    for (int i = 0; i < count; i++)
+        fragments[i + 1] = payload[i];
+    stats.txFrames++;
+    return RawDataWrapper::send(device, fragments, count + 1, completion, cookie);
 }
 
 EtherFrameHandler::EtherFrameHandler(EtherFrameWrapper *etherFrameWrapper_, uint16_t etherType_)
 {
     etherType = ((etherType_ & 0x00ff) << 8) | ((etherType_ & 0xff00) >> 8);
     etherFrameWrapper = etherFrameWrapper_;
-    etherFrameWrapper->handlers[etherType] = this;
+    if (!etherFrameWrapper->registerHandler(etherType, this))
+        printf("EtherFrameWrapper: too many handlers\n");
 }
 
 EtherFrameHandler::~EtherFrameHandler()
 {
-    etherFrameWrapper->handlers[etherType] = nullptr;
+    // a handler that replaced this one keeps its registration
+    if (etherFrameWrapper->findHandler(etherType) == this)
+        etherFrameWrapper->unregisterHandler(etherType);
 }
 
 bool EtherFrameHandler::onEtherFrameReceived(uint8_t *payload, uint32_t size)
@@ -70,7 +184,8 @@ bool EtherFrameHandler::onEtherFrameReceived(uint8_t *payload, uint32_t size)
     return false;
 }
 
-void EtherFrameHandler::send(common::uint64_t dstMAC, common::uint8_t* etherframePayload, common::uint32_t size)
+drivers::TxStatus EtherFrameHandler::send(common::uint64_t dstMAC, common::uint8_t* etherframePayload, common::uint32_t size,
+        TxCompletion completion, void *cookie)
 {
-    etherFrameWrapper->send(dstMAC, etherType, etherframePayload, size);
+    return etherFrameWrapper->send(dstMAC, etherType, etherframePayload, size, completion, cookie);
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "net/icmp.h"
+#include "drivers/timer.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::net;
+
+static const uint8_t IP_PROTOCOL_ICMP = 1;
+
+static const uint8_t ICMP_ECHO_REPLY = 0;
+static const uint8_t ICMP_DESTINATION_UNREACHABLE = 3;
+static const uint8_t ICMP_SOURCE_QUENCH = 4;
+static const uint8_t ICMP_REDIRECT = 5;
+static const uint8_t ICMP_ECHO_REQUEST = 8;
+static const uint8_t ICMP_TIME_EXCEEDED = 11;
+static const uint8_t ICMP_PARAMETER_PROBLEM = 12;
+
+static inline bool isError(uint8_t type)
+{
+    return type == ICMP_DESTINATION_UNREACHABLE || type == ICMP_SOURCE_QUENCH || type == ICMP_REDIRECT ||
+        type == ICMP_TIME_EXCEEDED || type == ICMP_PARAMETER_PROBLEM;
+}
+
+static const NetStatField icmpFields[] =
+{
+    NETSTAT_FIELD(IcmpStatistics, echoRequests),
+    NETSTAT_FIELD(IcmpStatistics, echoReplies),
+    NETSTAT_FIELD(IcmpStatistics, errorsReceived),
+    NETSTAT_FIELD(IcmpStatistics, errorsSent),
+    NETSTAT_FIELD(IcmpStatistics, errorsSuppressed),
+    NETSTAT_FIELD(IcmpStatistics, malformed)
+};
+
+InternetControlMessageProtocol::InternetControlMessageProtocol(InternetProtocolProvider *backend)
+    : InternetProtocolHandler(backend, IP_PROTOCOL_ICMP)
+{
+    stats = IcmpStatistics();
+    NetStatistics::add("icmp", -1, &stats, icmpFields, sizeof(icmpFields) / sizeof(icmpFields[0]));
+    // a full bucket, allowError() trims it to errorBurst
+    errorCredit = errorBurst * 1000;
+    lastRefill = TimerDriver::activeTimer ? TimerDriver::activeTimer->getTicks() : 0;
+    backend->icmp = this;
+}
+
+InternetControlMessageProtocol::~InternetControlMessageProtocol()
+{
+    NetStatistics::remove(&stats);
+    if (backend->icmp == this)
+        backend->icmp = nullptr;
+}
+
+bool InternetControlMessageProtocol::onInternetProtocolReceived(uint32_t srcIP_BE, uint32_t dstIP_BE,
+        uint8_t *payload, uint32_t size)
+{
+    if (size < sizeof(InternetControlMessageProtocolMessage) || InternetChecksum::compute(payload, size) != 0)
+    {
+        stats.malformed++;
+        return false;
+    }
+    InternetControlMessageProtocolMessage *message = (InternetControlMessageProtocolMessage*)payload;
+
+    if (message->type == ICMP_ECHO_REQUEST)
+    {
+        stats.echoRequests++;
+        // like Linux, broadcast pings are ignored
+        if (dstIP_BE != backend->getIPAddress())
+            return false;
+        // only the type changes, the identifier, sequence and data are echoed as they are
+        uint16_t oldTypeAndCode = message->type | (message->code << 8);
+        message->type = ICMP_ECHO_REPLY;
+        message->checksum = InternetChecksum::adjust(message->checksum, oldTypeAndCode, message->code << 8);
+        stats.echoReplies++;
+        return true;
+    }
+    if (isError(message->type))
+        stats.errorsReceived++;
+    return false;
+}
+
+bool InternetControlMessageProtocol::allowError()
+{
+    TimerDriver *timer = TimerDriver::activeTimer;
+    uint64_t cost = (timer ? timer->getFrequency() : 1000) / errorsPerSecond;
+    uint64_t now = timer ? timer->getTicks() : lastRefill;
+    errorCredit += now - lastRefill;
+    lastRefill = now;
+    if (errorCredit > errorBurst * cost)
+        errorCredit = errorBurst * cost;
+    if (errorCredit < cost)
+        return false;
+    errorCredit -= cost;
+    return true;
+}
+
+void InternetControlMessageProtocol::sendDestinationUnreachable(uint8_t code, const InternetProtocolV4Message *original, uint32_t size)
+{
+    sendError(ICMP_DESTINATION_UNREACHABLE, code, original, size);
+}
+
+void InternetControlMessageProtocol::sendTimeExceeded(uint8_t code, const InternetProtocolV4Message *original, uint32_t size)
+{
+    sendError(ICMP_TIME_EXCEEDED, code, original, size);
+}
+
+void InternetControlMessageProtocol::sendError(uint8_t type, uint8_t code, const InternetProtocolV4Message *original, uint32_t size)
+{
+    // RFC 1122 3.2.2: never about errors, later fragments or senders without an address
+    uint32_t headerLength = original->headerLength * 4;
+    if (original->flagsAndOffset & 0xff1f)
+        return;
+    if (original->srcIP == 0 || original->srcIP == 0xffffffff)
+        return;
+    if (original->protocol == IP_PROTOCOL_ICMP && size > headerLength && isError(((const uint8_t*)original)[headerLength]))
+        return;
+    if (!allowError())
+    {
+        stats.errorsSuppressed++;
+        return;
+    }
+
+    // the header plus 8 bytes of the datagram, which hold the ports of UDP and TCP
+    uint8_t buffer[sizeof(InternetControlMessageProtocolMessage) + 60 + 8];
+    uint32_t quoted = size < headerLength + 8 ? size : headerLength + 8;
+    InternetControlMessageProtocolMessage *message = (InternetControlMessageProtocolMessage*)buffer;
+    message->type = type;
+    message->code = code;
+    message->checksum = 0;
+    message->data = 0;
+    for (uint32_t i = 0; i < quoted; i++)
+        buffer[sizeof(InternetControlMessageProtocolMessage) + i] = ((const uint8_t*)original)[i];
+    message->checksum = InternetChecksum::compute(buffer, sizeof(InternetControlMessageProtocolMessage) + quoted);
+
+    send(original->srcIP, buffer, sizeof(InternetControlMessageProtocolMessage) + quoted);
+    stats.errorsSent++;
+}
@@ -0,0 +1,507 @@
+#include "net/ipv4.h"
+#include "net/icmp.h"
+#include "drivers/timer.h"
+#include "hardwareCommunication/interrupts.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::hardwareCommunication;
+using namespace zoeos::net;
+
+void printf(const char *);
+
+static const uint16_t ETHERTYPE_IPV4 = 0x0800;
+static const uint16_t ETHERTYPE_IPV4_BE = 0x0008;
+static const uint32_t BROADCAST_IP = 0xffffffff;
+static const uint16_t IP_MORE_FRAGMENTS = 0x2000;
+static const uint16_t IP_OFFSET_MASK = 0x1fff;
+static const uint8_t IP_DEFAULT_TTL = 64;
+
+static inline uint16_t bigEndian16(uint16_t value)
+{
+    return (value << 8) | (value >> 8);
+}
+
+static inline uint32_t bigEndian32(uint32_t value)
+{
+    return (value << 24) | ((value & 0xff00) << 8) | ((value >> 8) & 0xff00) | (value >> 24);
+}
+
+static const NetStatField ipFields[] =
+{
+    NETSTAT_FIELD(IPv4Statistics, rxPackets),
+    NETSTAT_FIELD(IPv4Statistics, headerErrors),
+    NETSTAT_FIELD(IPv4Statistics, addressErrors),
+    NETSTAT_FIELD(IPv4Statistics, unknownProtocol),
+    NETSTAT_FIELD(IPv4Statistics, fragmentsReceived),
+    NETSTAT_FIELD(IPv4Statistics, reassembled),
+    NETSTAT_FIELD(IPv4Statistics, reassemblyFailures),
+    NETSTAT_FIELD(IPv4Statistics, txPackets),
+    NETSTAT_FIELD(IPv4Statistics, fragmentsCreated),
+    NETSTAT_FIELD(IPv4Statistics, noRoute)
+};
+
+static const NetStatField protocolFields[] =
+{
+    NETSTAT_FIELD(IPv4ProtocolStatistics, rxPackets),
+    NETSTAT_FIELD(IPv4ProtocolStatistics, rxBytes),
+    NETSTAT_FIELD(IPv4ProtocolStatistics, txPackets),
+    NETSTAT_FIELD(IPv4ProtocolStatistics, txBytes)
+};
+
+InternetProtocolProvider::InternetProtocolProvider(EtherFrameWrapper *etherFrameWrapper, AddressResolutionProtocol *arp,
+        uint32_t ipAddress_BE, uint32_t subnetMask_BE, uint32_t gatewayIP_BE)
+    : EtherFrameHandler(etherFrameWrapper, ETHERTYPE_IPV4)
+{
+    this->arp = arp;
+    icmp = nullptr;
+    ipAddress = ipAddress_BE;
+    subnetMask = subnetMask_BE;
+    nextIdentification = 0;
+    delivering = nullptr;
+    deliveringSize = 0;
+    stats = IPv4Statistics();
+    NetStatistics::add("ipv4", -1, &stats, ipFields, sizeof(ipFields) / sizeof(ipFields[0]));
+
+    // the smallest MTU, so any device can carry what we build
+    mtu = 1500;
+    for (int i = 0; i < etherFrameWrapper->getNumDevices(); i++)
+    {
+        if (etherFrameWrapper->getDevice(i)->getMTU() < mtu)
+            mtu = etherFrameWrapper->getDevice(i)->getMTU();
+    }
+
+    numRoutes = 0;
+    cachedDestination = 0;
+    cachedNextHop = 0;
+    uint8_t prefixLength = 0;
+    for (uint32_t mask = bigEndian32(subnetMask_BE); mask & 0x80000000; mask <<= 1)
+        prefixLength++;
+    addRoute(ipAddress_BE & subnetMask_BE, prefixLength, 0);
+    if (gatewayIP_BE)
+        addRoute(0, 0, gatewayIP_BE);
+
+    for (int i = 0; i < 256; i++)
+        protocolSlot[i] = 0;
+    for (int i = 0; i < maxProtocols; i++)
+        handlers[i] = nullptr;
+
+    reassemblies[0].data = new uint8_t[maxReassemblies * ZOEOS_IP_REASSEMBLY_SIZE];
+    for (int i = 0; i < maxReassemblies; i++)
+    {
+        reassemblies[i].data = reassemblies[0].data + i * ZOEOS_IP_REASSEMBLY_SIZE;
+        reassemblies[i].timeLeft = 0;
+    }
+    if (TimerDriver::activeTimer)
+        TimerDriver::activeTimer->addPeriodic(tick, this, TimerDriver::activeTimer->getFrequency());
+}
+
+InternetProtocolProvider::~InternetProtocolProvider()
+{
+    NetStatistics::remove(&stats);
+    for (int i = 0; i < maxProtocols; i++)
+        NetStatistics::remove(&protocolStats[i]);
+    if (TimerDriver::activeTimer)
+        TimerDriver::activeTimer->removePeriodic(tick, this);
+    delete[] reassemblies[0].data;
+}
+
+bool InternetProtocolProvider::addRoute(uint32_t network_BE, uint8_t prefixLength, uint32_t gatewayIP_BE)
+{
+    if (prefixLength > 32)
+        return false;
+    uint32_t mask = prefixLength ? bigEndian32(0xffffffff << (32 - prefixLength)) : 0;
+    removeRoute(network_BE, prefixLength);
+    if (numRoutes == maxRoutes)
+        return false;
+
+    int position = numRoutes;
+    while (position > 0 && routes[position - 1].prefixLength < prefixLength)
+    {
+        routes[position] = routes[position - 1];
+        position--;
+    }
+    routes[position].network = network_BE & mask;
+    routes[position].mask = mask;
+    routes[position].gateway = gatewayIP_BE;
+    routes[position].prefixLength = prefixLength;
+    numRoutes++;
+    cachedDestination = 0;
+    return true;
+}
+
+void InternetProtocolProvider::removeRoute(uint32_t network_BE, uint8_t prefixLength)
+{
+    for (int i = 0; i < numRoutes; i++)
+    {
+        if (routes[i].prefixLength != prefixLength || routes[i].network != (network_BE & routes[i].mask))
+            continue;
+        for (numRoutes--; i < numRoutes; i++)
+            routes[i] = routes[i + 1];
+        cachedDestination = 0;
+        return;
+    }
+}
+
+uint32_t InternetProtocolProvider::route(uint32_t dstIP_BE)
+{
+    if (dstIP_BE == cachedDestination)
+        return cachedNextHop;
+    for (int i = 0; i < numRoutes; i++)
+    {
+        if ((dstIP_BE & routes[i].mask) == routes[i].network)
+        {
+            cachedDestination = dstIP_BE;
+            cachedNextHop = routes[i].gateway ? routes[i].gateway : dstIP_BE;
+            return cachedNextHop;
+        }
+    }
+    return 0;
+}
+
+bool InternetProtocolProvider::registerHandler(uint8_t protocol, InternetProtocolHandler *handler)
+{
+    if (protocolSlot[protocol])
+    {
+        handlers[protocolSlot[protocol] - 1] = handler;
+        return true;
+    }
+    for (int i = 0; i < maxProtocols; i++)
+    {
+        if (handlers[i] == nullptr)
+        {
+            handlers[i] = handler;
+            protocolStats[i] = IPv4ProtocolStatistics();
+            protocolSlot[protocol] = i + 1;
+            // ipv4.proto6 and so on, by protocol number
+            NetStatistics::add("ipv4.proto", protocol, &protocolStats[i], protocolFields,
+                    sizeof(protocolFields) / sizeof(protocolFields[0]));
+            return true;
+        }
+    }
+    return false;
+}
+
+void InternetProtocolProvider::unregisterHandler(uint8_t protocol)
+{
+    if (protocolSlot[protocol])
+    {
+        handlers[protocolSlot[protocol] - 1] = nullptr;
+        NetStatistics::remove(&protocolStats[protocolSlot[protocol] - 1]);
+        protocolSlot[protocol] = 0;
+    }
+}
+
+NetBuffer *InternetProtocolProvider::claimReceiveBuffer()
+{
+    return delivering ? etherFrameWrapper->claimReceiveBuffer() : nullptr;
+}
+
+void InternetProtocolProvider::reportUnreachable(uint8_t code)
+{
+    // nothing is said about broadcasts
+    if (delivering && icmp && delivering->dstIP == ipAddress)
+        icmp->sendDestinationUnreachable(code, delivering, deliveringSize);
+}
+
+const IPv4ProtocolStatistics *InternetProtocolProvider::getProtocolStatistics(uint8_t protocol) const
+{
+    return protocolSlot[protocol] ? &protocolStats[protocolSlot[protocol] - 1] : nullptr;
+}
+
+bool InternetProtocolProvider::onEtherFrameReceived(uint8_t *etherframePayload, uint32_t size)
+{
+    stats.rxPackets++;
+    if (size < sizeof(InternetProtocolV4Message))
+    {
+        stats.headerErrors++;
+        return false;
+    }
+    InternetProtocolV4Message *ip = (InternetProtocolV4Message*)etherframePayload;
+    uint32_t headerLength = ip->headerLength * 4;
+    uint32_t totalLength = bigEndian16(ip->totalLength);
+    // Ethernet pads short frames, so size may exceed totalLength
+    if (ip->version != 4 || headerLength < sizeof(InternetProtocolV4Message) || totalLength < headerLength ||
+        totalLength > size || InternetChecksum::compute(etherframePayload, headerLength) != 0)
+    {
+        stats.headerErrors++;
+        return false;
+    }
+    // no forwarding
+    if (ip->dstIP != ipAddress && ip->dstIP != BROADCAST_IP && ip->dstIP != (ipAddress | ~subnetMask))
+    {
+        stats.addressErrors++;
+        return false;
+    }
+
+    uint8_t *payload = etherframePayload + headerLength;
+    uint32_t payloadSize = totalLength - headerLength;
+    if (ip->flagsAndOffset & bigEndian16(IP_MORE_FRAGMENTS | IP_OFFSET_MASK))
+    {
+        reassemble(ip, payload, payloadSize);
+        return false;
+    }
+
+    delivering = ip;
+    deliveringSize = totalLength;
+    bool sendBack = deliver(ip->protocol, ip->srcIP, ip->dstIP, payload, payloadSize);
+    delivering = nullptr;
+    if (!sendBack)
+        return false;
+
+    // The reply reuses the receive buffer. Swapping the addresses keeps the
+    // checksum, so it only follows the TTL and, for broadcasts, our address.
+    uint32_t srcIP = ip->dstIP;
+    ip->dstIP = ip->srcIP;
+    ip->srcIP = ipAddress;
+    uint16_t *ttlAndProtocol = (uint16_t*)&ip->timeToLive;
+    uint16_t oldTTLAndProtocol = *ttlAndProtocol;
+    ip->timeToLive = IP_DEFAULT_TTL;
+    uint16_t sum = InternetChecksum::adjust(ip->checksum, oldTTLAndProtocol, *ttlAndProtocol);
+    if (srcIP != ipAddress)
+        sum = InternetChecksum::adjust32(sum, srcIP, ipAddress);
+    ip->checksum = sum;
+    stats.txPackets++;
+    return true;
+}
+
+bool InternetProtocolProvider::deliver(uint8_t protocol, uint32_t srcIP_BE, uint32_t dstIP_BE, uint8_t *payload, uint32_t size)
+{
+    uint8_t slot = protocolSlot[protocol];
+    if (slot == 0)
+    {
+        stats.unknownProtocol++;
+        reportUnreachable(ICMP_PROTOCOL_UNREACHABLE);
+        return false;
+    }
+    IPv4ProtocolStatistics *counters = &protocolStats[slot - 1];
+    counters->rxPackets++;
+    counters->rxBytes += size;
+    if (!handlers[slot - 1]->onInternetProtocolReceived(srcIP_BE, dstIP_BE, payload, size))
+        return false;
+    counters->txPackets++;
+    counters->txBytes += size;
+    return true;
+}
+
+void InternetProtocolProvider::reassemble(InternetProtocolV4Message *ip, uint8_t *payload, uint32_t size)
+{
+    stats.fragmentsReceived++;
+    uint16_t flagsAndOffset = bigEndian16(ip->flagsAndOffset);
+    uint32_t offset = (flagsAndOffset & IP_OFFSET_MASK) * 8;
+    bool last = !(flagsAndOffset & IP_MORE_FRAGMENTS);
+
+    Reassembly *reassembly = nullptr;
+    Reassembly *victim = nullptr;
+    for (int i = 0; i < maxReassemblies; i++)
+    {
+        Reassembly *candidate = &reassemblies[i];
+        if (candidate->timeLeft && candidate->srcIP == ip->srcIP && candidate->dstIP == ip->dstIP &&
+            candidate->identification == ip->identification && candidate->protocol == ip->protocol)
+        {
+            reassembly = candidate;
+            break;
+        }
+        if (victim == nullptr || candidate->timeLeft < victim->timeLeft)
+            victim = candidate;
+    }
+
+    // all but the last fragment carry whole 8-byte blocks
+    if ((!last && (size & 7)) || offset + size > ZOEOS_IP_REASSEMBLY_SIZE)
+    {
+        if (reassembly)
+            reassembly->timeLeft = 0;
+        stats.reassemblyFailures++;
+        return;
+    }
+
+    if (reassembly == nullptr)
+    {
+        // the oldest datagram makes room
+        reassembly = victim;
+        if (reassembly->timeLeft)
+            stats.reassemblyFailures++;
+        reassembly->srcIP = ip->srcIP;
+        reassembly->dstIP = ip->dstIP;
+        reassembly->identification = ip->identification;
+        reassembly->protocol = ip->protocol;
+        reassembly->timeLeft = reassemblyTimeout;
+        reassembly->totalLength = 0;
+        for (uint32_t i = 0; i < sizeof(reassembly->blocks) / sizeof(uint32_t); i++)
+            reassembly->blocks[i] = 0;
+    }
+
+    for (uint32_t i = 0; i < size; i++)
+        reassembly->data[offset + i] = payload[i];
+    for (uint32_t block = offset / 8; block < (offset + size + 7) / 8; block++)
+        reassembly->blocks[block / 32] |= 1u << (block % 32);
+    if (last)
+        reassembly->totalLength = offset + size;
+    if (reassembly->totalLength == 0)
+        return;
+
+    uint32_t numBlocks = (reassembly->totalLength + 7) / 8;
+    for (uint32_t block = 0; block < numBlocks; block++)
+    {
+        if (!(reassembly->blocks[block / 32] & (1u << (block % 32))))
+            return;
+    }
+
+    stats.reassembled++;
+    reassembly->timeLeft = 0;
+    if (deliver(reassembly->protocol, reassembly->srcIP, reassembly->dstIP, reassembly->data, reassembly->totalLength))
+    {
+        // too large to answer in place, it goes out fragmented again
+        TxFragment reply = { reassembly->data, reassembly->totalLength };
+        send(reassembly->srcIP, reassembly->protocol, &reply, 1);
+    }
+}
+
+void InternetProtocolProvider::tick(void *cookie)
+{
+    InternetProtocolProvider *ip = (InternetProtocolProvider*)cookie;
+    InterruptGuard guard;
+    for (int i = 0; i < maxReassemblies; i++)
+    {
+        if (ip->reassemblies[i].timeLeft && --ip->reassemblies[i].timeLeft == 0)
+            ip->stats.reassemblyFailures++;
+    }
+}
+
+void InternetProtocolProvider::fillHeader(InternetProtocolV4Message *ip, uint32_t dstIP_BE, uint8_t protocol,
+        uint16_t totalLength, uint16_t flagsAndOffset)
+{
+    ip->version = 4;
+    ip->headerLength = sizeof(InternetProtocolV4Message) / 4;
+    ip->typeOfService = 0;
+    ip->totalLength = bigEndian16(totalLength);
+    ip->identification = bigEndian16(nextIdentification);
+    ip->flagsAndOffset = bigEndian16(flagsAndOffset);
+    ip->timeToLive = IP_DEFAULT_TTL;
+    ip->protocol = protocol;
+    ip->srcIP = ipAddress;
+    ip->dstIP = dstIP_BE;
+    ip->checksum = 0;
+    ip->checksum = InternetChecksum::compute((uint8_t*)ip, sizeof(InternetProtocolV4Message));
+}
+
+TxStatus InternetProtocolProvider::transmit(uint32_t dstIP_BE, const TxFragment *fragments, int count,
+        TxCompletion completion, void *cookie)
+{
+    stats.txPackets++;
+    if (dstIP_BE == BROADCAST_IP || dstIP_BE == (ipAddress | ~subnetMask))
+        return etherFrameWrapper->send(0xffffffffffff, ETHERTYPE_IPV4_BE, fragments, count, completion, cookie);
+
+    uint32_t nextHop = route(dstIP_BE);
+    if (nextHop == 0)
+    {
+        stats.noRoute++;
+        return TX_DROPPED;
+    }
+    return arp->sendIPv4(nextHop, fragments, count, completion, cookie);
+}
+
+TxStatus InternetProtocolProvider::send(uint32_t dstIP_BE, uint8_t protocol, const TxFragment *payload, int count,
+        TxCompletion completion, void *cookie)
+{
+    // the IP and the Ethernet header take a fragment each
+    if (count < 0 || count > NetDevice::maxFragments - 2)
+        return TX_INVALID;
+    uint32_t size = 0;
+    for (int i = 0; i < count; i++)
+        size += payload[i].size;
+    if (size > 0xffff - sizeof(InternetProtocolV4Message))
+        return TX_INVALID;
+
+    // tasks and kernelMain's flow both send: nextIdentification, the route
+    // cache and ARP's queues are updated as one step
+    InterruptGuard guard;
+    uint8_t slot = protocolSlot[protocol];
+    if (slot)
+    {
+        protocolStats[slot - 1].txPackets++;
+        protocolStats[slot - 1].txBytes += size;
+    }
+
+    InternetProtocolV4Message header;
+    TxFragment fragments[NetDevice::maxFragments];
+    fragments[0].data = (uint8_t*)&header;
+    fragments[0].size = sizeof(InternetProtocolV4Message);
+
+    if (size + sizeof(InternetProtocolV4Message) <= mtu)
+    {
+        fillHeader(&header, dstIP_BE, protocol, size + sizeof(InternetProtocolV4Message), 0);
+        nextIdentification++;
+        for (int i = 0; i < count; i++)
+            fragments[i + 1] = payload[i];
+        return transmit(dstIP_BE, fragments, count + 1, completion, cookie);
+    }
+
+    // Cut the payload into 8-byte aligned pieces. Each piece borrows the
+    // caller's fragments that overlap it and is copied by the layers below.
+    uint32_t maxPiece = (mtu - sizeof(InternetProtocolV4Message)) & ~7;
+    TxStatus status = TX_SENT;
+    int fragment = 0;
+    uint32_t fragmentOffset = 0;
+    for (uint32_t offset = 0; offset < size && (status == TX_SENT || status == TX_QUEUED); offset += maxPiece)
+    {
+        uint32_t pieceSize = size - offset < maxPiece ? size - offset : maxPiece;
+        uint16_t flags = offset + pieceSize < size ? IP_MORE_FRAGMENTS : 0;
+        fillHeader(&header, dstIP_BE, protocol, pieceSize + sizeof(InternetProtocolV4Message), flags | (offset / 8));
+
+        int numFragments = 1;
+        for (uint32_t remaining = pieceSize; remaining > 0; numFragments++)
+        {
+            uint32_t available = payload[fragment].size - fragmentOffset;
+            uint32_t take = available < remaining ? available : remaining;
+            fragments[numFragments].data = payload[fragment].data + fragmentOffset;
+            fragments[numFragments].size = take;
+            remaining -= take;
+            fragmentOffset += take;
+            if (fragmentOffset == payload[fragment].size)
+            {
+                fragment++;
+                fragmentOffset = 0;
+            }
+        }
+        status = transmit(dstIP_BE, fragments, numFragments, nullptr, nullptr);
+        stats.fragmentsCreated++;
+    }
+    nextIdentification++;
+    if (completion)
+        completion(cookie);
+    return status;
+}
+
+InternetProtocolHandler::InternetProtocolHandler(InternetProtocolProvider *backend_, uint8_t protocol_)
+{
+    backend = backend_;
+    protocol = protocol_;
+    if (!backend->registerHandler(protocol, this))
+        printf("InternetProtocolProvider: too many handlers\n");
+}
+
+InternetProtocolHandler::~InternetProtocolHandler()
+{
+    if (backend->protocolSlot[protocol] && backend->handlers[backend->protocolSlot[protocol] - 1] == this)
+        backend->unregisterHandler(protocol);
+}
+
+bool InternetProtocolHandler::onInternetProtocolReceived(uint32_t srcIP_BE, uint32_t dstIP_BE, uint8_t *payload, uint32_t size)
+{
+    return false;
+}
+
+TxStatus InternetProtocolHandler::send(uint32_t dstIP_BE, uint8_t *payload, uint32_t size,
+        TxCompletion completion, void *cookie)
+{
+    TxFragment fragment = { payload, size };
+    return backend->send(dstIP_BE, protocol, &fragment, 1, completion, cookie);
+}
+
+TxStatus InternetProtocolHandler::send(uint32_t dstIP_BE, const TxFragment *payload, int count,
+        TxCompletion completion, void *cookie)
+{
+    return backend->send(dstIP_BE, protocol, payload, count, completion, cookie);
+}
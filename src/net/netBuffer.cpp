@@ -0,0 +1,71 @@
+#include "net/netBuffer.h"
+#include "hardwareCommunication/interrupts.h"
+#include "memoryManager.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::net;
+using namespace zoeos::hardwareCommunication;
+
+void NetBuffer::release()
+{
+    pool->free(this);
+}
+
+NetBufferPool::NetBufferPool(uint32_t count_, uint32_t bufferSize_)
+{
+    // keep buffers 16-byte aligned for DMA
+    bufferSize = (bufferSize_ + 15) & ~15;
+    buffers = (NetBuffer*)MemoryManager::activeMM->malloc(count_ * sizeof(NetBuffer));
+    storage = MemoryManager::activeMM->malloc(count_ * bufferSize + 15);
+    freeList = nullptr;
+    count = 0;
+    numFree = 0;
+    if (buffers == nullptr || storage == nullptr)
+        return;
+
+    uint32_t aligned = ((uint32_t)storage + 15) & ~15;
+    count = count_;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        buffers[i].head = (uint8_t*)(aligned + i * bufferSize);
+        buffers[i].data = buffers[i].head;
+        buffers[i].size = 0;
+        buffers[i].checksum = CHECKSUM_NONE;
+        buffers[i].pool = this;
+        buffers[i].next = freeList;
+        freeList = &buffers[i];
+    }
+    numFree = count;
+}
+
+// every buffer must have been released
+NetBufferPool::~NetBufferPool()
+{
+    MemoryManager::activeMM->free(buffers);
+    MemoryManager::activeMM->free(storage);
+}
+
+NetBuffer *NetBufferPool::alloc()
+{
+    InterruptGuard guard;
+    NetBuffer *buffer = freeList;
+    if (buffer)
+    {
+        freeList = buffer->next;
+        buffer->next = nullptr;
+        buffer->data = buffer->head;
+        buffer->size = 0;
+        buffer->checksum = CHECKSUM_NONE;
+        numFree--;
+    }
+    return buffer;
+}
+
+void NetBufferPool::free(NetBuffer *buffer)
+{
+    InterruptGuard guard;
+    buffer->next = freeList;
+    freeList = buffer;
+    numFree++;
+}
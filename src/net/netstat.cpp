@@ -0,0 +1,144 @@
+#include "net/netstat.h"
+#include "drivers/serial.h"
+#include "drivers/console.h"
+#include "net/capture.h"
+#include "hardwareCommunication/interrupts.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::hardwareCommunication;
+using namespace zoeos::net;
+
+NetStatistics::Group NetStatistics::groups[NetStatistics::maxGroups];
+int NetStatistics::numGroups = 0;
+volatile int NetStatistics::pendingDump = 0;
+
+// where the dump in progress goes: COM1, or the console while a capture owns COM1
+static SerialPort *dumpSerial = nullptr;
+static Console *dumpConsole = nullptr;
+
+static void write(const char *text)
+{
+    if (dumpSerial)
+        dumpSerial->write(text);
+    else
+        dumpConsole->write(text);
+}
+
+static void writeDecimal(uint64_t value)
+{
+    char digits[21];
+    int length = 0;
+    do
+    {
+        digits[length++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    digits[length] = 0;
+    // reverse in place
+    for (int i = 0; i < length / 2; i++)
+    {
+        char c = digits[i];
+        digits[i] = digits[length - 1 - i];
+        digits[length - 1 - i] = c;
+    }
+    write(digits);
+}
+
+static void writeName(const char *name, int index)
+{
+    write(name);
+    if (index >= 0)
+        writeDecimal(index);
+}
+
+bool NetStatistics::add(const char *name, int index, const void *counters, const NetStatField *fields, int numFields)
+{
+    InterruptGuard guard;
+    if (numGroups == maxGroups)
+        return false;
+    Group *group = &groups[numGroups++];
+    group->name = name;
+    group->index = index;
+    group->counters = counters;
+    group->fields = fields;
+    group->numFields = numFields;
+    return true;
+}
+
+void NetStatistics::remove(const void *counters)
+{
+    InterruptGuard guard;
+    for (int i = 0; i < numGroups; i++)
+    {
+        if (groups[i].counters == counters)
+        {
+            // keep the order they were added in
+            for (int j = i; j < numGroups - 1; j++)
+                groups[j] = groups[j + 1];
+            numGroups--;
+            return;
+        }
+    }
+}
+
+void NetStatistics::dump(Format format)
+{
+    // the pcap stream the capture drain task writes to COM1 must not get text in it
+    dumpSerial = SerialPort::activeSerial;
+    if (PacketCapture::activeCapture && PacketCapture::activeCapture->getSerial() == dumpSerial)
+        dumpSerial = nullptr;
+    dumpConsole = Console::activeConsole;
+    if (dumpSerial == nullptr && dumpConsole == nullptr)
+        return;
+    if (format == KEY_VALUE)
+        write("netstat.begin\n");
+    for (int i = 0; i < numGroups; i++)
+    {
+        Group *group = &groups[i];
+        if (format == TEXT)
+        {
+            writeName(group->name, group->index);
+            write(":\n");
+        }
+        for (int j = 0; j < group->numFields; j++)
+        {
+            const NetStatField *field = &group->fields[j];
+            const uint8_t *counter = (const uint8_t*)group->counters + field->offset;
+            // a torn 64-bit read is only off by a carry, good enough for a dump
+            uint64_t value = field->size == 8 ? *(const uint64_t*)counter : *(const uint32_t*)counter;
+            if (format == TEXT)
+            {
+                write("    ");
+                write(field->name);
+                write(" ");
+            }
+            else
+            {
+                writeName(group->name, group->index);
+                write(".");
+                write(field->name);
+                write("=");
+            }
+            writeDecimal(value);
+            write("\n");
+        }
+    }
+    if (format == KEY_VALUE)
+        write("netstat.end\n");
+}
+
+void NetStatistics::requestDump(Format format)
+{
+    pendingDump = format + 1;
+}
+
+void NetStatistics::poll()
+{
+    int pending = pendingDump;
+    if (pending == 0)
+        return;
+    pendingDump = 0;
+    dump((Format)(pending - 1));
+}
@@ -0,0 +1,183 @@
+#include "net/pktgen.h"
+#include "drivers/timer.h"
+#include "hardwareCommunication/ioProfiler.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::hardwareCommunication;
+using namespace zoeos::net;
+
+void printf(const char *);
+void printDec(uint64_t);
+
+PacketGenerator *PacketGenerator::activeGenerator = nullptr;
+
+// frames and bytes over elapsed ticks as pps and Mbit/s
+static void printRate(uint64_t frames, uint64_t bytes, uint64_t elapsedTicks, uint32_t frequency)
+{
+    if (elapsedTicks == 0)
+        elapsedTicks = 1;
+    printDec(frames * frequency / elapsedTicks);
+    printf(" pps, ");
+    printDec(bytes * 8 * frequency / elapsedTicks / 1000000);
+    printf(" Mbit/s");
+}
+
+PacketGenerator::PacketGenerator(EtherFrameWrapper *etherFrameWrapper_, uint64_t dstMAC_,
+        uint32_t frameSize_, uint32_t rate_, uint32_t count_)
+{
+    etherFrameWrapper = etherFrameWrapper_;
+    dstMAC = dstMAC_;
+    if (frameSize_ < 60)
+        frameSize_ = 60;
+    if (frameSize_ > 1514)
+        frameSize_ = 1514;
+    frameSize = frameSize_;
+    rate = rate_;
+    count = count_;
+    for (uint32_t i = 0; i < sizeof(payload); i++)
+        payload[i] = i;
+    activeGenerator = this;
+}
+
+PacketGenerator::~PacketGenerator()
+{
+    if (activeGenerator == this)
+        activeGenerator = nullptr;
+}
+
+void PacketGenerator::taskEntry()
+{
+    if (activeGenerator)
+        activeGenerator->run();
+    while (1)
+        __asm__ volatile("hlt");
+}
+
+void PacketGenerator::run()
+{
+    TimerDriver *timer = TimerDriver::activeTimer;
+    if (timer == nullptr)
+    {
+        printf("pktgen: no timer\n");
+        return;
+    }
+    // a few ticks give the TSC rate and let the NIC finish its initialisation
+    timer->wait(10);
+    uint64_t cyclesPerFrame = rate ? timer->getCyclesPerSecond() / rate : 0;
+    uint16_t etherType = (PKTGEN_ETHER_TYPE >> 8) | ((PKTGEN_ETHER_TYPE & 0xff) << 8);
+    uint32_t payloadSize = frameSize - sizeof(EtherFrameHeader);
+
+    uint32_t sequence = 0;
+    uint64_t sent = 0, bytes = 0, refused = 0;
+    uint64_t reportSent = 0, reportBytes = 0, reportRefused = 0;
+    uint64_t start = timer->getTicks();
+    uint64_t reportTick = start;
+    uint64_t next = IOProfiler::rdtsc();
+
+    while (count == 0 || sent < count)
+    {
+        if (cyclesPerFrame)
+        {
+            while (IOProfiler::rdtsc() < next);
+            next += cyclesPerFrame;
+        }
+
+        // the receiver spots losses from gaps in the sequence
+        *(uint32_t*)payload = sequence;
+        TxStatus status = etherFrameWrapper->send(dstMAC, etherType, payload, payloadSize);
+        if (status == TX_SENT || status == TX_QUEUED)
+        {
+            sequence++;
+            sent++;
+            bytes += frameSize;
+        }
+        else
+        {
+            // the NIC pushed back, the same sequence number goes out next time
+            refused++;
+        }
+
+        uint64_t now = timer->getTicks();
+        if (now - reportTick >= timer->getFrequency())
+        {
+            printf("pktgen: ");
+            printRate(sent - reportSent, bytes - reportBytes, now - reportTick, timer->getFrequency());
+            printf(", refused ");
+            printDec(refused - reportRefused);
+            printf("\n");
+            reportSent = sent;
+            reportBytes = bytes;
+            reportRefused = refused;
+            reportTick = now;
+        }
+    }
+
+    printf("pktgen done: ");
+    printDec(sent);
+    printf(" frames, ");
+    printRate(sent, bytes, timer->getTicks() - start, timer->getFrequency());
+    printf("\n");
+}
+
+PacketSink::PacketSink(EtherFrameWrapper *etherFrameWrapper)
+    : EtherFrameHandler(etherFrameWrapper, PKTGEN_ETHER_TYPE)
+{
+    wrapper = etherFrameWrapper;
+    frames = 0;
+    bytes = 0;
+    lost = 0;
+    expected = 0;
+    lastReportTick = 0;
+    lastReportFrames = 0;
+    lastReportBytes = 0;
+    lastReportLost = 0;
+    lastDeviceDrops = 0;
+}
+
+PacketSink::~PacketSink() { }
+
+bool PacketSink::onEtherFrameReceived(uint8_t *payload, uint32_t size)
+{
+    if (size < 4)
+        return false;
+    uint32_t sequence = *(uint32_t*)payload;
+    // a sequence behind the expected one is a restarted generator or a reordered frame
+    if (frames && sequence > expected)
+        lost += sequence - expected;
+    expected = sequence + 1;
+    frames++;
+    bytes += size + sizeof(EtherFrameHeader);
+
+    TimerDriver *timer = TimerDriver::activeTimer;
+    if (timer && timer->getTicks() - lastReportTick >= timer->getFrequency())
+        report();
+    return false;
+}
+
+void PacketSink::report()
+{
+    TimerDriver *timer = TimerDriver::activeTimer;
+    uint64_t now = timer->getTicks();
+    uint64_t deviceDrops = 0;
+    for (int i = 0; i < wrapper->getNumDevices(); i++)
+        deviceDrops += wrapper->getDevice(i)->getStatistics().rxDropped;
+
+    // the first report only starts the interval
+    if (lastReportTick)
+    {
+        printf("sink: ");
+        printRate(frames - lastReportFrames, bytes - lastReportBytes, now - lastReportTick, timer->getFrequency());
+        printf(", lost ");
+        printDec(lost - lastReportLost);
+        printf(", NIC drops ");
+        printDec(deviceDrops - lastDeviceDrops);
+        printf("\n");
+    }
+    lastReportTick = now;
+    lastReportFrames = frames;
+    lastReportBytes = bytes;
+    lastReportLost = lost;
+    lastDeviceDrops = deviceDrops;
+}
@@ -0,0 +1,1436 @@
+#include "net/tcp.h"
+#include "drivers/timer.h"
+#include "hardwareCommunication/interrupts.h"
+#include "hardwareCommunication/ioProfiler.h"
+#include "multitask.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::hardwareCommunication;
+using namespace zoeos::net;
+
+static const uint8_t IP_PROTOCOL_TCP = 6;
+static const uint16_t EPHEMERAL_PORT_FIRST = 49152;
+
+static const uint8_t TCP_FIN = 0x01;
+static const uint8_t TCP_SYN = 0x02;
+static const uint8_t TCP_RST = 0x04;
+static const uint8_t TCP_PSH = 0x08;
+static const uint8_t TCP_ACK = 0x10;
+
+static const uint8_t TCP_OPTION_END = 0;
+static const uint8_t TCP_OPTION_NOP = 1;
+static const uint8_t TCP_OPTION_MSS = 2;
+static const uint8_t TCP_OPTION_WINDOW_SCALE = 3;
+static const uint8_t TCP_OPTION_SACK_PERMITTED = 4;
+static const uint8_t TCP_OPTION_SACK = 5;
+
+static inline uint16_t bigEndian16(uint16_t value)
+{
+    return (value << 8) | (value >> 8);
+}
+
+static inline uint32_t bigEndian32(uint32_t value)
+{
+    return (value << 24) | ((value & 0xff00) << 8) | ((value >> 8) & 0xff00) | (value >> 24);
+}
+
+// sequence numbers wrap, compare them by distance
+static inline bool seqLess(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static inline bool seqLessEqual(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) <= 0;
+}
+
+static inline uint32_t min32(uint32_t a, uint32_t b)
+{
+    return a < b ? a : b;
+}
+
+static inline uint32_t max32(uint32_t a, uint32_t b)
+{
+    return a > b ? a : b;
+}
+
+static uint32_t pseudoHeaderSum(uint32_t srcIP_BE, uint32_t dstIP_BE, uint32_t length)
+{
+    uint32_t sum = (srcIP_BE & 0xffff) + (srcIP_BE >> 16) + (dstIP_BE & 0xffff) + (dstIP_BE >> 16);
+    return sum + bigEndian16(IP_PROTOCOL_TCP) + bigEndian16(length);
+}
+
+static void releaseBuffer(void *buffer)
+{
+    ((NetBuffer*)buffer)->release();
+}
+
+// tasks sleeping on the socket and pollers watching it
+static void wake(TransmissionControlProtocolSocket *socket)
+{
+    if (TaskManager::activeTaskManager)
+        TaskManager::activeTaskManager->wakeUp(socket);
+    socket->notify(socket->pollEvents());
+}
+
+static bool sleep(const void *channel)
+{
+    return TaskManager::activeTaskManager && TaskManager::activeTaskManager->sleep(channel);
+}
+
+TransmissionControlProtocolSocket::TransmissionControlProtocolSocket(TransmissionControlProtocolProvider *backend)
+{
+    this->backend = backend;
+    state = TCP_CLOSED;
+    localIP = 0;
+    remoteIP = 0;
+    localPort_BE = 0;
+    remotePort_BE = 0;
+
+    iss = 0;
+    sndUna = 0;
+    sndNxt = 0;
+    sndMax = 0;
+    sndEnd = 1;
+    sndWnd = 0;
+    sndWl1 = 0;
+    sndWl2 = 0;
+    finQueued = false;
+    sendBuffer = nullptr;
+
+    irs = 0;
+    rcvNxt = 0;
+    readSeq = 0;
+    rcvAdvertised = 0;
+    finReceived = false;
+    receiveBuffer = nullptr;
+    numOutOfOrder = 0;
+
+    mss = 536;
+    sndWscale = 0;
+    rcvWscale = 0;
+    sackPermitted = false;
+    numSacked = 0;
+    highRetransmitted = 0;
+
+    cwnd = 0;
+    ssthresh = 0xffffffff;
+    recover = 0;
+    dupAcks = 0;
+    inRecovery = false;
+
+    srtt = 0;
+    rttvar = 0;
+    rto = TransmissionControlProtocolProvider::initialRTO;
+    rttTiming = false;
+    rttSeq = 0;
+    rttStart = 0;
+    retries = 0;
+
+    retransmitAt = 0;
+    delayedAckAt = 0;
+    timeWaitAt = 0;
+    unackedSegments = 0;
+    ackNow = false;
+    noDelay = false;
+
+    acceptHead = 0;
+    acceptCount = 0;
+    numEmbryonic = 0;
+    listener = nullptr;
+
+    closedByApplication = false;
+    reset = false;
+    next = nullptr;
+}
+
+TransmissionControlProtocolSocket::~TransmissionControlProtocolSocket()
+{
+    delete[] sendBuffer;
+    delete[] receiveBuffer;
+}
+
+uint32_t TransmissionControlProtocolSocket::receiveWindow() const
+{
+    // the right edge only moves as the application reads, it never shrinks
+    return readSeq + ZOEOS_TCP_BUFFER_SIZE - rcvNxt;
+}
+
+int TransmissionControlProtocolSocket::send(const uint8_t *data, uint32_t size, bool block)
+{
+    InterruptGuard guard;
+    uint32_t queued = 0;
+    while (queued < size)
+    {
+        if ((state != TCP_ESTABLISHED && state != TCP_CLOSE_WAIT) || finQueued)
+            break;
+        uint32_t space = ZOEOS_TCP_BUFFER_SIZE - (sndEnd - dataStart(sndUna));
+        if (space == 0)
+        {
+            if (!block || !sleep(this))
+                break;
+            continue;
+        }
+
+        uint32_t count = min32(space, size - queued);
+        for (uint32_t i = 0; i < count; i++)
+            sendBuffer[(sndEnd - iss - 1 + i) & TransmissionControlProtocolProvider::bufferMask] = data[queued + i];
+        sndEnd += count;
+        queued += count;
+        backend->output(this);
+    }
+    return queued || size == 0 ? (int)queued : -1;
+}
+
+int TransmissionControlProtocolSocket::receive(uint8_t *buffer, uint32_t size, bool block)
+{
+    InterruptGuard guard;
+    uint32_t available;
+    while ((available = rcvNxt - readSeq - (finReceived ? 1 : 0)) == 0)
+    {
+        if (finReceived || (state == TCP_CLOSED && !reset))
+            return 0;
+        if (state == TCP_CLOSED || state == TCP_LISTEN || !block || !sleep(this))
+            return -1;
+    }
+
+    uint32_t count = min32(available, size);
+    for (uint32_t i = 0; i < count; i++)
+        buffer[i] = receiveBuffer[(readSeq - irs - 1 + i) & TransmissionControlProtocolProvider::bufferMask];
+    readSeq += count;
+
+    // receiver side silly window avoidance: only announce worthwhile growth
+    if (seqLessEqual(rcvAdvertised + min32(ZOEOS_TCP_BUFFER_SIZE / 2, mss), readSeq + ZOEOS_TCP_BUFFER_SIZE) &&
+        state != TCP_CLOSED)
+    {
+        ackNow = true;
+        backend->output(this);
+    }
+    return count;
+}
+
+uint32_t TransmissionControlProtocolSocket::pollEvents() const
+{
+    if (state == TCP_LISTEN)
+        return acceptCount ? POLL_IN : 0;
+    uint32_t events = 0;
+    // the FIN counts in rcvNxt, receive() returns 0 for it
+    if (rcvNxt != readSeq || state == TCP_CLOSED)
+        events |= POLL_IN;
+    if ((state == TCP_ESTABLISHED || state == TCP_CLOSE_WAIT) && !finQueued &&
+        sndEnd - dataStart(sndUna) < ZOEOS_TCP_BUFFER_SIZE)
+        events |= POLL_OUT;
+    if (finReceived || state == TCP_CLOSED)
+        events |= POLL_HUP;
+    if (reset)
+        events |= POLL_ERR;
+    return events;
+}
+
+TransmissionControlProtocolSocket *TransmissionControlProtocolSocket::accept(bool block)
+{
+    InterruptGuard guard;
+    while (acceptCount == 0)
+    {
+        if (state != TCP_LISTEN || !block || !sleep(this))
+            return nullptr;
+    }
+    TransmissionControlProtocolSocket *socket = acceptQueue[acceptHead];
+    acceptHead = (acceptHead + 1) % backlog;
+    acceptCount--;
+    return socket;
+}
+
+void TransmissionControlProtocolSocket::close()
+{
+    InterruptGuard guard;
+    closedByApplication = true;
+    switch (state)
+    {
+    case TCP_LISTEN:
+        // connections nobody accepted are reset
+        while (acceptCount)
+        {
+            TransmissionControlProtocolSocket *socket = acceptQueue[acceptHead];
+            acceptHead = (acceptHead + 1) % backlog;
+            acceptCount--;
+            socket->closedByApplication = true;
+            if (socket->state != TCP_CLOSED)
+                backend->sendSegment(socket, socket->sndNxt, 0, TCP_RST | TCP_ACK);
+            backend->terminate(socket, true);
+        }
+        for (int i = 0; i < (1 << TransmissionControlProtocolProvider::hashBits); i++)
+        {
+            for (TransmissionControlProtocolSocket *socket = backend->connections[i]; socket; )
+            {
+                TransmissionControlProtocolSocket *nextSocket = socket->next;
+                if (socket->listener == this)
+                    backend->terminate(socket, true);
+                socket = nextSocket;
+            }
+        }
+        backend->destroy(this);
+        break;
+    case TCP_CLOSED:
+    case TCP_SYN_SENT:
+        backend->destroy(this);
+        break;
+    case TCP_SYN_RECEIVED:
+    case TCP_ESTABLISHED:
+        finQueued = true;
+        state = TCP_FIN_WAIT1;
+        backend->output(this);
+        break;
+    case TCP_CLOSE_WAIT:
+        finQueued = true;
+        state = TCP_LAST_ACK;
+        backend->output(this);
+        break;
+    default:
+        // closing already, freed when it is over
+        break;
+    }
+}
+
+static const NetStatField tcpFields[] =
+{
+    NETSTAT_FIELD(TcpStatistics, activeOpens),
+    NETSTAT_FIELD(TcpStatistics, passiveOpens),
+    NETSTAT_FIELD(TcpStatistics, failedOpens),
+    NETSTAT_FIELD(TcpStatistics, resetsReceived),
+    NETSTAT_FIELD(TcpStatistics, resetsSent),
+    NETSTAT_FIELD(TcpStatistics, segmentsIn),
+    NETSTAT_FIELD(TcpStatistics, segmentsOut),
+    NETSTAT_FIELD(TcpStatistics, badSegments),
+    NETSTAT_FIELD(TcpStatistics, retransmits),
+    NETSTAT_FIELD(TcpStatistics, fastRetransmits),
+    NETSTAT_FIELD(TcpStatistics, timeouts),
+    NETSTAT_FIELD(TcpStatistics, outOfOrder)
+};
+
+TransmissionControlProtocolProvider::TransmissionControlProtocolProvider(InternetProtocolProvider *backend)
+    : InternetProtocolHandler(backend, IP_PROTOCOL_TCP)
+{
+    for (int i = 0; i < (1 << hashBits); i++)
+        connections[i] = nullptr;
+    for (int i = 0; i < maxListeners; i++)
+        listeners[i] = nullptr;
+    nextEphemeralPort = EPHEMERAL_PORT_FIRST;
+    // the boot-time secret for the ISNs: how many cycles it took to get here
+    uint64_t tsc = IOProfiler::rdtsc();
+    isnSecret[0] = (uint32_t)tsc;
+    isnSecret[1] = (uint32_t)(tsc >> 32) ^ ((uint32_t)tsc * 2654435761u);
+    stats = TcpStatistics();
+    NetStatistics::add("tcp", -1, &stats, tcpFields, sizeof(tcpFields) / sizeof(tcpFields[0]));
+    txPool = new NetBufferPool(64);
+    if (TimerDriver::activeTimer)
+        TimerDriver::activeTimer->addPeriodic(tick, this, max32(TimerDriver::activeTimer->getFrequency() / 100, 1));
+}
+
+TransmissionControlProtocolProvider::~TransmissionControlProtocolProvider()
+{
+    NetStatistics::remove(&stats);
+    if (TimerDriver::activeTimer)
+        TimerDriver::activeTimer->removePeriodic(tick, this);
+    for (int i = 0; i < (1 << hashBits); i++)
+    {
+        while (connections[i])
+            destroy(connections[i]);
+    }
+    for (int i = 0; i < maxListeners; i++)
+    {
+        if (listeners[i])
+            destroy(listeners[i]);
+    }
+    delete txPool;
+}
+
+uint64_t TransmissionControlProtocolProvider::now()
+{
+    return TimerDriver::activeTimer ? TimerDriver::activeTimer->getMilliseconds() : 0;
+}
+
+uint32_t TransmissionControlProtocolProvider::hash(uint32_t remoteIP_BE, uint16_t remotePort_BE, uint16_t localPort_BE)
+{
+    return ((remoteIP_BE ^ ((uint32_t)remotePort_BE << 16 | localPort_BE)) * 2654435761u) >> (32 - hashBits);
+}
+
+TransmissionControlProtocolSocket *TransmissionControlProtocolProvider::lookup(uint32_t localIP_BE, uint32_t remoteIP_BE,
+        uint16_t localPort_BE, uint16_t remotePort_BE) const
+{
+    for (Socket *socket = connections[hash(remoteIP_BE, remotePort_BE, localPort_BE)]; socket; socket = socket->next)
+    {
+        if (socket->remotePort_BE == remotePort_BE && socket->localPort_BE == localPort_BE &&
+            socket->remoteIP == remoteIP_BE && socket->localIP == localIP_BE)
+            return socket;
+    }
+    return nullptr;
+}
+
+TransmissionControlProtocolSocket *TransmissionControlProtocolProvider::lookupListener(uint16_t localPort_BE) const
+{
+    for (int i = 0; i < maxListeners; i++)
+    {
+        if (listeners[i] && listeners[i]->localPort_BE == localPort_BE)
+            return listeners[i];
+    }
+    return nullptr;
+}
+
+void TransmissionControlProtocolProvider::insert(Socket *socket)
+{
+    uint32_t bucket = hash(socket->remoteIP, socket->remotePort_BE, socket->localPort_BE);
+    socket->next = connections[bucket];
+    connections[bucket] = socket;
+}
+
+void TransmissionControlProtocolProvider::remove(Socket *socket)
+{
+    for (Socket **link = &connections[hash(socket->remoteIP, socket->remotePort_BE, socket->localPort_BE)]; *link; link = &(*link)->next)
+    {
+        if (*link == socket)
+        {
+            *link = socket->next;
+            return;
+        }
+    }
+}
+
+TransmissionControlProtocolSocket *TransmissionControlProtocolProvider::newSocket(uint32_t localIP_BE, uint32_t remoteIP_BE,
+        uint16_t localPort_BE, uint16_t remotePort_BE)
+{
+    Socket *socket = new Socket(this);
+    socket->localIP = localIP_BE;
+    socket->remoteIP = remoteIP_BE;
+    socket->localPort_BE = localPort_BE;
+    socket->remotePort_BE = remotePort_BE;
+    socket->sendBuffer = new uint8_t[ZOEOS_TCP_BUFFER_SIZE];
+    socket->receiveBuffer = new uint8_t[ZOEOS_TCP_BUFFER_SIZE];
+
+    // RFC 6528: a clock plus a keyed function of the connection, so the ISNs
+    // of other connections tell an observer nothing about this one
+    socket->iss = (uint32_t)(IOProfiler::rdtsc() >> 6) + isnOffset(localIP_BE, remoteIP_BE, localPort_BE, remotePort_BE);
+    socket->sndUna = socket->iss;
+    socket->sndNxt = socket->iss;
+    socket->sndMax = socket->iss;
+    socket->sndEnd = socket->iss + 1;
+    socket->recover = socket->iss;
+    socket->highRetransmitted = socket->iss;
+
+    // offer the smallest scale that covers the buffer
+    while ((ZOEOS_TCP_BUFFER_SIZE >> socket->rcvWscale) > 0xffff)
+        socket->rcvWscale++;
+    return socket;
+}
+
+uint32_t TransmissionControlProtocolProvider::isnOffset(uint32_t localIP_BE, uint32_t remoteIP_BE,
+        uint16_t localPort_BE, uint16_t remotePort_BE) const
+{
+    // Not the MD5 RFC 6528 suggests: multiply-xorshift rounds seeded with the
+    // secret, which an observer without it cannot run
+    uint32_t words[3] = { localIP_BE, remoteIP_BE, ((uint32_t)localPort_BE << 16) | remotePort_BE };
+    uint32_t h = isnSecret[0];
+    for (int i = 0; i < 3; i++)
+    {
+        h ^= words[i] + isnSecret[1];
+        h *= 0x9e3779b1u;
+        h ^= h >> 15;
+        h *= 0x85ebca77u;
+        h ^= h >> 13;
+    }
+    return h;
+}
+
+void TransmissionControlProtocolProvider::terminate(Socket *socket, bool reset)
+{
+    socket->state = TCP_CLOSED;
+    socket->reset = reset;
+    socket->retransmitAt = 0;
+    socket->delayedAckAt = 0;
+    socket->timeWaitAt = 0;
+    wake(socket);
+    // still in the handshake, nobody else knows it
+    if (socket->listener)
+    {
+        socket->listener->numEmbryonic--;
+        destroy(socket);
+    }
+    else if (socket->closedByApplication)
+    {
+        destroy(socket);
+    }
+}
+
+void TransmissionControlProtocolProvider::destroy(Socket *socket)
+{
+    if (socket->state == TCP_LISTEN)
+    {
+        for (int i = 0; i < maxListeners; i++)
+        {
+            if (listeners[i] == socket)
+                listeners[i] = nullptr;
+        }
+    }
+    else
+    {
+        remove(socket);
+    }
+    delete socket;
+}
+
+TransmissionControlProtocolSocket *TransmissionControlProtocolProvider::listen(uint16_t port)
+{
+    InterruptGuard guard;
+    uint16_t port_BE = bigEndian16(port);
+    if (lookupListener(port_BE))
+        return nullptr;
+    for (int i = 0; i < maxListeners; i++)
+    {
+        if (listeners[i] == nullptr)
+        {
+            Socket *socket = new Socket(this);
+            socket->localPort_BE = port_BE;
+            socket->state = TCP_LISTEN;
+            listeners[i] = socket;
+            return socket;
+        }
+    }
+    return nullptr;
+}
+
+TransmissionControlProtocolSocket *TransmissionControlProtocolProvider::connect(uint32_t ip_BE, uint16_t port, bool block)
+{
+    InterruptGuard guard;
+    uint32_t localIP = backend->getIPAddress();
+    uint16_t port_BE = bigEndian16(port);
+    uint16_t localPort_BE = 0;
+    for (int tries = 0; tries < 0x10000 - EPHEMERAL_PORT_FIRST && localPort_BE == 0; tries++)
+    {
+        uint16_t candidate = bigEndian16(nextEphemeralPort);
+        nextEphemeralPort = nextEphemeralPort == 0xffff ? EPHEMERAL_PORT_FIRST : nextEphemeralPort + 1;
+        if (lookup(localIP, ip_BE, candidate, port_BE) == nullptr && lookupListener(candidate) == nullptr)
+            localPort_BE = candidate;
+    }
+    if (localPort_BE == 0)
+        return nullptr;
+
+    Socket *socket = newSocket(localIP, ip_BE, localPort_BE, port_BE);
+    socket->state = TCP_SYN_SENT;
+    insert(socket);
+    sendSegment(socket, socket->iss, 0, TCP_SYN);
+    socket->sndNxt = socket->iss + 1;
+    socket->sndMax = socket->sndNxt;
+    socket->rttTiming = true;
+    socket->rttSeq = socket->iss;
+    socket->rttStart = now();
+    socket->retransmitAt = socket->rttStart + socket->rto;
+    stats.activeOpens++;
+
+    if (!block)
+        return socket;
+    while (socket->state == TCP_SYN_SENT || socket->state == TCP_SYN_RECEIVED)
+    {
+        if (!sleep(socket))
+            return socket;
+    }
+    if (socket->state != TCP_ESTABLISHED && socket->state != TCP_CLOSE_WAIT)
+    {
+        destroy(socket);
+        return nullptr;
+    }
+    return socket;
+}
+
+bool TransmissionControlProtocolProvider::onInternetProtocolReceived(uint32_t srcIP_BE, uint32_t dstIP_BE,
+        uint8_t *payload, uint32_t size)
+{
+    // the application calls in from tasks, keep them out while a segment is handled
+    InterruptGuard guard;
+    stats.segmentsIn++;
+    if (size < sizeof(TransmissionControlProtocolHeader))
+    {
+        stats.badSegments++;
+        return false;
+    }
+    TransmissionControlProtocolHeader *tcp = (TransmissionControlProtocolHeader*)payload;
+    uint32_t headerSize = tcp->headerSize32 * 4;
+    if (headerSize < sizeof(TransmissionControlProtocolHeader) || headerSize > size ||
+        InternetChecksum::partial(payload, size, pseudoHeaderSum(srcIP_BE, dstIP_BE, size)) != 0xffff)
+    {
+        stats.badSegments++;
+        return false;
+    }
+    // no TCP to broadcast addresses
+    if (dstIP_BE != backend->getIPAddress())
+        return false;
+
+    uint32_t dataSize = size - headerSize;
+    Socket *socket = lookup(dstIP_BE, srcIP_BE, tcp->dstPort, tcp->srcPort);
+    if (socket)
+    {
+        process(socket, tcp, payload + headerSize, dataSize);
+        return false;
+    }
+    Socket *listener = lookupListener(tcp->dstPort);
+    if (listener)
+        processListen(listener, srcIP_BE, dstIP_BE, tcp, dataSize);
+    else
+        sendReset(dstIP_BE, srcIP_BE, tcp, dataSize);
+    return false;
+}
+
+void TransmissionControlProtocolProvider::parseOptions(Socket *socket, TransmissionControlProtocolHeader *tcp)
+{
+    uint8_t *option = (uint8_t*)tcp + sizeof(TransmissionControlProtocolHeader);
+    uint8_t *end = (uint8_t*)tcp + tcp->headerSize32 * 4;
+    bool syn = tcp->flags & TCP_SYN;
+    uint16_t peerMSS = 536;
+    bool windowScale = false;
+
+    while (option < end && *option != TCP_OPTION_END)
+    {
+        if (*option == TCP_OPTION_NOP)
+        {
+            option++;
+            continue;
+        }
+        if (option + 1 >= end || option[1] < 2 || option + option[1] > end)
+            break;
+        uint8_t length = option[1];
+        if (syn && *option == TCP_OPTION_MSS && length == 4)
+        {
+            peerMSS = bigEndian16(*(uint16_t*)(option + 2));
+        }
+        else if (syn && *option == TCP_OPTION_WINDOW_SCALE && length == 3)
+        {
+            windowScale = true;
+            socket->sndWscale = option[2] > 14 ? 14 : option[2];
+        }
+        else if (syn && *option == TCP_OPTION_SACK_PERMITTED && length == 2)
+        {
+            socket->sackPermitted = true;
+        }
+        else if (!syn && socket->sackPermitted && *option == TCP_OPTION_SACK)
+        {
+            // merge each reported block into the scoreboard
+            for (uint8_t *block = option + 2; block + 8 <= option + length; block += 8)
+            {
+                uint32_t start = bigEndian32(*(uint32_t*)block);
+                uint32_t blockEnd = bigEndian32(*(uint32_t*)(block + 4));
+                if (!seqLess(start, blockEnd) || seqLessEqual(blockEnd, socket->sndUna) || seqLess(socket->sndMax, blockEnd))
+                    continue;
+                for (int i = 0; i < socket->numSacked; )
+                {
+                    Socket::SackBlock *old = &socket->sacked[i];
+                    if (seqLessEqual(old->start, blockEnd) && seqLessEqual(start, old->end))
+                    {
+                        if (seqLess(old->start, start))
+                            start = old->start;
+                        if (seqLess(blockEnd, old->end))
+                            blockEnd = old->end;
+                        *old = socket->sacked[--socket->numSacked];
+                        continue;
+                    }
+                    i++;
+                }
+                if (socket->numSacked == Socket::maxSackBlocks)
+                    socket->numSacked--;
+                socket->sacked[socket->numSacked].start = start;
+                socket->sacked[socket->numSacked].end = blockEnd;
+                socket->numSacked++;
+            }
+        }
+        option += length;
+    }
+
+    if (!syn)
+        return;
+    // scaling only applies if both sides asked for it
+    if (!windowScale)
+    {
+        socket->sndWscale = 0;
+        socket->rcvWscale = 0;
+    }
+    uint16_t ourMSS = backend->getMTU() - sizeof(InternetProtocolV4Message) - sizeof(TransmissionControlProtocolHeader);
+    socket->mss = peerMSS < ourMSS ? peerMSS : ourMSS;
+    // RFC 6928 initial window
+    socket->cwnd = min32(10 * socket->mss, max32(2 * socket->mss, 14600));
+}
+
+void TransmissionControlProtocolProvider::processListen(Socket *listener, uint32_t srcIP_BE, uint32_t dstIP_BE,
+        TransmissionControlProtocolHeader *tcp, uint32_t dataSize)
+{
+    if (tcp->flags & TCP_RST)
+        return;
+    if (tcp->flags & TCP_ACK)
+    {
+        sendReset(dstIP_BE, srcIP_BE, tcp, dataSize);
+        return;
+    }
+    if (!(tcp->flags & TCP_SYN))
+        return;
+    // the peer retries the SYN later
+    if (listener->acceptCount + listener->numEmbryonic >= Socket::backlog)
+    {
+        stats.failedOpens++;
+        return;
+    }
+
+    Socket *socket = newSocket(dstIP_BE, srcIP_BE, tcp->dstPort, tcp->srcPort);
+    socket->listener = listener;
+    listener->numEmbryonic++;
+    socket->irs = bigEndian32(tcp->sequenceNumber);
+    socket->rcvNxt = socket->irs + 1;
+    socket->readSeq = socket->rcvNxt;
+    socket->rcvAdvertised = socket->rcvNxt;
+    parseOptions(socket, tcp);
+    // never scaled in a SYN
+    socket->sndWnd = bigEndian16(tcp->windowSize);
+    socket->state = TCP_SYN_RECEIVED;
+    insert(socket);
+
+    sendSegment(socket, socket->iss, 0, TCP_SYN | TCP_ACK);
+    socket->sndNxt = socket->iss + 1;
+    socket->sndMax = socket->sndNxt;
+    socket->retransmitAt = now() + socket->rto;
+    stats.passiveOpens++;
+}
+
+void TransmissionControlProtocolProvider::processSynSent(Socket *socket, TransmissionControlProtocolHeader *tcp)
+{
+    uint32_t seq = bigEndian32(tcp->sequenceNumber);
+    uint32_t ack = bigEndian32(tcp->acknowledgementNumber);
+    if ((tcp->flags & TCP_ACK) && !(seqLess(socket->iss, ack) && seqLessEqual(ack, socket->sndMax)))
+    {
+        sendReset(socket->localIP, socket->remoteIP, tcp, 0);
+        return;
+    }
+    if (tcp->flags & TCP_RST)
+    {
+        if (tcp->flags & TCP_ACK)
+        {
+            // connection refused
+            stats.resetsReceived++;
+            stats.failedOpens++;
+            terminate(socket, true);
+        }
+        return;
+    }
+    if (!(tcp->flags & TCP_SYN))
+        return;
+
+    socket->irs = seq;
+    socket->rcvNxt = seq + 1;
+    socket->readSeq = socket->rcvNxt;
+    socket->rcvAdvertised = socket->rcvNxt;
+    parseOptions(socket, tcp);
+
+    if (!(tcp->flags & TCP_ACK))
+    {
+        // simultaneous open
+        socket->state = TCP_SYN_RECEIVED;
+        sendSegment(socket, socket->iss, 0, TCP_SYN | TCP_ACK);
+        return;
+    }
+
+    socket->sndUna = ack;
+    socket->sndWnd = bigEndian16(tcp->windowSize);
+    socket->sndWl1 = seq;
+    socket->sndWl2 = ack;
+    socket->state = TCP_ESTABLISHED;
+    socket->retransmitAt = 0;
+    socket->retries = 0;
+    if (socket->rttTiming)
+    {
+        updateRTO(socket, now() - socket->rttStart);
+        socket->rttTiming = false;
+    }
+    socket->ackNow = true;
+    output(socket);
+    wake(socket);
+}
+
+void TransmissionControlProtocolProvider::process(Socket *socket, TransmissionControlProtocolHeader *tcp, uint8_t *data, uint32_t dataSize)
+{
+    uint8_t flags = tcp->flags;
+    uint32_t seq = bigEndian32(tcp->sequenceNumber);
+
+    if (socket->state == TCP_SYN_SENT)
+    {
+        processSynSent(socket, tcp);
+        return;
+    }
+    // our SYN-ACK got lost, the peer sends its SYN again
+    if (socket->state == TCP_SYN_RECEIVED && (flags & TCP_SYN) && !(flags & TCP_ACK) && seq == socket->irs)
+    {
+        sendSegment(socket, socket->iss, 0, TCP_SYN | TCP_ACK);
+        return;
+    }
+    if (socket->state == TCP_CLOSED)
+        return;
+
+    // RFC 793 acceptability: some of the segment must fall in the window
+    uint32_t window = socket->receiveWindow();
+    uint32_t length = dataSize + ((flags & TCP_SYN) ? 1 : 0) + ((flags & TCP_FIN) ? 1 : 0);
+    bool acceptable;
+    if (length == 0)
+        acceptable = window == 0 ? seq == socket->rcvNxt :
+            seqLessEqual(socket->rcvNxt, seq) && seqLess(seq, socket->rcvNxt + window);
+    else
+        acceptable = window != 0 &&
+            ((seqLessEqual(socket->rcvNxt, seq) && seqLess(seq, socket->rcvNxt + window)) ||
+             (seqLessEqual(socket->rcvNxt, seq + length - 1) && seqLess(seq + length - 1, socket->rcvNxt + window)));
+    if (!acceptable)
+    {
+        if (!(flags & TCP_RST))
+            sendAck(socket);
+        return;
+    }
+
+    // RFC 5961: only an exact RST resets, anything else in the window gets a challenge ACK
+    if (flags & TCP_RST)
+    {
+        if (seq == socket->rcvNxt)
+        {
+            stats.resetsReceived++;
+            terminate(socket, true);
+        }
+        else
+        {
+            sendAck(socket);
+        }
+        return;
+    }
+    if (flags & TCP_SYN)
+    {
+        sendAck(socket);
+        return;
+    }
+    if (!(flags & TCP_ACK))
+        return;
+
+    processAck(socket, tcp, dataSize);
+    if (socket->state == TCP_CLOSED)
+    {
+        // LAST-ACK is over
+        if (socket->closedByApplication)
+            destroy(socket);
+        return;
+    }
+
+    if (dataSize && (socket->state == TCP_ESTABLISHED || socket->state == TCP_FIN_WAIT1 || socket->state == TCP_FIN_WAIT2))
+        processData(socket, seq, data, dataSize);
+    if ((flags & TCP_FIN) && !socket->finReceived && seq + dataSize == socket->rcvNxt)
+        processFin(socket);
+    output(socket);
+}
+
+void TransmissionControlProtocolProvider::processAck(Socket *socket, TransmissionControlProtocolHeader *tcp, uint32_t dataSize)
+{
+    uint32_t seq = bigEndian32(tcp->sequenceNumber);
+    uint32_t ack = bigEndian32(tcp->acknowledgementNumber);
+    uint32_t window = (uint32_t)bigEndian16(tcp->windowSize) << socket->sndWscale;
+    uint64_t time = now();
+
+    if (socket->state == TCP_SYN_RECEIVED)
+    {
+        if (!(seqLess(socket->sndUna, ack) && seqLessEqual(ack, socket->sndMax)))
+        {
+            sendReset(socket->localIP, socket->remoteIP, tcp, dataSize);
+            return;
+        }
+        socket->state = TCP_ESTABLISHED;
+        socket->sndWnd = window;
+        socket->sndWl1 = seq;
+        socket->sndWl2 = ack;
+        Socket *listener = socket->listener;
+        if (listener)
+        {
+            // room was kept for it when the SYN came in
+            socket->listener = nullptr;
+            listener->numEmbryonic--;
+            listener->acceptQueue[(listener->acceptHead + listener->acceptCount) % Socket::backlog] = socket;
+            listener->acceptCount++;
+            wake(listener);
+        }
+        wake(socket);
+    }
+
+    // acknowledges something never sent
+    if (seqLess(socket->sndMax, ack))
+    {
+        socket->ackNow = true;
+        return;
+    }
+    parseOptions(socket, tcp);
+
+    bool windowChanged = false;
+    if (seqLess(socket->sndWl1, seq) || (socket->sndWl1 == seq && seqLessEqual(socket->sndWl2, ack)))
+    {
+        windowChanged = socket->sndWnd != window;
+        socket->sndWnd = window;
+        socket->sndWl1 = seq;
+        socket->sndWl2 = ack;
+    }
+
+    if (seqLess(socket->sndUna, ack))
+    {
+        uint32_t acked = ack - socket->sndUna;
+        socket->sndUna = ack;
+        if (seqLess(socket->sndNxt, ack))
+            socket->sndNxt = ack;
+        socket->retries = 0;
+        if (socket->rttTiming && seqLess(socket->rttSeq, ack))
+        {
+            updateRTO(socket, time - socket->rttStart);
+            socket->rttTiming = false;
+        }
+        for (int i = 0; i < socket->numSacked; )
+        {
+            if (seqLessEqual(socket->sacked[i].end, ack))
+                socket->sacked[i] = socket->sacked[--socket->numSacked];
+            else
+                i++;
+        }
+
+        if (socket->inRecovery)
+        {
+            if (seqLessEqual(socket->recover, ack))
+            {
+                // full ACK, RFC 6582
+                socket->cwnd = socket->ssthresh;
+                socket->inRecovery = false;
+                socket->dupAcks = 0;
+            }
+            else
+            {
+                // partial ACK: the next hole is lost too, deflate by what left the network
+                retransmit(socket, nextHole(socket, ack));
+                socket->cwnd = socket->cwnd > acked ? socket->cwnd - acked : 0;
+                if (acked >= socket->mss)
+                    socket->cwnd += socket->mss;
+            }
+        }
+        else
+        {
+            socket->dupAcks = 0;
+            // slow start by bytes acked, at most an MSS per ACK (RFC 3465), then congestion avoidance
+            if (socket->cwnd < socket->ssthresh)
+                socket->cwnd += min32(acked, socket->mss);
+            else
+                socket->cwnd += max32(1, socket->mss * socket->mss / socket->cwnd);
+        }
+
+        socket->retransmitAt = socket->sndUna == socket->sndMax ? 0 : time + socket->rto;
+
+        // our FIN is acknowledged
+        if (socket->finQueued && socket->sndUna == socket->sndEnd + 1)
+        {
+            if (socket->state == TCP_FIN_WAIT1)
+            {
+                socket->state = TCP_FIN_WAIT2;
+            }
+            else if (socket->state == TCP_CLOSING)
+            {
+                socket->state = TCP_TIME_WAIT;
+                socket->timeWaitAt = time + timeWaitTime;
+            }
+            else if (socket->state == TCP_LAST_ACK)
+            {
+                socket->state = TCP_CLOSED;
+                socket->retransmitAt = 0;
+            }
+        }
+        wake(socket);
+        return;
+    }
+
+    // RFC 5681 duplicate ACK: nothing new, no data, same window, data outstanding
+    if (ack != socket->sndUna || dataSize || windowChanged || socket->sndUna == socket->sndMax ||
+        socket->sndWnd == 0 || (tcp->flags & (TCP_SYN | TCP_FIN)))
+        return;
+    socket->dupAcks++;
+    if (!socket->inRecovery && socket->dupAcks == 3 && seqLess(socket->recover, ack + 1))
+    {
+        uint32_t flight = socket->sndMax - socket->sndUna;
+        socket->ssthresh = max32(flight / 2, 2 * socket->mss);
+        socket->recover = socket->sndMax;
+        socket->inRecovery = true;
+        socket->highRetransmitted = socket->sndUna;
+        retransmit(socket, socket->sndUna);
+        socket->cwnd = socket->ssthresh + 3 * socket->mss;
+        stats.fastRetransmits++;
+    }
+    else if (socket->inRecovery)
+    {
+        // every duplicate means a segment left the network
+        socket->cwnd += socket->mss;
+        // with SACK, a hole below data the peer holds is lost as well
+        if (socket->numSacked)
+        {
+            uint32_t highestSacked = socket->sacked[0].end;
+            for (int i = 1; i < socket->numSacked; i++)
+            {
+                if (seqLess(highestSacked, socket->sacked[i].end))
+                    highestSacked = socket->sacked[i].end;
+            }
+            uint32_t hole = nextHole(socket, seqLess(socket->highRetransmitted, socket->sndUna) ? socket->sndUna : socket->highRetransmitted);
+            if (seqLess(hole, highestSacked))
+                retransmit(socket, hole);
+        }
+    }
+}
+
+void TransmissionControlProtocolProvider::processData(Socket *socket, uint32_t seq, uint8_t *data, uint32_t dataSize)
+{
+    // drop what we have already and what does not fit
+    if (seqLess(seq, socket->rcvNxt))
+    {
+        uint32_t skip = socket->rcvNxt - seq;
+        if (skip >= dataSize)
+        {
+            socket->ackNow = true;
+            return;
+        }
+        data += skip;
+        dataSize -= skip;
+        seq = socket->rcvNxt;
+    }
+    uint32_t right = socket->readSeq + ZOEOS_TCP_BUFFER_SIZE;
+    if (seqLess(right, seq + dataSize))
+        dataSize = right - seq;
+
+    for (uint32_t i = 0; i < dataSize; i++)
+        socket->receiveBuffer[(seq - socket->irs - 1 + i) & bufferMask] = data[i];
+
+    if (seq != socket->rcvNxt)
+    {
+        // out of order: remember the range, newest first, and tell the peer at once
+        stats.outOfOrder++;
+        uint32_t start = seq;
+        uint32_t end = seq + dataSize;
+        for (int i = 0; i < socket->numOutOfOrder; )
+        {
+            Socket::SackBlock *block = &socket->outOfOrder[i];
+            if (seqLessEqual(block->start, end) && seqLessEqual(start, block->end))
+            {
+                if (seqLess(block->start, start))
+                    start = block->start;
+                if (seqLess(end, block->end))
+                    end = block->end;
+                for (int j = i; j < socket->numOutOfOrder - 1; j++)
+                    socket->outOfOrder[j] = socket->outOfOrder[j + 1];
+                socket->numOutOfOrder--;
+                continue;
+            }
+            i++;
+        }
+        if (socket->numOutOfOrder == Socket::maxSackBlocks)
+            socket->numOutOfOrder--;
+        for (int j = socket->numOutOfOrder; j > 0; j--)
+            socket->outOfOrder[j] = socket->outOfOrder[j - 1];
+        socket->outOfOrder[0].start = start;
+        socket->outOfOrder[0].end = end;
+        socket->numOutOfOrder++;
+        socket->ackNow = true;
+        return;
+    }
+
+    socket->rcvNxt += dataSize;
+    bool filledHole = socket->numOutOfOrder > 0;
+    for (int i = 0; i < socket->numOutOfOrder; )
+    {
+        Socket::SackBlock *block = &socket->outOfOrder[i];
+        if (seqLessEqual(block->start, socket->rcvNxt))
+        {
+            if (seqLess(socket->rcvNxt, block->end))
+                socket->rcvNxt = block->end;
+            for (int j = i; j < socket->numOutOfOrder - 1; j++)
+                socket->outOfOrder[j] = socket->outOfOrder[j + 1];
+            socket->numOutOfOrder--;
+            // the merged end may reach further blocks
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+
+    // delayed ACK: every second segment, when a hole closes, or after delayedAckTime
+    if (filledHole || ++socket->unackedSegments >= 2)
+        socket->ackNow = true;
+    else if (socket->delayedAckAt == 0)
+        socket->delayedAckAt = now() + delayedAckTime;
+    wake(socket);
+}
+
+void TransmissionControlProtocolProvider::processFin(Socket *socket)
+{
+    socket->rcvNxt++;
+    socket->finReceived = true;
+    socket->ackNow = true;
+    switch (socket->state)
+    {
+    case TCP_ESTABLISHED:
+        socket->state = TCP_CLOSE_WAIT;
+        break;
+    case TCP_FIN_WAIT1:
+        socket->state = TCP_CLOSING;
+        break;
+    case TCP_FIN_WAIT2:
+        socket->state = TCP_TIME_WAIT;
+        socket->timeWaitAt = now() + timeWaitTime;
+        socket->retransmitAt = 0;
+        break;
+    default:
+        break;
+    }
+    wake(socket);
+}
+
+void TransmissionControlProtocolProvider::updateRTO(Socket *socket, uint32_t rtt)
+{
+    // RFC 6298 with a 10 ms clock granularity
+    if (socket->srtt == 0 && socket->rttvar == 0)
+    {
+        socket->srtt = rtt;
+        socket->rttvar = rtt / 2;
+    }
+    else
+    {
+        uint32_t delta = socket->srtt > rtt ? socket->srtt - rtt : rtt - socket->srtt;
+        socket->rttvar = (3 * socket->rttvar + delta) / 4;
+        socket->srtt = (7 * socket->srtt + rtt) / 8;
+    }
+    socket->rto = min32(max32(socket->srtt + max32(10, 4 * socket->rttvar), minRTO), maxRTO);
+}
+
+uint32_t TransmissionControlProtocolProvider::nextHole(Socket *socket, uint32_t seq) const
+{
+    for (bool moved = true; moved; )
+    {
+        moved = false;
+        for (int i = 0; i < socket->numSacked; i++)
+        {
+            if (seqLessEqual(socket->sacked[i].start, seq) && seqLess(seq, socket->sacked[i].end))
+            {
+                seq = socket->sacked[i].end;
+                moved = true;
+            }
+        }
+    }
+    return seq;
+}
+
+void TransmissionControlProtocolProvider::retransmit(Socket *socket, uint32_t seq)
+{
+    if (seqLessEqual(socket->sndMax, seq))
+        return;
+    // up to an MSS, stopping where the peer's SACKed data starts
+    uint32_t end = socket->sndEnd;
+    for (int i = 0; i < socket->numSacked; i++)
+    {
+        if (seqLess(seq, socket->sacked[i].start) && seqLess(socket->sacked[i].start, end))
+            end = socket->sacked[i].start;
+    }
+    uint32_t size = seqLess(seq, end) ? min32(end - seq, socket->mss) : 0;
+    bool fin = socket->finQueued && seq + size == socket->sndEnd && seqLess(socket->sndEnd, socket->sndMax);
+    if (size == 0 && !fin)
+        return;
+
+    sendSegment(socket, seq, size, TCP_ACK | (fin ? TCP_FIN : 0));
+    socket->highRetransmitted = seq + size + (fin ? 1 : 0);
+    // Karn: no RTT samples from retransmitted data
+    socket->rttTiming = false;
+    stats.retransmits++;
+}
+
+void TransmissionControlProtocolProvider::output(Socket *socket)
+{
+    TransmissionControlProtocolSocketState state = socket->state;
+    if (state == TCP_ESTABLISHED || state == TCP_CLOSE_WAIT || state == TCP_FIN_WAIT1 ||
+        state == TCP_CLOSING || state == TCP_LAST_ACK)
+    {
+        uint64_t time = now();
+        while (true)
+        {
+            uint32_t flight = socket->sndNxt - socket->sndUna;
+            uint32_t window = min32(socket->sndWnd, socket->cwnd);
+            uint32_t usable = window > flight ? window - flight : 0;
+            uint32_t available = seqLess(socket->sndNxt, socket->sndEnd) ? socket->sndEnd - socket->sndNxt : 0;
+            uint32_t size = min32(min32(available, usable), socket->mss);
+            bool fin = socket->finQueued && socket->sndNxt + size == socket->sndEnd;
+            if (size == 0 && !fin)
+                break;
+            // sender silly window avoidance: no small segments just because the window is small
+            if (size < socket->mss && size < available && size < socket->sndWnd / 2)
+                break;
+            // Nagle: one small segment in flight at a time
+            if (size < socket->mss && !fin && !socket->noDelay && socket->sndNxt != socket->sndUna)
+                break;
+
+            bool retransmission = seqLess(socket->sndNxt, socket->sndMax);
+            if (!socket->rttTiming && !retransmission && size)
+            {
+                socket->rttTiming = true;
+                socket->rttSeq = socket->sndNxt;
+                socket->rttStart = time;
+            }
+            uint8_t flags = TCP_ACK | (fin ? TCP_FIN : 0) | (size && socket->sndNxt + size == socket->sndEnd ? TCP_PSH : 0);
+            sendSegment(socket, socket->sndNxt, size, flags);
+            if (retransmission)
+                stats.retransmits++;
+            socket->sndNxt += size + (fin ? 1 : 0);
+            if (seqLess(socket->sndMax, socket->sndNxt))
+                socket->sndMax = socket->sndNxt;
+            if (socket->retransmitAt == 0)
+                socket->retransmitAt = time + socket->rto;
+            if (fin)
+                break;
+        }
+
+        // zero window with data waiting: the retransmission timer probes it
+        if (socket->sndWnd == 0 && socket->sndNxt == socket->sndUna && seqLess(socket->sndNxt, socket->sndEnd) &&
+            socket->retransmitAt == 0)
+            socket->retransmitAt = time + socket->rto;
+    }
+
+    if (socket->ackNow && state != TCP_CLOSED && state != TCP_LISTEN && state != TCP_SYN_SENT)
+        sendAck(socket);
+}
+
+void TransmissionControlProtocolProvider::sendSegment(Socket *socket, uint32_t seq, uint32_t size, uint8_t flags)
+{
+    uint8_t header[60];
+    TransmissionControlProtocolHeader *tcp = (TransmissionControlProtocolHeader*)header;
+    uint8_t *options = header + sizeof(TransmissionControlProtocolHeader);
+    uint32_t optionsSize = 0;
+
+    if (flags & TCP_SYN)
+    {
+        uint16_t ourMSS = backend->getMTU() - sizeof(InternetProtocolV4Message) - sizeof(TransmissionControlProtocolHeader);
+        options[0] = TCP_OPTION_MSS;
+        options[1] = 4;
+        *(uint16_t*)(options + 2) = bigEndian16(ourMSS);
+        options[4] = TCP_OPTION_NOP;
+        options[5] = TCP_OPTION_WINDOW_SCALE;
+        options[6] = 3;
+        options[7] = socket->rcvWscale;
+        options[8] = TCP_OPTION_NOP;
+        options[9] = TCP_OPTION_NOP;
+        options[10] = TCP_OPTION_SACK_PERMITTED;
+        options[11] = 2;
+        optionsSize = 12;
+    }
+    else if (socket->sackPermitted && socket->numOutOfOrder && (flags & TCP_ACK))
+    {
+        options[0] = TCP_OPTION_NOP;
+        options[1] = TCP_OPTION_NOP;
+        options[2] = TCP_OPTION_SACK;
+        options[3] = 2 + 8 * socket->numOutOfOrder;
+        for (int i = 0; i < socket->numOutOfOrder; i++)
+        {
+            *(uint32_t*)(options + 4 + 8 * i) = bigEndian32(socket->outOfOrder[i].start);
+            *(uint32_t*)(options + 8 + 8 * i) = bigEndian32(socket->outOfOrder[i].end);
+        }
+        optionsSize = 4 + 8 * socket->numOutOfOrder;
+    }
+    uint32_t headerSize = sizeof(TransmissionControlProtocolHeader) + optionsSize;
+
+    tcp->srcPort = socket->localPort_BE;
+    tcp->dstPort = socket->remotePort_BE;
+    tcp->sequenceNumber = bigEndian32(seq);
+    tcp->acknowledgementNumber = (flags & TCP_ACK) ? bigEndian32(socket->rcvNxt) : 0;
+    tcp->reserved = 0;
+    tcp->headerSize32 = headerSize / 4;
+    tcp->flags = flags;
+    tcp->urgentPointer = 0;
+    // the window in a SYN is never scaled
+    uint8_t scale = (flags & TCP_SYN) ? 0 : socket->rcvWscale;
+    uint32_t window = min32(socket->receiveWindow() >> scale, 0xffff);
+    tcp->windowSize = bigEndian16(window);
+    if (!(flags & TCP_SYN))
+        socket->rcvAdvertised = socket->rcvNxt + (window << scale);
+
+    // The payload comes out of the send ring in two pieces where it wraps. It
+    // is summed while it is copied to a buffer the NIC reads by DMA; with no
+    // buffer free the NIC copies the pieces and they are summed in place.
+    TxFragment payload[2];
+    int count = 0;
+    uint32_t payloadSum = 0;
+    NetBuffer *buffer = nullptr;
+    if (size)
+    {
+        uint32_t index = (seq - socket->iss - 1) & bufferMask;
+        uint32_t first = min32(size, ZOEOS_TCP_BUFFER_SIZE - index);
+        payload[0].data = socket->sendBuffer + index;
+        payload[0].size = first;
+        count = 1;
+        if (first < size)
+        {
+            payload[1].data = socket->sendBuffer;
+            payload[1].size = size - first;
+            count = 2;
+        }
+
+        if (size <= txPool->getBufferSize())
+            buffer = txPool->alloc();
+        uint32_t offset = 0;
+        for (int i = 0; i < count; i++)
+        {
+            uint32_t piece = buffer ? InternetChecksum::copyPartial(buffer->data + offset, payload[i].data, payload[i].size) :
+                InternetChecksum::partial(payload[i].data, payload[i].size);
+            payloadSum = InternetChecksum::combine(payloadSum, piece, offset);
+            offset += payload[i].size;
+        }
+        if (buffer)
+        {
+            buffer->size = size;
+            payload[0].data = buffer->data;
+            payload[0].size = size;
+            count = 1;
+        }
+    }
+    transmit(socket->localIP, socket->remoteIP, tcp, headerSize, payload, count, payloadSum, buffer);
+
+    if (flags & TCP_ACK)
+    {
+        socket->ackNow = false;
+        socket->delayedAckAt = 0;
+        socket->unackedSegments = 0;
+    }
+}
+
+void TransmissionControlProtocolProvider::sendReset(uint32_t srcIP_BE, uint32_t dstIP_BE, TransmissionControlProtocolHeader *tcp,
+        uint32_t dataSize)
+{
+    if (tcp->flags & TCP_RST)
+        return;
+    TransmissionControlProtocolHeader reply;
+    reply.srcPort = tcp->dstPort;
+    reply.dstPort = tcp->srcPort;
+    if (tcp->flags & TCP_ACK)
+    {
+        reply.sequenceNumber = tcp->acknowledgementNumber;
+        reply.acknowledgementNumber = 0;
+        reply.flags = TCP_RST;
+    }
+    else
+    {
+        uint32_t length = dataSize + ((tcp->flags & TCP_SYN) ? 1 : 0) + ((tcp->flags & TCP_FIN) ? 1 : 0);
+        reply.sequenceNumber = 0;
+        reply.acknowledgementNumber = bigEndian32(bigEndian32(tcp->sequenceNumber) + length);
+        reply.flags = TCP_RST | TCP_ACK;
+    }
+    reply.reserved = 0;
+    reply.headerSize32 = sizeof(TransmissionControlProtocolHeader) / 4;
+    reply.windowSize = 0;
+    reply.urgentPointer = 0;
+    transmit(srcIP_BE, dstIP_BE, &reply, sizeof(TransmissionControlProtocolHeader), nullptr, 0, 0, nullptr);
+    stats.resetsSent++;
+}
+
+void TransmissionControlProtocolProvider::transmit(uint32_t localIP_BE, uint32_t remoteIP_BE, TransmissionControlProtocolHeader *tcp,
+        uint32_t headerSize, const TxFragment *payload, int count, uint32_t payloadSum, NetBuffer *buffer)
+{
+    TxFragment fragments[3];
+    fragments[0].data = (uint8_t*)tcp;
+    fragments[0].size = headerSize;
+    uint32_t size = headerSize;
+    for (int i = 0; i < count; i++)
+    {
+        fragments[i + 1] = payload[i];
+        size += payload[i].size;
+    }
+    // the header is a whole number of words, the payload sum adds on as it is
+    tcp->checksum = 0;
+    tcp->checksum = InternetChecksum::finish(
+        InternetChecksum::partial((uint8_t*)tcp, headerSize, pseudoHeaderSum(localIP_BE, remoteIP_BE, size)) + payloadSum);
+    TxStatus status = send(remoteIP_BE, fragments, count + 1, buffer ? releaseBuffer : nullptr, buffer);
+    // the completion only runs for frames that were taken
+    if (buffer && status != TX_SENT && status != TX_QUEUED)
+        buffer->release();
+    stats.segmentsOut++;
+}
+
+void TransmissionControlProtocolProvider::tick(void *cookie)
+{
+    TransmissionControlProtocolProvider *tcp = (TransmissionControlProtocolProvider*)cookie;
+    InterruptGuard guard;
+    uint64_t time = now();
+    for (int i = 0; i < (1 << hashBits); i++)
+    {
+        for (Socket *socket = tcp->connections[i]; socket; )
+        {
+            // timeout() may free the socket
+            Socket *nextSocket = socket->next;
+            tcp->timeout(socket, time);
+            socket = nextSocket;
+        }
+    }
+}
+
+void TransmissionControlProtocolProvider::timeout(Socket *socket, uint64_t time)
+{
+    if (socket->timeWaitAt && time >= socket->timeWaitAt)
+    {
+        terminate(socket, false);
+        return;
+    }
+    if (socket->delayedAckAt && time >= socket->delayedAckAt)
+        sendAck(socket);
+    if (socket->retransmitAt == 0 || time < socket->retransmitAt)
+        return;
+    socket->retransmitAt = 0;
+
+    if (socket->state == TCP_SYN_SENT || socket->state == TCP_SYN_RECEIVED)
+    {
+        if (++socket->retries > maxSynRetries)
+        {
+            stats.failedOpens++;
+            terminate(socket, true);
+            return;
+        }
+        socket->rto = min32(socket->rto * 2, maxRTO);
+        socket->rttTiming = false;
+        sendSegment(socket, socket->iss, 0, socket->state == TCP_SYN_SENT ? TCP_SYN : TCP_SYN | TCP_ACK);
+        socket->retransmitAt = time + socket->rto;
+        return;
+    }
+
+    // zero window probe: one byte beyond the window draws an ACK with the current one
+    if (socket->sndWnd == 0 && socket->sndNxt == socket->sndUna && seqLess(socket->sndNxt, socket->sndEnd))
+    {
+        sendSegment(socket, socket->sndNxt, 1, TCP_ACK);
+        // sndNxt stays, but an ACK taking the byte must be acceptable
+        if (seqLess(socket->sndMax, socket->sndNxt + 1))
+            socket->sndMax = socket->sndNxt + 1;
+        socket->rto = min32(socket->rto * 2, maxRTO);
+        socket->retransmitAt = time + socket->rto;
+        return;
+    }
+    if (socket->sndUna == socket->sndMax)
+        return;
+    if (++socket->retries > maxRetries)
+    {
+        terminate(socket, true);
+        return;
+    }
+
+    // RFC 5681 loss window, then go back N from the oldest unacknowledged byte
+    stats.timeouts++;
+    uint32_t flight = socket->sndMax - socket->sndUna;
+    socket->ssthresh = max32(flight / 2, 2 * socket->mss);
+    socket->cwnd = socket->mss;
+    socket->inRecovery = false;
+    socket->dupAcks = 0;
+    socket->recover = socket->sndMax;
+    socket->rto = min32(socket->rto * 2, maxRTO);
+    socket->rttTiming = false;
+    // the peer may have dropped what it SACKed
+    socket->numSacked = 0;
+    socket->sndNxt = socket->sndUna;
+    output(socket);
+}
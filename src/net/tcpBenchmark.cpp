@@ -0,0 +1,132 @@
+#include "net/tcpBenchmark.h"
+#include "drivers/timer.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::net;
+
+void printf(const char *);
+void printDec(uint64_t);
+
+TcpBenchmark *TcpBenchmark::activeBenchmark = nullptr;
+
+TcpBenchmark::TcpBenchmark(TransmissionControlProtocolProvider *tcp_, uint32_t peerIP_BE, uint16_t port_)
+{
+    tcp = tcp_;
+    peerIP = peerIP_BE;
+    port = port_;
+    lastReportTick = 0;
+    lastReportBytes = 0;
+    for (uint32_t i = 0; i < sizeof(buffer); i++)
+        buffer[i] = i;
+    activeBenchmark = this;
+}
+
+TcpBenchmark::~TcpBenchmark()
+{
+    if (activeBenchmark == this)
+        activeBenchmark = nullptr;
+}
+
+void TcpBenchmark::taskEntry()
+{
+    if (activeBenchmark)
+        activeBenchmark->run();
+    while (1)
+        __asm__ volatile("hlt");
+}
+
+void TcpBenchmark::run()
+{
+    TimerDriver *timer = TimerDriver::activeTimer;
+    if (timer == nullptr)
+    {
+        printf("tcpbench: no timer\n");
+        return;
+    }
+    // let the NIC finish its initialisation
+    timer->wait(10);
+    if (peerIP)
+        send();
+    else
+        receive();
+}
+
+void TcpBenchmark::send()
+{
+    TimerDriver *timer = TimerDriver::activeTimer;
+    TransmissionControlProtocolSocket *socket;
+    // the receiver may boot later, a refused connect is tried again
+    while ((socket = tcp->connect(peerIP, port)) == nullptr)
+        timer->wait(timer->getFrequency());
+    printf("tcpbench: connected\n");
+
+    uint64_t bytes = 0;
+    lastReportTick = timer->getTicks();
+    while (1)
+    {
+        int sent = socket->send(buffer, sizeof(buffer));
+        if (sent < 0)
+            break;
+        bytes += sent;
+        report("tcpbench send: ", bytes);
+    }
+    const TcpStatistics &stats = tcp->getStatistics();
+    printf("tcpbench: connection lost, ");
+    printDec(stats.retransmits);
+    printf(" retransmits, ");
+    printDec(stats.timeouts);
+    printf(" timeouts\n");
+    socket->close();
+}
+
+void TcpBenchmark::receive()
+{
+    TimerDriver *timer = TimerDriver::activeTimer;
+    TransmissionControlProtocolSocket *listener = tcp->listen(port);
+    if (listener == nullptr)
+    {
+        printf("tcpbench: port taken\n");
+        return;
+    }
+    while (1)
+    {
+        TransmissionControlProtocolSocket *socket = listener->accept();
+        if (socket == nullptr)
+            return;
+        printf("tcpbench: accepted\n");
+
+        uint64_t bytes = 0;
+        uint64_t start = timer->getTicks();
+        lastReportTick = start;
+        lastReportBytes = 0;
+        int received;
+        while ((received = socket->receive(buffer, sizeof(buffer))) > 0)
+        {
+            bytes += received;
+            report("tcpbench receive: ", bytes);
+        }
+        // the average over the whole connection
+        lastReportTick = start;
+        lastReportBytes = 0;
+        report("tcpbench average: ", bytes, true);
+        socket->close();
+    }
+}
+
+void TcpBenchmark::report(const char *name, uint64_t bytes, bool force)
+{
+    TimerDriver *timer = TimerDriver::activeTimer;
+    uint64_t now = timer->getTicks();
+    uint64_t elapsed = now - lastReportTick;
+    if (elapsed < timer->getFrequency() && !force)
+        return;
+    if (elapsed == 0)
+        elapsed = 1;
+    printf(name);
+    printDec((bytes - lastReportBytes) * 8 * timer->getFrequency() / elapsed / 1000000);
+    printf(" Mbit/s\n");
+    lastReportTick = now;
+    lastReportBytes = bytes;
+}
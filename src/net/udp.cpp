@@ -0,0 +1,276 @@
+#include "net/udp.h"
+#include "net/icmp.h"
+#include "hardwareCommunication/interrupts.h"
+#include "multitask.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::drivers;
+using namespace zoeos::hardwareCommunication;
+using namespace zoeos::net;
+
+static const uint8_t IP_PROTOCOL_UDP = 17;
+static const uint16_t EPHEMERAL_PORT_FIRST = 49152;
+
+static inline uint16_t bigEndian16(uint16_t value)
+{
+    return (value << 8) | (value >> 8);
+}
+
+UserDatagramProtocolSocket::UserDatagramProtocolSocket(UserDatagramProtocolProvider *backend, uint32_t localIP_BE, uint16_t localPort_BE)
+{
+    this->backend = backend;
+    localIP = localIP_BE;
+    this->localPort_BE = localPort_BE;
+    head = 0;
+    tail = 0;
+    dropped = 0;
+    next = nullptr;
+}
+
+TxStatus UserDatagramProtocolSocket::sendTo(uint32_t dstIP_BE, uint16_t dstPort, uint8_t *data, uint32_t size)
+{
+    return backend->sendTo(this, dstIP_BE, dstPort, data, size);
+}
+
+NetBuffer *UserDatagramProtocolSocket::receive(uint32_t *srcIP_BE, uint16_t *srcPort, bool block)
+{
+    while (tail == head)
+    {
+        // with interrupts off the receive path cannot fill the ring
+        // between the check and going to sleep
+        InterruptGuard guard;
+        if (tail != head)
+            break;
+        if (!block || TaskManager::activeTaskManager == nullptr || !TaskManager::activeTaskManager->sleep(this))
+            return nullptr;
+    }
+
+    Datagram *datagram = &ring[tail & (ZOEOS_UDP_RING_SIZE - 1)];
+    NetBuffer *buffer = datagram->buffer;
+    if (srcIP_BE)
+        *srcIP_BE = datagram->srcIP;
+    if (srcPort)
+        *srcPort = bigEndian16(datagram->srcPort);
+    // the slot is free for the receive path once tail moves past it
+    __asm__ volatile("" : : : "memory");
+    tail = tail + 1;
+    return buffer;
+}
+
+uint32_t UserDatagramProtocolSocket::pollEvents() const
+{
+    return (head != tail ? POLL_IN : 0) | POLL_OUT;
+}
+
+int UserDatagramProtocolSocket::recvFrom(uint8_t *buffer, uint32_t size, uint32_t *srcIP_BE, uint16_t *srcPort, bool block)
+{
+    NetBuffer *datagram = receive(srcIP_BE, srcPort, block);
+    if (datagram == nullptr)
+        return -1;
+    uint32_t copied = datagram->size < size ? datagram->size : size;
+    for (uint32_t i = 0; i < copied; i++)
+        buffer[i] = datagram->data[i];
+    datagram->release();
+    return copied;
+}
+
+static const NetStatField udpFields[] =
+{
+    NETSTAT_FIELD(UdpStatistics, rxDatagrams),
+    NETSTAT_FIELD(UdpStatistics, txDatagrams),
+    NETSTAT_FIELD(UdpStatistics, noPort),
+    NETSTAT_FIELD(UdpStatistics, malformed),
+    NETSTAT_FIELD(UdpStatistics, receiveErrors)
+};
+
+UserDatagramProtocolProvider::UserDatagramProtocolProvider(InternetProtocolProvider *backend)
+    : InternetProtocolHandler(backend, IP_PROTOCOL_UDP)
+{
+    for (int i = 0; i < (1 << hashBits); i++)
+        sockets[i] = nullptr;
+    copyPool = new NetBufferPool(8, ZOEOS_IP_REASSEMBLY_SIZE);
+    nextEphemeralPort = EPHEMERAL_PORT_FIRST;
+    stats = UdpStatistics();
+    NetStatistics::add("udp", -1, &stats, udpFields, sizeof(udpFields) / sizeof(udpFields[0]));
+}
+
+UserDatagramProtocolProvider::~UserDatagramProtocolProvider()
+{
+    NetStatistics::remove(&stats);
+    for (int i = 0; i < (1 << hashBits); i++)
+    {
+        while (sockets[i])
+            unbind(sockets[i]);
+    }
+    delete copyPool;
+}
+
+uint32_t UserDatagramProtocolProvider::hash(uint32_t ipAddress_BE, uint16_t port_BE)
+{
+    return ((ipAddress_BE ^ port_BE) * 2654435761u) >> (32 - hashBits);
+}
+
+UserDatagramProtocolSocket *UserDatagramProtocolProvider::lookup(uint32_t ipAddress_BE, uint16_t port_BE) const
+{
+    for (UserDatagramProtocolSocket *socket = sockets[hash(ipAddress_BE, port_BE)]; socket; socket = socket->next)
+    {
+        if (socket->localPort_BE == port_BE && socket->localIP == ipAddress_BE)
+            return socket;
+    }
+    return nullptr;
+}
+
+UserDatagramProtocolSocket *UserDatagramProtocolProvider::bind(uint32_t localIP_BE, uint16_t localPort)
+{
+    uint16_t port_BE = bigEndian16(localPort);
+    if (localPort == 0)
+    {
+        for (int tries = 0; tries < 0x10000 - EPHEMERAL_PORT_FIRST; tries++)
+        {
+            uint16_t candidate = bigEndian16(nextEphemeralPort);
+            nextEphemeralPort = nextEphemeralPort == 0xffff ? EPHEMERAL_PORT_FIRST : nextEphemeralPort + 1;
+            if (lookup(localIP_BE, candidate) == nullptr)
+            {
+                port_BE = candidate;
+                break;
+            }
+        }
+        if (port_BE == 0)
+            return nullptr;
+    }
+    else if (lookup(localIP_BE, port_BE))
+    {
+        return nullptr;
+    }
+
+    UserDatagramProtocolSocket *socket = new UserDatagramProtocolSocket(this, localIP_BE, port_BE);
+    uint32_t bucket = hash(localIP_BE, port_BE);
+    InterruptGuard guard;
+    socket->next = sockets[bucket];
+    sockets[bucket] = socket;
+    return socket;
+}
+
+void UserDatagramProtocolProvider::unbind(UserDatagramProtocolSocket *socket)
+{
+    {
+        InterruptGuard guard;
+        for (UserDatagramProtocolSocket **link = &sockets[hash(socket->localIP, socket->localPort_BE)]; *link; link = &(*link)->next)
+        {
+            if (*link == socket)
+            {
+                *link = socket->next;
+                break;
+            }
+        }
+    }
+    while (socket->tail != socket->head)
+    {
+        socket->ring[socket->tail & (ZOEOS_UDP_RING_SIZE - 1)].buffer->release();
+        socket->tail = socket->tail + 1;
+    }
+    delete socket;
+}
+
+uint32_t UserDatagramProtocolProvider::pseudoHeaderSum(uint32_t srcIP_BE, uint32_t dstIP_BE, uint16_t length) const
+{
+    uint32_t sum = (srcIP_BE & 0xffff) + (srcIP_BE >> 16) + (dstIP_BE & 0xffff) + (dstIP_BE >> 16);
+    return sum + bigEndian16(IP_PROTOCOL_UDP) + bigEndian16(length);
+}
+
+bool UserDatagramProtocolProvider::onInternetProtocolReceived(uint32_t srcIP_BE, uint32_t dstIP_BE,
+        uint8_t *payload, uint32_t size)
+{
+    if (size < sizeof(UserDatagramProtocolHeader))
+    {
+        stats.malformed++;
+        return false;
+    }
+    UserDatagramProtocolHeader *udp = (UserDatagramProtocolHeader*)payload;
+    uint32_t length = bigEndian16(udp->length);
+    if (length < sizeof(UserDatagramProtocolHeader) || length > size)
+    {
+        stats.malformed++;
+        return false;
+    }
+    // 0 means the sender did not compute one
+    if (udp->checksum && InternetChecksum::partial(payload, length, pseudoHeaderSum(srcIP_BE, dstIP_BE, length)) != 0xffff)
+    {
+        stats.malformed++;
+        return false;
+    }
+    stats.rxDatagrams++;
+
+    // a socket on the address first, then one on all addresses
+    UserDatagramProtocolSocket *socket = lookup(dstIP_BE, udp->dstPort);
+    if (socket == nullptr)
+        socket = lookup(0, udp->dstPort);
+    if (socket == nullptr)
+    {
+        stats.noPort++;
+        backend->reportUnreachable(ICMP_PORT_UNREACHABLE);
+        return false;
+    }
+    if (socket->head - socket->tail == ZOEOS_UDP_RING_SIZE)
+    {
+        socket->dropped++;
+        stats.receiveErrors++;
+        return false;
+    }
+
+    NetBuffer *buffer = backend->claimReceiveBuffer();
+    if (buffer)
+    {
+        buffer->data = payload + sizeof(UserDatagramProtocolHeader);
+    }
+    else
+    {
+        buffer = copyPool->alloc();
+        if (buffer == nullptr)
+        {
+            stats.receiveErrors++;
+            return false;
+        }
+        for (uint32_t i = sizeof(UserDatagramProtocolHeader); i < length; i++)
+            buffer->data[i - sizeof(UserDatagramProtocolHeader)] = payload[i];
+    }
+    buffer->size = length - sizeof(UserDatagramProtocolHeader);
+
+    UserDatagramProtocolSocket::Datagram *datagram = &socket->ring[socket->head & (ZOEOS_UDP_RING_SIZE - 1)];
+    datagram->buffer = buffer;
+    datagram->srcIP = srcIP_BE;
+    datagram->srcPort = udp->srcPort;
+    // the reader must see the slot filled before head moves
+    __asm__ volatile("" : : : "memory");
+    socket->head = socket->head + 1;
+    if (TaskManager::activeTaskManager)
+        TaskManager::activeTaskManager->wakeUp(socket);
+    socket->notify(POLL_IN);
+    return false;
+}
+
+TxStatus UserDatagramProtocolProvider::sendTo(UserDatagramProtocolSocket *socket, uint32_t dstIP_BE, uint16_t dstPort,
+        uint8_t *data, uint32_t size)
+{
+    if (size > 0xffff - sizeof(UserDatagramProtocolHeader))
+        return TX_INVALID;
+    uint16_t length = size + sizeof(UserDatagramProtocolHeader);
+
+    UserDatagramProtocolHeader udp;
+    udp.srcPort = socket->localPort_BE;
+    udp.dstPort = bigEndian16(dstPort);
+    udp.length = bigEndian16(length);
+    udp.checksum = 0;
+    uint32_t srcIP = socket->localIP ? socket->localIP : backend->getIPAddress();
+    uint32_t sum = InternetChecksum::partial((uint8_t*)&udp, sizeof(UserDatagramProtocolHeader), pseudoHeaderSum(srcIP, dstIP_BE, length));
+    sum = InternetChecksum::finish(InternetChecksum::partial(data, size, sum));
+    // 0 would mean no checksum
+    udp.checksum = sum ? sum : 0xffff;
+
+    TxFragment fragments[2] = { { (uint8_t*)&udp, sizeof(UserDatagramProtocolHeader) }, { data, size } };
+    // the checksum above needs no guard, the layers below share state with the receive path
+    InterruptGuard guard;
+    stats.txDatagrams++;
+    return send(dstIP_BE, fragments, 2);
+}
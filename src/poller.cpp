@@ -0,0 +1,204 @@
+#include "poller.h"
+#include "multitask.h"
+#include "hardwareCommunication/interrupts.h"
+
+using namespace zoeos;
+using namespace zoeos::common;
+using namespace zoeos::hardwareCommunication;
+
+static const uint32_t POLL_ALWAYS = POLL_ERR | POLL_HUP;
+
+PollSource::PollSource()
+{
+    watchers = nullptr;
+}
+
+PollSource::~PollSource()
+{
+    InterruptGuard guard;
+    while (watchers)
+        watchers->poller->release(watchers);
+}
+
+void PollSource::notify(uint32_t events)
+{
+    // the receive path calls in while a task may be in wait()
+    InterruptGuard guard;
+    for (PollEntry *entry = watchers; entry; entry = entry->nextWatcher)
+    {
+        uint32_t interesting = events & entry->events;
+        if (interesting == 0)
+            continue;
+        entry->pending |= interesting;
+        if (!entry->queued)
+            entry->poller->enqueue(entry);
+        if (TaskManager::activeTaskManager)
+            TaskManager::activeTaskManager->wakeUp(entry->poller);
+    }
+}
+
+Poller::Poller()
+{
+    freeEntries = nullptr;
+    for (int i = maxEntries - 1; i >= 0; i--)
+    {
+        entries[i].source = nullptr;
+        entries[i].queued = false;
+        entries[i].nextWatcher = freeEntries;
+        freeEntries = &entries[i];
+    }
+    readyHead = nullptr;
+    readyTail = nullptr;
+}
+
+Poller::~Poller()
+{
+    InterruptGuard guard;
+    for (int i = 0; i < maxEntries; i++)
+    {
+        if (entries[i].source)
+            release(&entries[i]);
+    }
+}
+
+PollEntry *Poller::find(PollSource *source)
+{
+    for (PollEntry *entry = source->watchers; entry; entry = entry->nextWatcher)
+    {
+        if (entry->poller == this)
+            return entry;
+    }
+    return nullptr;
+}
+
+void Poller::enqueue(PollEntry *entry)
+{
+    entry->queued = true;
+    entry->nextReady = nullptr;
+    if (readyTail)
+        readyTail->nextReady = entry;
+    else
+        readyHead = entry;
+    readyTail = entry;
+}
+
+void Poller::release(PollEntry *entry)
+{
+    if (entry->queued)
+    {
+        PollEntry *previous = nullptr;
+        for (PollEntry *ready = readyHead; ready != entry; ready = ready->nextReady)
+            previous = ready;
+        if (previous)
+            previous->nextReady = entry->nextReady;
+        else
+            readyHead = entry->nextReady;
+        if (readyTail == entry)
+            readyTail = previous;
+    }
+    for (PollEntry **link = &entry->source->watchers; *link; link = &(*link)->nextWatcher)
+    {
+        if (*link == entry)
+        {
+            *link = entry->nextWatcher;
+            break;
+        }
+    }
+    entry->source = nullptr;
+    entry->nextWatcher = freeEntries;
+    freeEntries = entry;
+}
+
+bool Poller::add(PollSource *source, uint32_t events, void *cookie, bool edgeTriggered)
+{
+    InterruptGuard guard;
+    if (find(source) || freeEntries == nullptr)
+        return false;
+    PollEntry *entry = freeEntries;
+    freeEntries = entry->nextWatcher;
+
+    entry->poller = this;
+    entry->source = source;
+    entry->events = events | POLL_ALWAYS;
+    entry->cookie = cookie;
+    entry->edgeTriggered = edgeTriggered;
+    entry->pending = 0;
+    entry->queued = false;
+    entry->nextWatcher = source->watchers;
+    source->watchers = entry;
+
+    // what already holds counts as the first edge
+    uint32_t ready = source->pollEvents() & entry->events;
+    if (ready)
+    {
+        entry->pending = ready;
+        enqueue(entry);
+    }
+    return true;
+}
+
+bool Poller::modify(PollSource *source, uint32_t events, void *cookie, bool edgeTriggered)
+{
+    InterruptGuard guard;
+    PollEntry *entry = find(source);
+    if (entry == nullptr)
+        return false;
+    entry->events = events | POLL_ALWAYS;
+    entry->cookie = cookie;
+    entry->edgeTriggered = edgeTriggered;
+    entry->pending &= entry->events;
+    uint32_t ready = source->pollEvents() & entry->events;
+    if (ready && !entry->queued)
+    {
+        entry->pending = ready;
+        enqueue(entry);
+    }
+    return true;
+}
+
+void Poller::remove(PollSource *source)
+{
+    InterruptGuard guard;
+    PollEntry *entry = find(source);
+    if (entry)
+        release(entry);
+}
+
+int Poller::wait(PollEvent *events, int max, bool block)
+{
+    InterruptGuard guard;
+    while (true)
+    {
+        int count = 0;
+        // level-triggered entries go back at the tail, stop at the last one
+        // queued now so each is looked at once
+        PollEntry *last = readyTail;
+        while (readyHead && count < max)
+        {
+            PollEntry *entry = readyHead;
+            readyHead = entry->nextReady;
+            if (readyHead == nullptr)
+                readyTail = nullptr;
+            entry->queued = false;
+
+            // level: what holds now; edge: what was notified
+            uint32_t ready = entry->edgeTriggered ? entry->pending : entry->source->pollEvents() & entry->events;
+            entry->pending = 0;
+            if (ready)
+            {
+                events[count].cookie = entry->cookie;
+                events[count].events = ready;
+                count++;
+                // looked at again by the next wait(), dropped there once it no longer holds
+                if (!entry->edgeTriggered)
+                    enqueue(entry);
+            }
+            if (entry == last)
+                break;
+        }
+        if (count || !block)
+            return count;
+        if (TaskManager::activeTaskManager == nullptr || !TaskManager::activeTaskManager->sleep(this))
+            return 0;
+    }
+}
@@ -0,0 +1,110 @@
+// Hosted microbenchmark of the internet checksum loops in src/net/checksum.cpp.
+// make checksumBench && ./checksumBench
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "net/checksum.h"
+
+using zoeos::net::InternetChecksum;
+typedef zoeos::common::uint8_t u8;
+typedef zoeos::common::uint32_t u32;
+
+// the byte pair loop the stack used before, as the baseline
+static u32 partialReference(const u8 *data, u32 size, u32 sum)
+{
+    for (u32 i = 0; i + 1 < size; i += 2)
+        sum += *(const zoeos::common::uint16_t*)(data + i);
+    if (size & 1)
+        sum += data[size - 1];
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return sum;
+}
+
+static u32 partialSSE2Only(const u8 *data, u32 size, u32 sum)
+{
+    return InternetChecksum::partialSSE2(data, size, sum);
+}
+
+static u32 copyThenSum(u8 *dst, const u8 *src, u32 size, u32 sum)
+{
+    memcpy(dst, src, size);
+    return InternetChecksum::partialScalar(dst, size, sum);
+}
+
+static double seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static volatile u32 sink;
+
+typedef u32 (*SumFunction)(const u8 *, u32, u32);
+typedef u32 (*CopyFunction)(u8 *, const u8 *, u32, u32);
+
+static double timeSum(SumFunction function, const u8 *data, u32 size, u32 iterations)
+{
+    double start = seconds();
+    u32 sum = 0;
+    for (u32 i = 0; i < iterations; i++)
+        sum += function(data, size, 0);
+    sink = sum;
+    return (seconds() - start) * 1e9 / iterations;
+}
+
+static double timeCopy(CopyFunction function, u8 *dst, const u8 *src, u32 size, u32 iterations)
+{
+    double start = seconds();
+    u32 sum = 0;
+    for (u32 i = 0; i < iterations; i++)
+        sum += function(dst, src, size, 0);
+    sink = sum;
+    return (seconds() - start) * 1e9 / iterations;
+}
+
+int main()
+{
+    static const u32 sizes[] = { 20, 40, 64, 128, 256, 384, 512, 576, 1024, 1460, 1500, 4096, 9000, 65536 };
+    static u8 source[65536 + 64];
+    static u8 destination[65536 + 64];
+    srand(1);
+    for (u32 i = 0; i < sizeof(source); i++)
+        source[i] = rand();
+    InternetChecksum::enableSSE2();
+
+    // every loop must agree at every length and alignment first
+    for (u32 offset = 0; offset < 4; offset++)
+    {
+        for (u32 size = 0; size < 2048; size++)
+        {
+            u32 expected = partialReference(source + offset, size, 0);
+            u32 scalar = InternetChecksum::partialScalar(source + offset, size);
+            u32 sse2 = InternetChecksum::partialSSE2(source + offset, size);
+            u32 copied = InternetChecksum::copyPartial(destination + offset, source + offset, size);
+            // 0 and 0xffff are the same one's complement number
+            if (scalar % 0xffff != expected % 0xffff || sse2 % 0xffff != expected % 0xffff ||
+                copied % 0xffff != expected % 0xffff || memcmp(destination + offset, source + offset, size))
+            {
+                printf("mismatch at size %u offset %u\n", size, offset);
+                return 1;
+            }
+        }
+    }
+
+    printf("%8s %12s %12s %12s %12s %12s\n", "bytes", "reference", "scalar", "sse2", "copy+sum", "copy;sum");
+    for (u32 i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        u32 size = sizes[i];
+        u32 iterations = 200000000 / (size + 64);
+        double reference = timeSum(partialReference, source, size, iterations);
+        double scalar = timeSum(InternetChecksum::partialScalar, source, size, iterations);
+        double sse2 = timeSum(partialSSE2Only, source, size, iterations);
+        double fused = timeCopy(InternetChecksum::copyPartial, destination, source, size, iterations);
+        double separate = timeCopy(copyThenSum, destination, source, size, iterations);
+        printf("%8u %9.1f ns %9.1f ns %9.1f ns %9.1f ns %9.1f ns\n", size, reference, scalar, sse2, fused, separate);
+    }
+    return 0;
+}